@@ -14,8 +14,40 @@
 
 #include "GeometryTypes.h"
 #include <vector>
+#include <string>
 #include "TetraToolsExports.h"
 
+/**
+ *	Optional optimisation stage that runs after the mesh has been generated.
+ *	The enabled CGAL optimisers run in the order Lloyd, ODT, perturb, exude and
+ *	share the wall-clock budget timeLimit: every step gets the remaining time divided
+ *	by the number of remaining steps. A timeLimit of 0 runs every step to convergence.
+ */
+struct CGALOptimizationOptions
+{
+	bool	lloyd;
+	bool	odt;
+	bool	perturb;
+	bool	exude;
+	double	timeLimit;		/// seconds for all enabled steps together, 0 = unlimited
+	double	sliverBound;	/// dihedral angle (degrees) targeted by perturb / exude, 0 = CGAL default
+
+	CGALOptimizationOptions() : lloyd(false), odt(false), perturb(false), exude(false), timeLimit(0.0), sliverBound(0.0)
+	{}
+};
+
+/**
+ *	Quality of the mesh after one optimisation step (or after meshing for the first entry).
+ */
+struct CGALOptimizationStep
+{
+	std::string	name;
+	double		seconds;				/// time spent in this step
+	float		minDihedral;			/// smallest dihedral angle of the mesh (degrees)
+	float		maxRadiusEdgeRatio;		/// largest radius-edge ratio of the mesh
+	size_t		numSlivers;
+};
+
 class DLL_EXPORT CGALTetrahedralize 
 {
 public:
@@ -27,7 +59,16 @@ public:
 	 *	defined by a list of triangles and list of vertices.
 	 *	Additionally we will set all necessary parameters for CGAL's meshing algorithm.
 	 */
-	void GenerateFromSurface(const std::vector<Triangle>& tris, const std::vector<Vec3f>& verts, const double cell_size_, const double facet_angle_, const double facet_size_, const double face_distance_, const double cell_radius_dege_ratio_);
+	void GenerateFromSurface(const std::vector<Triangle>& tris, const std::vector<Vec3f>& verts, const double cell_size_, const double facet_angle_, const double facet_size_, const double face_distance_, const double cell_radius_dege_ratio_, const CGALOptimizationOptions& optimization_ = CGALOptimizationOptions());
+
+	/**
+	 *	Worst-element quality after meshing and after every optimisation step of the
+	 *	last GenerateFromSurface call, together with the time spent in each step.
+	 */
+	const std::vector<CGALOptimizationStep>& GetOptimizationReport() const
+	{
+		return optimizationReport;
+	}
 
 	/**
 	 *	Automatic conversion from the algorithm's ouput data to STL type vector
@@ -39,6 +80,12 @@ public:
 	 *	Returns a list of the previously generated tetrahedra indices
 	 */
 	std::vector<Tetrahedron>& GetTetras();
+
+	/**
+	 *	Hands the generated vertices and tetrahedra over to the caller without copying
+	 *	(e.g. for TetrahedronTopology::Init with rvalues). The internal buffers are empty afterwards.
+	 */
+	void Release(std::vector<Vec3f>& vertices_, std::vector<Tetrahedron>& tetras_);
 	
 	/*
 	 *	Clear stored surface vertices and triangle indices.
@@ -49,6 +96,7 @@ private:
 	std::vector<Vec3f> 			tetraPoints;
     std::vector<Vec3f>          tetraNormals;
 	std::vector<Tetrahedron> 	tetraIndices;
+	std::vector<CGALOptimizationStep>	optimizationReport;
 };
 
 #endif // CGAL_TETRAHEDRALIZE_H
@@ -13,6 +13,7 @@
 
 #include "TetrahedronTopology.h"
 #include "TriMeshLoader.h"
+#include "GeometryConversion.h"
 
 #include "CGALTetrahedralize.h"
 #include "CGALUtils.h"
@@ -34,15 +35,17 @@ class TetraMesh {
                                     const double facetAngle,
                                     const double facetSize,
                                     const double facetDistance,
-                                    const double cellRadiusEdgeRatio )
-                                { return TetraMeshRef( new TetraMesh( path, cellSize, facetAngle, facetSize, facetDistance, cellRadiusEdgeRatio ) ); }
+                                    const double cellRadiusEdgeRatio,
+                                    const CGALOptimizationOptions& optimization = CGALOptimizationOptions() )
+                                { return TetraMeshRef( new TetraMesh( path, cellSize, facetAngle, facetSize, facetDistance, cellRadiusEdgeRatio, optimization ) ); }
     
         TetraMesh( const fs::path& path,
                     const double cellSize,
                     const double facetAngle,
                     const double facetSize,
                     const double facetDistance,
-                    const double cellRadiusEdgeRatio );
+                    const double cellRadiusEdgeRatio,
+                    const CGALOptimizationOptions& optimization = CGALOptimizationOptions() );
     
         const TetraTopologyRef& getTopology() const { return mTopology; }
 		const ci::TriMeshRef& getTriMesh() const { return mTriMesh; }
@@ -54,14 +57,13 @@ class TetraMesh {
                                                     const double facetAngle,
                                                     const double facetSize,
                                                     const double facetDistance,
-                                                    const double cellRadiusEdgeRatio );
+                                                    const double cellRadiusEdgeRatio,
+                                                    const CGALOptimizationOptions& optimization );
 	private:
+        // The surface topology only lives until the tetrahedral mesh has been generated,
+        // the tetrahedral data is moved into mTopology without further copies.
         TetraTopologyRef	mTopology;
-        TriangleTopologyRef mSurface;
 		ci::TriMeshRef		mTriMesh;
-        std::vector<vec3> 	mVertices;
-        std::vector<vec3> 	mNormals;
-        std::vector<vec3> 	mCentroids;
 };
 
 } // namespace Tetra
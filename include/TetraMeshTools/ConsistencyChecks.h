@@ -0,0 +1,42 @@
+/*
+ * ConsistencyChecks.h
+ *
+ * Self checks of the optimized code paths against their straightforward
+ * reference implementations. They are not run by the library itself; call
+ * them from an application or a debug build after changing one of the
+ * checked paths, or on a new platform / compiler. Every check prints a
+ * short report and returns false if a difference was found.
+ */
+
+#ifndef CONSISTENCYCHECKS_H_
+#define CONSISTENCYCHECKS_H_
+
+#include <vector>
+#include "GeometryTypes.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	/**
+	 * Compares triBoxOverlap8 and triBoxOverlapN with the scalar triBoxOverlap. Besides
+	 * numRandomTriangles_ random triangles the cases include degenerate triangles (single
+	 * points, segments) and triangles that only touch a box in a face, an edge or a corner,
+	 * for which rounding differences between the paths would show up first.
+	 */
+	DLL_EXPORT bool CheckTriBoxOverlapBatches(const unsigned int numRandomTriangles_ = 100000);
+
+	/**
+	 * Builds the octree of the surface vertices_ / triangles_ with one worker thread and with
+	 * numThreads_ (0 for the hardware concurrency) and compares the trees node by node: depth,
+	 * quadrant, bounds and the triangle list of every leaf. This is done with and without
+	 * OctreeBuildOptions::conservativeOverlap. The default build is also compared with a serial
+	 * reference that classifies the triangles with one scalar triBoxOverlap call per child
+	 * box, as the octree did before the batched test. Use a mesh with some thousand triangles,
+	 * so the upper levels are classified in parallel.
+	 */
+	DLL_EXPORT bool CheckOctreeBuild(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const unsigned int maxDepth_, const unsigned int numThreads_ = 0);
+
+}	/// end namespace TetraTools
+
+#endif /* CONSISTENCYCHECKS_H_ */
@@ -0,0 +1,132 @@
+/*
+ * ExternalSort.h
+ *
+ * Sorting of record streams that are larger than the memory budget.
+ *
+ * The caller hands over the records in chunks that fit into memory. Every
+ * chunk is sorted in memory (ParallelSort) and appended to a run file; the
+ * sorted sequence is produced by a k-way merge over the memory-mapped runs,
+ * which reads every run front to back.
+ */
+
+#ifndef EXTERNALSORT_H_
+#define EXTERNALSORT_H_
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <stdint.h>
+#include "MappedFile.h"
+#include "ParallelUtils.h"
+
+namespace TetraTools
+{
+	template <typename Record, typename Compare>
+	class ExternalSorter
+	{
+	protected:
+		std::string				_fileName;		/// run file, removed by the destructor
+		Compare					_compare;
+		std::ofstream			_runFile;
+		std::vector<uint64_t>	_runOffsets;	/// first record of every run, plus the total count
+		MappedArray<Record>		_runs;
+
+	public:
+		ExternalSorter(const std::string& fileName_, const Compare& compare_)
+			: _fileName(fileName_), _compare(compare_)
+		{
+			_runFile.open(_fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			_runOffsets.push_back(0);
+		}
+
+		~ExternalSorter()
+		{
+			_runs.Close();
+			if (_runFile.is_open())
+				_runFile.close();
+			std::remove(_fileName.c_str());
+		}
+
+		ExternalSorter(const ExternalSorter&) = delete;
+		ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+		/**
+		 * Sorts records_ and appends them as one run. records_ is cleared, its capacity is kept.
+		 */
+		bool AddRun(std::vector<Record>& records_)
+		{
+			if (!_runFile.is_open())
+			{
+				std::cerr<<"ERROR! Cannot write sort run to "<<_fileName<<"!"<<std::endl;
+				return false;
+			}
+			if (records_.empty())
+				return true;
+			ParallelSort(records_.begin(), records_.end(), _compare);
+			_runFile.write(reinterpret_cast<const char*>(&records_[0]), records_.size() * sizeof(Record));
+			_runOffsets.push_back(_runOffsets.back() + records_.size());
+			records_.clear();
+			return _runFile.good();
+		}
+
+		uint64_t GetNumRecords() const
+		{
+			return _runOffsets.back();
+		}
+
+		size_t GetNumRuns() const
+		{
+			return _runOffsets.size() - 1;
+		}
+
+		/**
+		 * Calls consumer_(record) for all records in sorted order. No runs can be added afterwards.
+		 */
+		template <typename Consumer>
+		bool Merge(Consumer& consumer_)
+		{
+			if (_runFile.is_open())
+				_runFile.close();
+			if (GetNumRecords() == 0)
+				return true;
+			if (!_runs.Open(_fileName, false))
+				return false;
+			_runs.AdviseSequential();
+			const Record* records = _runs.data();
+
+			/// heap of run cursors, the smallest record on top; equal records are taken from the earlier run first
+			const size_t numRuns = GetNumRuns();
+			std::vector<uint64_t> cursors(_runOffsets.begin(), _runOffsets.end() - 1);
+			std::vector<unsigned int> heap;
+			heap.reserve(numRuns);
+			const Compare& compare = _compare;
+			auto greater = [&](const unsigned int a_, const unsigned int b_)
+			{
+				const Record& ra = records[cursors[a_]];
+				const Record& rb = records[cursors[b_]];
+				return compare(rb, ra) || (!compare(ra, rb) && b_ < a_);
+			};
+			for (unsigned int r=0; r<numRuns; ++r)
+				heap.push_back(r);
+			std::make_heap(heap.begin(), heap.end(), greater);
+			while (!heap.empty())
+			{
+				std::pop_heap(heap.begin(), heap.end(), greater);
+				const unsigned int run = heap.back();
+				consumer_(records[cursors[run]]);
+				if (++cursors[run] < _runOffsets[run+1])
+					std::push_heap(heap.begin(), heap.end(), greater);
+				else
+					heap.pop_back();
+			}
+			_runs.Close();
+			return true;
+		}
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* EXTERNALSORT_H_ */
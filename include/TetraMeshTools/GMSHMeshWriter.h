@@ -13,6 +13,7 @@
 #include <iostream>
 #include <fstream>
 #include "GeometryTypes.h"
+#include "TetrahedronTopology.h"
 
 #include "TetraToolsExports.h"
 
@@ -25,6 +26,12 @@ public:
 	{}
 
 	bool SaveToFile(const std::string& fileName_, const std::vector<Vec3f>& verts, const std::vector<Tetrahedron>& tetras);
+
+	/**
+	 *	Writes the vertices and tetrahedra of topology_ in their current numbering,
+	 *	e.g. after TetrahedronTopology::ReorderReverseCuthillMcKee().
+	 */
+	bool SaveToFile(const std::string& fileName_, TetrahedronTopology& topology_);
 };
 
 } /// end namespace TetraTools
@@ -0,0 +1,90 @@
+/*
+ * GeometryConversion.h
+ *
+ * Bulk conversion between the TetraTools primitives and layout-compatible
+ * types of other libraries (float buffers, trimesh2 points and faces,
+ * cinder index/position buffers).
+ *
+ * All conversions are plain memcpy calls. The layout requirements are
+ * checked at compile time, so a conversion that would need a per-element
+ * loop does not compile instead of silently producing garbage.
+ */
+
+#ifndef GEOMETRYCONVERSION_H_
+#define GEOMETRYCONVERSION_H_
+
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include "GeometryTypes.h"
+
+namespace TetraTools
+{
+	/**
+	 * Copies count_ elements of Src into Dst. Both types must be trivially copyable
+	 * and have the same size, e.g. Vec3f and trimesh2 point, or Triangle and TriMesh::Face.
+	 */
+	template <typename Dst, typename Src>
+	inline void CopyPrimitives(const Src* src_, const size_t count_, Dst* dst_)
+	{
+		static_assert(sizeof(Dst) == sizeof(Src), "CopyPrimitives requires types of identical size");
+		static_assert(std::is_trivially_copyable<Dst>::value && std::is_trivially_copyable<Src>::value, "CopyPrimitives requires trivially copyable types");
+		if (count_ > 0)
+			std::memcpy(static_cast<void*>(dst_), src_, count_ * sizeof(Src));
+	}
+
+	/**
+	 * Resizes dst_ to the size of src_ and copies all elements with CopyPrimitives.
+	 */
+	template <typename Dst, typename Src>
+	inline void CopyPrimitives(const std::vector<Src>& src_, std::vector<Dst>& dst_)
+	{
+		dst_.resize(src_.size());
+		if (!src_.empty())
+			CopyPrimitives(&src_[0], src_.size(), &dst_[0]);
+	}
+
+	/**
+	 * Writes count_ vertices as 3 * count_ floats (x0 y0 z0 x1 y1 z1 ...).
+	 */
+	inline void CopyToFloats(const Vec3f* vertices_, const size_t count_, float* floats_)
+	{
+		if (count_ > 0)
+			std::memcpy(floats_, vertices_, count_ * sizeof(Vec3f));
+	}
+
+	/**
+	 * Reads count_ vertices from 3 * count_ floats (x0 y0 z0 x1 y1 z1 ...).
+	 */
+	inline void CopyFromFloats(const float* floats_, const size_t count_, Vec3f* vertices_)
+	{
+		if (count_ > 0)
+			std::memcpy(static_cast<void*>(vertices_), floats_, count_ * sizeof(Vec3f));
+	}
+
+	/**
+	 * Writes count_ triangles as 3 * count_ vertex indices, e.g. into an index buffer.
+	 */
+	template <typename Index>
+	inline void CopyToIndices(const Triangle* triangles_, const size_t count_, Index* indices_)
+	{
+		static_assert(sizeof(Index) == sizeof(unsigned int) && std::is_integral<Index>::value, "CopyToIndices requires 32 bit integer indices");
+		if (count_ > 0)
+			std::memcpy(indices_, triangles_, count_ * sizeof(Triangle));
+	}
+
+	/**
+	 * Reads count_ triangles from 3 * count_ vertex indices.
+	 */
+	template <typename Index>
+	inline void CopyFromIndices(const Index* indices_, const size_t count_, Triangle* triangles_)
+	{
+		static_assert(sizeof(Index) == sizeof(unsigned int) && std::is_integral<Index>::value, "CopyFromIndices requires 32 bit integer indices");
+		if (count_ > 0)
+			std::memcpy(static_cast<void*>(triangles_), indices_, count_ * sizeof(Triangle));
+	}
+
+}	/// end namespace TetraTools
+
+#endif /* GEOMETRYCONVERSION_H_ */
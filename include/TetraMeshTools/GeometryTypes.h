@@ -10,6 +10,7 @@
 #ifndef GEOMETRYTYPES_H_
 #define GEOMETRYTYPES_H_
 
+#include <type_traits>
 #include "Vec2f.h"
 #include "Vec3f.h"
 #include "Vec4f.h"
@@ -42,8 +43,7 @@
 	{
 	public:
 
-		Edge()
-		{}
+		Edge() = default;
 
 		Edge(const unsigned int i0, const unsigned int i1)
 		{
@@ -95,8 +95,7 @@
 	public:
 		unsigned int index[3];
 
-		Triangle()
-		{}
+		Triangle() = default;
 
 		Triangle(const unsigned int i0, const unsigned int i1, const unsigned int i2)
 		{
@@ -202,4 +201,17 @@
 		}
 	};
 
+	/**
+	 * All primitives are plain index/coordinate records, so arrays of them can be
+	 * transferred with memcpy and reinterpreted from mapped file buffers. The VecNf
+	 * types rely on their implicit copy constructor and assignment for this, so do
+	 * not add user-defined ones.
+	 */
+	static_assert(std::is_trivially_copyable<Vec2f>::value && std::is_standard_layout<Vec2f>::value && sizeof(Vec2f) == 2 * sizeof(float), "Vec2f must be a packed POD-like type");
+	static_assert(std::is_trivially_copyable<Vec3f>::value && std::is_standard_layout<Vec3f>::value && sizeof(Vec3f) == 3 * sizeof(float), "Vec3f must be a packed POD-like type");
+	static_assert(std::is_trivially_copyable<Vec4f>::value && std::is_standard_layout<Vec4f>::value && sizeof(Vec4f) == 4 * sizeof(float), "Vec4f must be a packed POD-like type");
+	static_assert(std::is_trivially_copyable<Edge>::value && std::is_standard_layout<Edge>::value && sizeof(Edge) == 2 * sizeof(unsigned int), "Edge must be a packed POD-like type");
+	static_assert(std::is_trivially_copyable<Triangle>::value && std::is_standard_layout<Triangle>::value && sizeof(Triangle) == 3 * sizeof(unsigned int), "Triangle must be a packed POD-like type");
+	static_assert(std::is_trivially_copyable<Tetrahedron>::value && std::is_standard_layout<Tetrahedron>::value && sizeof(Tetrahedron) == 4 * sizeof(unsigned int), "Tetrahedron must be a packed POD-like type");
+
 #endif /* GEOMETRYTYPES_H_ */
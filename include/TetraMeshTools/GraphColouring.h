@@ -0,0 +1,149 @@
+/*
+ * GraphColouring.h
+ *
+ * Parallel colouring of mesh graphs (Jones-Plassmann).
+ *
+ * Nodes of the same colour are never adjacent, so all nodes of one colour
+ * can be processed concurrently without locks or atomics, e.g. vertices
+ * for smoothing or tetrahedra for assembly into shared vertices.
+ *
+ * Every node gets a fixed pseudo-random priority and is coloured as soon
+ * as all of its higher priority neighbours are coloured (Jones-Plassmann),
+ * with the smallest colour none of them uses. Each node keeps a counter of
+ * uncoloured higher priority neighbours; the nodes whose counter dropped to
+ * zero form the next round. Nodes of one round are never adjacent and their
+ * lower priority neighbours are not coloured yet, so the colours do not
+ * depend on the number of threads, and every adjacency is visited a
+ * constant number of times in total.
+ */
+
+#ifndef GRAPHCOLOURING_H_
+#define GRAPHCOLOURING_H_
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include "ParallelUtils.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	/// colour of nodes that have not been coloured yet
+	const unsigned int UncolouredNode = 0xFFFFFFFFu;
+
+	/**
+	 * Fixed pseudo-random priority of a node, ties are broken by the node index.
+	 */
+	inline bool HasHigherColouringPriority(const unsigned int a_, const unsigned int b_)
+	{
+		unsigned int ha = a_ * 0x9E3779B1u;
+		unsigned int hb = b_ * 0x9E3779B1u;
+		ha ^= ha >> 16;
+		hb ^= hb >> 16;
+		return (ha != hb) ? (ha > hb) : (a_ > b_);
+	}
+
+	/**
+	 * Colours numNodes_ nodes. forEachNeighbour_(node, visitor) has to call visitor(neighbour)
+	 * for every neighbour of node and must be safe to call concurrently. The node itself is
+	 * ignored; a neighbour may be reported several times, as long as b is reported as often for
+	 * a as a is for b (e.g. tetrahedra sharing several vertices). Returns the number of colours,
+	 * colours_ holds one colour per node.
+	 */
+	template <typename NeighbourFunction>
+	unsigned int ComputeGraphColouring(const unsigned int numNodes_, const NeighbourFunction& forEachNeighbour_, std::vector<unsigned int>& colours_)
+	{
+		colours_.assign(numNodes_, UncolouredNode);
+		if (numNodes_ == 0)
+			return 0;
+
+		/// number of uncoloured higher priority neighbours per node, the nodes without any start
+		std::unique_ptr<std::atomic<unsigned int>[]> waiting(new std::atomic<unsigned int>[numNodes_]);
+		std::vector<unsigned int> round;
+		std::mutex mutex;
+		ParallelFor(0, numNodes_, [&](size_t b_, size_t e_)
+		{
+			std::vector<unsigned int> ready;
+			for (size_t i=b_; i<e_; ++i)
+			{
+				const unsigned int node = (unsigned int)i;
+				unsigned int count = 0;
+				forEachNeighbour_(node, [&](const unsigned int neighbour_)
+				{
+					if (neighbour_ != node && HasHigherColouringPriority(neighbour_, node))
+						++count;
+				});
+				waiting[node].store(count, std::memory_order_relaxed);
+				if (count == 0)
+					ready.push_back(node);
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			round.insert(round.end(), ready.begin(), ready.end());
+		}, 256);
+
+		unsigned int numColours = 0;
+		std::vector<unsigned int> nextRound;
+		while (!round.empty())
+		{
+			nextRound.clear();
+			ParallelFor(0, round.size(), [&](size_t b_, size_t e_)
+			{
+				std::vector<unsigned int> ready;
+				std::vector<unsigned int> usedStamp;
+				unsigned int maxColour = 0;
+				for (size_t i=b_; i<e_; ++i)
+				{
+					const unsigned int node = round[i];
+					const unsigned int stamp = (unsigned int)i + 1;
+					/// all coloured neighbours have a higher priority and were coloured in earlier rounds
+					forEachNeighbour_(node, [&](const unsigned int neighbour_)
+					{
+						const unsigned int c = colours_[neighbour_];
+						if (neighbour_ == node || c == UncolouredNode)
+							return;
+						if (c >= usedStamp.size())
+							usedStamp.resize(c + 1, 0);
+						usedStamp[c] = stamp;
+					});
+					unsigned int colour = 0;
+					while (colour < usedStamp.size() && usedStamp[colour] == stamp)
+						++colour;
+					colours_[node] = colour;
+					maxColour = std::max(maxColour, colour + 1);
+					/// release the lower priority neighbours, they are coloured in a later round
+					forEachNeighbour_(node, [&](const unsigned int neighbour_)
+					{
+						if (neighbour_ != node && HasHigherColouringPriority(node, neighbour_))
+						{
+							if (waiting[neighbour_].fetch_sub(1, std::memory_order_acq_rel) == 1)
+								ready.push_back(neighbour_);
+						}
+					});
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				nextRound.insert(nextRound.end(), ready.begin(), ready.end());
+				numColours = std::max(numColours, maxColour);
+			}, 256);
+			round.swap(nextRound);
+		}
+		return numColours;
+	}
+
+	/**
+	 * Colours a graph given in CSR form (neighbours of node i are
+	 * neighbours_[offsets_[i] .. offsets_[i+1])).
+	 */
+	DLL_EXPORT unsigned int ComputeGraphColouring(const std::vector<unsigned int>& offsets_, const std::vector<unsigned int>& neighbours_, std::vector<unsigned int>& colours_);
+
+	/**
+	 * Groups the nodes by colour: the nodes of colour c are order_[offsets_[c] .. offsets_[c+1]),
+	 * sorted by ascending node index within each colour.
+	 */
+	DLL_EXPORT void GroupByColour(const std::vector<unsigned int>& colours_, const unsigned int numColours_, std::vector<unsigned int>& offsets_, std::vector<unsigned int>& order_);
+
+}	/// end namespace TetraTools
+
+#endif /* GRAPHCOLOURING_H_ */
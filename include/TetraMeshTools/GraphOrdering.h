@@ -0,0 +1,47 @@
+/*
+ * GraphOrdering.h
+ *
+ * Bandwidth-reducing renumbering for sparse vertex graphs stored in CSR form
+ * (see TetrahedronTopology::GetVertexNeighbours / GetVertexNeighboursOffsets).
+ *
+ * The bandwidth and profile (envelope size) of a vertex numbering are the
+ * bandwidth and profile of the matrices assembled on it, which dominate the
+ * fill-in of direct solvers and the cache behaviour of iterative ones.
+ */
+
+#ifndef GRAPHORDERING_H_
+#define GRAPHORDERING_H_
+
+#include <vector>
+#include <stdint.h>
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	struct BandwidthInfo
+	{
+		unsigned int	bandwidth;	/// max |i - j| over all adjacent vertices i, j
+		uint64_t		profile;	/// sum over all rows i of i - (smallest adjacent index j <= i)
+	};
+
+	/**
+	 * Computes bandwidth and profile of the graph given by offsets_/neighbours_ under the
+	 * numbering permutation_ (permutation_[oldIndex] = newIndex, empty for the current one).
+	 */
+	DLL_EXPORT BandwidthInfo ComputeBandwidth(	const std::vector<unsigned int>& offsets_,
+												const std::vector<unsigned int>& neighbours_,
+												const std::vector<unsigned int>& permutation_);
+
+	/**
+	 * Reverse Cuthill-McKee ordering. Every connected component is started from a
+	 * pseudo-peripheral vertex (George-Liu), neighbours are visited by ascending degree.
+	 * Returns permutation_[oldIndex] = newIndex.
+	 */
+	DLL_EXPORT void ComputeReverseCuthillMcKee(	const std::vector<unsigned int>& offsets_,
+												const std::vector<unsigned int>& neighbours_,
+												std::vector<unsigned int>& permutation_);
+
+}	/// end namespace TetraTools
+
+#endif /* GRAPHORDERING_H_ */
@@ -0,0 +1,170 @@
+/**
+ *	LinearOctree.h
+ *
+ *	Pointerless octree for 3D surface mesh subdivision.
+ *	Builds the same tree as Octree, but stores all nodes in one array that is
+ *	sorted by locational code: a leading 1 bit followed by the interleaved
+ *	(Morton) bits of the node position, 3 bits per level. This orders the nodes
+ *	level by level and by Morton code within a level, so the children of a node
+ *	are contiguous and are addressed by a first-child index and an 8 bit mask.
+ *	The triangle lists of the leafs are stored in CSR form (offsets + indices).
+ *
+ *	Child slots use Morton order (bit 0: x, bit 1: y, bit 2: z; set means the upper
+ *	half), OctreeNode quadrants are translated by the NodeRef adapter.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "TetraToolsExports.h"
+#include "GeometryTypes.h"
+
+struct LinearOctreeNode
+{
+	uint64_t		code;		// locational code, the depth is the number of bits after the leading 1 divided by 3
+	unsigned int	first;		// inner nodes: index of the first child, leafs: index of the triangle list
+	unsigned char	childMask;	// bit m is set if the child in Morton slot m exists
+	unsigned char	depth;
+};
+
+class DLL_EXPORT LinearOctree
+{
+public:
+	/**
+	 *	Lightweight handle to a node, offering the interface of OctreeNode
+	 *	so that code written for the pointer tree can walk the linear one.
+	 */
+	class DLL_EXPORT NodeRef
+	{
+	private:
+		const LinearOctree*	_tree;
+		unsigned int		_index;
+
+	public:
+		NodeRef() : _tree(NULL), _index(0) {}
+		NodeRef(const LinearOctree* tree_, const unsigned int index_) : _tree(tree_), _index(index_) {}
+
+		// false for the empty child slots returned by getChildren (the NULL pointers of OctreeNode)
+		bool isValid() const
+		{
+			return _tree != NULL;
+		}
+
+		unsigned int getIndex() const
+		{
+			return _index;
+		}
+
+		// returns an invalid reference for the root node
+		NodeRef getParent() const;
+
+		// returns the 8 children in OctreeNode quadrant order, invalid references for empty quadrants
+		std::vector<NodeRef> getChildren() const;
+
+		// same order as OctreeNode::getLeafs (children first, then the node itself)
+		std::vector<NodeRef> getLeafs(const bool leafsOnly_=false) const;
+
+		Vec3f getMinBC() const;
+
+		Vec3f getMaxBC() const;
+
+		bool hasChildren() const;
+
+		unsigned int getDepth() const;
+
+		// OctreeNode quadrant of this node in its parent, -1 for the root
+		int getQuadrant() const;
+
+		// triangles overlapping a leaf as [trianglesBegin, trianglesEnd), empty for inner nodes
+		const unsigned int* trianglesBegin() const;
+
+		const unsigned int* trianglesEnd() const;
+
+		unsigned int getNumTriangles() const;
+	};
+
+private:
+	const unsigned int				_maxDepth;
+	Vec3f							_minBC, _maxBC;
+	std::vector<LinearOctreeNode>	_nodes;
+	std::vector<uint64_t>			_leafTriangleOffsets;	// numLeafs + 1 entries
+	std::vector<unsigned int>		_leafTriangles;
+
+	void build(const std::vector<Vec3f>& points_, const std::vector<Triangle>& tris_);
+
+	void collectLeafs(const unsigned int index_, const bool leafsOnly_, std::vector<NodeRef>& leafs_) const;
+
+public:
+	/**
+	 *	Builds the octree of the surface mesh, maxDepth_ is limited to 21 levels (63 code bits).
+	 */
+	LinearOctree(const unsigned int maxDepth_, const std::vector<Vec3f>* inPoints_, const std::vector<Triangle>* inTris_);
+
+	// converts between OctreeNode quadrants and Morton child slots
+	static unsigned int quadrantToMorton(const unsigned int quadrant_);
+
+	static unsigned int mortonToQuadrant(const unsigned int morton_);
+
+	NodeRef getRootNode() const
+	{
+		return NodeRef(this, 0);
+	}
+
+	const std::vector<LinearOctreeNode>& getNodes() const
+	{
+		return _nodes;
+	}
+
+	const LinearOctreeNode& getNode(const unsigned int index_) const
+	{
+		return _nodes[index_];
+	}
+
+	unsigned int getNumNodes() const
+	{
+		return (unsigned int)_nodes.size();
+	}
+
+	unsigned int getNumLeafs() const
+	{
+		return (unsigned int)_leafTriangleOffsets.size() - 1;
+	}
+
+	unsigned int getDepth() const
+	{
+		return _maxDepth;
+	}
+
+	const Vec3f& getMinBC() const
+	{
+		return _minBC;
+	}
+
+	const Vec3f& getMaxBC() const
+	{
+		return _maxBC;
+	}
+
+	// index of the child in Morton slot morton_ of node index_, or -1 if there is none
+	int getChild(const unsigned int index_, const unsigned int morton_) const;
+
+	// index of the node with the given locational code (binary search), or -1 if there is none
+	int findNode(const uint64_t code_) const;
+
+	// integer position of the node in units of its own size along x, y, z
+	static void decodePosition(const uint64_t code_, const unsigned int depth_, unsigned int& x_, unsigned int& y_, unsigned int& z_);
+
+	void getNodeBounds(const unsigned int index_, Vec3f& minBC_, Vec3f& maxBC_) const;
+
+	const std::vector<uint64_t>& getLeafTriangleOffsets() const
+	{
+		return _leafTriangleOffsets;
+	}
+
+	const std::vector<unsigned int>& getLeafTriangles() const
+	{
+		return _leafTriangles;
+	}
+};
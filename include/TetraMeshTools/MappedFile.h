@@ -0,0 +1,194 @@
+/*
+ * MappedFile.h
+ *
+ * Memory-mapped files as storage for arrays that do not fit into RAM.
+ *
+ * The operating system pages the data in and out on demand, so an array
+ * can be much larger than the physical memory as long as it is accessed
+ * in a mostly sequential way.
+ */
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+#include <stdint.h>
+#include <cstddef>
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	class DLL_EXPORT MappedFile
+	{
+	protected:
+		std::string	_fileName;
+		void*		_data;
+		uint64_t	_size;
+		bool		_writable;
+#ifdef WIN32
+		void*		_fileHandle;
+		void*		_mappingHandle;
+#else
+		int			_fileDescriptor;
+#endif
+
+		bool Map();
+
+	public:
+		MappedFile();
+
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		 * Creates (or truncates) fileName_ with size_ bytes and maps it writable.
+		 */
+		bool Create(const std::string& fileName_, const uint64_t size_);
+
+		/**
+		 * Maps an existing file.
+		 */
+		bool Open(const std::string& fileName_, const bool writable_);
+
+		/**
+		 * Unmaps the file, written data is flushed by the operating system.
+		 */
+		void Close();
+
+		/**
+		 * Tells the operating system that the mapping will be read front to back.
+		 */
+		void AdviseSequential();
+
+		bool IsOpen() const
+		{
+			return !_fileName.empty();
+		}
+
+		void* GetData()
+		{
+			return _data;
+		}
+
+		const void* GetData() const
+		{
+			return _data;
+		}
+
+		uint64_t GetSize() const
+		{
+			return _size;
+		}
+
+		const std::string& GetFileName() const
+		{
+			return _fileName;
+		}
+	};
+
+	/**
+	 * A fixed size array of trivially copyable elements stored in a MappedFile.
+	 */
+	template <typename T>
+	class MappedArray
+	{
+	protected:
+		MappedFile	_file;
+		size_t		_count;
+
+	public:
+		MappedArray()
+			: _count(0)
+		{
+		}
+
+		bool Create(const std::string& fileName_, const size_t count_)
+		{
+			_count = _file.Create(fileName_, (uint64_t)count_ * sizeof(T)) ? count_ : 0;
+			return _file.IsOpen();
+		}
+
+		bool Open(const std::string& fileName_, const bool writable_)
+		{
+			_count = _file.Open(fileName_, writable_) ? (size_t)(_file.GetSize() / sizeof(T)) : 0;
+			return _file.IsOpen();
+		}
+
+		void Close()
+		{
+			_file.Close();
+			_count = 0;
+		}
+
+		void AdviseSequential()
+		{
+			_file.AdviseSequential();
+		}
+
+		bool IsOpen() const
+		{
+			return _file.IsOpen();
+		}
+
+		size_t size() const
+		{
+			return _count;
+		}
+
+		bool empty() const
+		{
+			return _count == 0;
+		}
+
+		T* data()
+		{
+			return static_cast<T*>(_file.GetData());
+		}
+
+		const T* data() const
+		{
+			return static_cast<const T*>(_file.GetData());
+		}
+
+		T& operator[](const size_t index_)
+		{
+			return data()[index_];
+		}
+
+		const T& operator[](const size_t index_) const
+		{
+			return data()[index_];
+		}
+
+		T* begin()
+		{
+			return data();
+		}
+
+		T* end()
+		{
+			return data() + _count;
+		}
+
+		const T* begin() const
+		{
+			return data();
+		}
+
+		const T* end() const
+		{
+			return data() + _count;
+		}
+
+		const std::string& GetFileName() const
+		{
+			return _file.GetFileName();
+		}
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* MAPPEDFILE_H_ */
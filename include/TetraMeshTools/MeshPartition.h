@@ -0,0 +1,188 @@
+/*
+ * MeshPartition.h
+ *
+ * Partitioning of tetrahedral meshes for distributed simulations.
+ *
+ * The tetrahedra are split recursively at the weighted median of their
+ * centroids, either along the longest axis of the centroid bounding box
+ * (recursive coordinate bisection) or along the principal axis of the
+ * centroids (inertial bisection). Any number of parts is supported, a
+ * range meant for k parts is split in the ratio floor(k/2) : ceil(k/2).
+ * Optionally a few greedy boundary refinement passes on the face adjacency
+ * (dual graph) move tetrahedra to the neighbouring part that shares most of
+ * their faces, which reduces the number of cut faces within the allowed
+ * imbalance.
+ *
+ * Every part can be extracted as a self-contained submesh with local to
+ * global index maps, vertex ownership and any number of one-ring halo
+ * layers, and written to disk so that each rank loads only its own files.
+ */
+
+#ifndef MESHPARTITION_H_
+#define MESHPARTITION_H_
+
+#include <vector>
+#include <string>
+#include "GeometryTypes.h"
+#include "TetrahedronTopology.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	enum PartitionMethod
+	{
+		PARTITION_COORDINATE_BISECTION,
+		PARTITION_INERTIAL_BISECTION
+	};
+
+	/// marks a tetrahedron face on the mesh boundary in the face adjacency
+	const unsigned int NoFaceNeighbour = 0xFFFFFFFFu;
+
+	/**
+	 * A part of a partitioned mesh, indexed locally.
+	 * The tetrahedra are ordered by halo layer: tetras[tetraLayerOffsets[0] .. tetraLayerOffsets[1])
+	 * are owned by the part, tetras[tetraLayerOffsets[l] .. tetraLayerOffsets[l+1]) form halo layer l.
+	 * The vertices owned by the part come first; a vertex is owned by the lowest part index
+	 * among the tetrahedra that contain it.
+	 */
+	struct MeshPart
+	{
+		unsigned int				index;
+		std::vector<Vec3f>			vertices;
+		std::vector<Tetrahedron>	tetras;					/// local vertex indices
+		std::vector<unsigned int>	vertexGlobalIndices;	/// local -> global vertex index
+		std::vector<unsigned int>	tetraGlobalIndices;		/// local -> global tetrahedron index
+		std::vector<unsigned int>	vertexOwners;			/// owning part of every local vertex
+		std::vector<unsigned int>	tetraOwners;			/// owning part of every local tetrahedron
+		std::vector<unsigned int>	tetraLayerOffsets;		/// numHaloLayers+2 entries
+		unsigned int				numOwnedVertices;
+	};
+
+	class DLL_EXPORT MeshPartitioner
+	{
+	protected:
+		PartitionMethod				_method;
+		unsigned int				_numParts;
+		unsigned int				_numRefinementPasses;
+		float						_imbalance;				/// allowed relative excess of a part over the average size
+		unsigned int				_numHaloLayers;
+
+		std::vector<unsigned int>	_tetraParts;			/// part index per tetrahedron
+		std::vector<unsigned int>	_faceNeighbours;		/// 4 per tetrahedron, neighbour across the face opposite to vertex j
+		std::vector<unsigned int>	_vertexOwners;			/// lowest part index among the tetrahedra of each vertex
+		size_t						_numCutFaces;
+
+		void GenerateFaceNeighbours(const std::vector<Tetrahedron>& tetras_);
+
+		/**
+		 * Splits order_[begin_, end_) into numParts_ parts starting at firstPart_.
+		 */
+		void Bisect(const std::vector<Vec3f>& centroids_, std::vector<unsigned int>& order_, const size_t begin_, const size_t end_,
+					const unsigned int firstPart_, const unsigned int numParts_, const unsigned int depth_);
+
+		void Refine();
+
+		void CountCutFaces();
+
+	public:
+		MeshPartitioner();
+
+		void SetMethod(const PartitionMethod method_)
+		{
+			_method = method_;
+		}
+
+		PartitionMethod GetMethod() const
+		{
+			return _method;
+		}
+
+		void SetNumParts(const unsigned int numParts_)
+		{
+			_numParts = numParts_;
+		}
+
+		unsigned int GetNumParts() const
+		{
+			return _numParts;
+		}
+
+		/**
+		 * Number of boundary refinement passes after the bisection, 0 disables the refinement.
+		 */
+		void SetNumRefinementPasses(const unsigned int numPasses_)
+		{
+			_numRefinementPasses = numPasses_;
+		}
+
+		unsigned int GetNumRefinementPasses() const
+		{
+			return _numRefinementPasses;
+		}
+
+		/**
+		 * Allowed imbalance for the refinement, e.g. 0.03 lets a part grow to 103% of the average size.
+		 */
+		void SetImbalance(const float imbalance_)
+		{
+			_imbalance = imbalance_;
+		}
+
+		float GetImbalance() const
+		{
+			return _imbalance;
+		}
+
+		/**
+		 * Number of one-ring halo layers added around each extracted part.
+		 */
+		void SetNumHaloLayers(const unsigned int numLayers_)
+		{
+			_numHaloLayers = numLayers_;
+		}
+
+		unsigned int GetNumHaloLayers() const
+		{
+			return _numHaloLayers;
+		}
+
+		/**
+		 * Assigns every tetrahedron to a part. Returns false if the mesh has fewer tetrahedra than parts.
+		 */
+		bool Partition(TetrahedronTopology& topology_);
+
+		const std::vector<unsigned int>& GetTetraParts() const
+		{
+			return _tetraParts;
+		}
+
+		/**
+		 * Number of interior faces whose two tetrahedra are in different parts.
+		 */
+		size_t GetNumCutFaces() const
+		{
+			return _numCutFaces;
+		}
+
+		void GetPartSizes(std::vector<unsigned int>& sizes_) const;
+
+		/**
+		 * Builds the submesh of part_ including the halo layers. topology_ has to be the mesh
+		 * passed to the last Partition() call.
+		 */
+		bool ExtractPart(TetrahedronTopology& topology_, const unsigned int part_, MeshPart& meshPart_) const;
+
+		/**
+		 * Writes every part as fileName_.<part>.node / .ele (Tetgen, see TetgenWriter) and
+		 * fileName_.<part>.map, which lists the part layout followed by the global index and the
+		 * owning part of every local vertex and tetrahedron.
+		 */
+		bool WriteParts(TetrahedronTopology& topology_, const std::string& fileName_) const;
+
+		static bool WritePart(const MeshPart& meshPart_, const std::string& fileName_);
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* MESHPARTITION_H_ */
@@ -10,8 +10,21 @@
 
 #pragma once
 
+#include <limits>
 #include "OctreeNode.h"
 
+// result of a closest point or ray query
+struct OctreeHit
+{
+	static const unsigned int NoTriangle = 0xFFFFFFFFu;
+
+	Vec3f			point;		// closest surface point or ray hit point
+	float			distance;	// distance to the query point or ray parameter of the hit
+	unsigned int	triangle;	// surface triangle, NoTriangle if nothing was found
+
+	OctreeHit() : distance(std::numeric_limits<float>::max()), triangle(NoTriangle) {}
+};
+
 class DLL_EXPORT Octree
 {
 private:
@@ -20,19 +33,89 @@ private:
 	const std::vector<Vec3f>*	_inPoints;	// surface points for which we want to build the Octree
 	const std::vector<Triangle>* _inTris;	// surface triangle indices
 	Vec3f						_minBC, _maxBC;
+	OctreeContext				_context;	// shared state of all nodes, so several octrees can be built and used concurrently
 
 	void generateBoundingCube();
 
+	void closestPointRecursive(const OctreeNode* node_, const Vec3f& point_, OctreeHit& hit_, float& bestSquaredDistance_) const;
+
+	void rayCastRecursive(const OctreeNode* node_, const Vec3f& origin_, const Vec3f& direction_, OctreeHit& hit_) const;
+
+	// collects the triangles hit by the ray (t > 0) into hits_, may contain duplicates
+	void rayHitsRecursive(const OctreeNode* node_, const Vec3f& origin_, const Vec3f& direction_, std::vector<unsigned int>& hits_) const;
+
+	// inside test that reuses hits_ as scratch buffer
+	bool isInside(const Vec3f& point_, std::vector<unsigned int>& hits_) const;
+
+	// sets the labels of inner nodes from their leafs
+	OctreeCellLabel aggregateCellLabels(OctreeNode* node_);
 
 public:
 	Octree(const unsigned int maxDepth_, std::vector<Vec3f>* inPoints_, std::vector<Triangle>* inTris_);
+	// builds an adaptive octree, see OctreeBuildOptions for the termination criteria
+	Octree(const OctreeBuildOptions& options_, std::vector<Vec3f>* inPoints_, std::vector<Triangle>* inTris_);
 	~Octree();
 
+	Octree(const Octree&) = delete;
+	Octree& operator=(const Octree&) = delete;
+
 	OctreeNode* getRootNode();
 
+	const OctreeNode* getRootNode() const
+	{
+		return _root;
+	}
+
+	// computes the cube around the bounding box of points_ that is used as the root node
+	static void computeBoundingCube(const std::vector<Vec3f>& points_, Vec3f& minBC_, Vec3f& maxBC_);
+
 	const unsigned int getDepth() const
 	{
 		return _maxDepth;
 	}
+
+	const OctreeBuildOptions& getBuildOptions() const
+	{
+		return _context.options;
+	}
+
+	// splits leafs until face neighbouring leafs differ by at most one level, returns the number of splits
+	unsigned int balance();
+
+	/**
+	 *	Labels all leafs as SURFACE, OUTSIDE or INSIDE (see OctreeNode::getCellLabel).
+	 *	Completes the tree first, so the leafs partition the bounding cube. The empty leafs
+	 *	are grouped into face connected components; components touching the boundary of
+	 *	the cube are outside, every other component is decided by one parity test.
+	 */
+	void classifyCells();
+
+	/**
+	 *	Writes the cell labels to a dense grid with 2^level_ cells per axis, x varies fastest.
+	 *	Cells that contain a finer part of the tree get the label of that subtree.
+	 */
+	void exportOccupancyGrid(const unsigned int level_, std::vector<unsigned char>& grid_) const;
+
+	/**
+	 *	Spatial queries over the triangle lists of the leafs. All queries are const and can
+	 *	run concurrently; the batched variants split the queries across the worker threads.
+	 */
+
+	// closest surface point to point_ within maxDistance_, returns false if there is none
+	bool closestPoint(const Vec3f& point_, OctreeHit& hit_, const float maxDistance_=std::numeric_limits<float>::max()) const;
+
+	void closestPoints(const std::vector<Vec3f>& points_, std::vector<OctreeHit>& hits_, const float maxDistance_=std::numeric_limits<float>::max()) const;
+
+	// first triangle hit by origin_ + t * direction_ with 0 <= t <= maxT_ (t in units of direction_),
+	// both triangle sides count, returns false if there is no hit
+	bool rayCast(const Vec3f& origin_, const Vec3f& direction_, OctreeHit& hit_, const float maxT_=std::numeric_limits<float>::max()) const;
+
+	void rayCasts(const std::vector<Vec3f>& origins_, const std::vector<Vec3f>& directions_, std::vector<OctreeHit>& hits_, const float maxT_=std::numeric_limits<float>::max()) const;
+
+	// inside test for a closed surface by the parity of ray crossings; three skewed rays
+	// vote, so a single ray through an edge or vertex does not flip the result
+	bool isInside(const Vec3f& point_) const;
+
+	void isInside(const std::vector<Vec3f>& points_, std::vector<unsigned char>& inside_) const;
 	
 };
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <vector>
 #include "TetraToolsExports.h"
 #include "GeometryTypes.h"
+#include "ParallelUtils.h"
 //#include <vld.h>
 
 struct PointQuadrant
@@ -22,29 +23,95 @@ struct PointQuadrant
 	unsigned int result;
 };
 
+// build parameters of an octree; by default nodes are split until maxDepth is reached
+struct OctreeBuildOptions
+{
+	unsigned int	maxDepth;				// maximum depth of the octree
+	unsigned int	maxTrianglesPerLeaf;	// nodes with at most this many triangles are not split, 0 disables
+	float			minLeafSize;			// nodes are not split into children with a smaller edge length, 0 disables
+	float			maxNormalAngle;			// nodes whose triangle normals all lie within this angle (radians) of
+											// their mean normal are considered flat and not split, 0 disables
+	bool			completeChildren;		// split nodes into all 8 children, empty children become empty leafs
+	bool			conservativeOverlap;	// enlarge the child test boxes slightly and fall back to the bounding box
+											// of a triangle that fails all 8 child tests, so triangles lying in a split
+											// plane are not dropped; recommended with completeChildren and balancing
+
+	explicit OctreeBuildOptions(const unsigned int maxDepth_=8) : maxDepth(maxDepth_), maxTrianglesPerLeaf(0), minLeafSize(0.0f), maxNormalAngle(0.0f), completeChildren(false), conservativeOverlap(false) {}
+};
+
+// directions of the face neighbours (see the quadrant layout in OctreeNode.cpp)
+enum OctreeFace
+{
+	OCTREE_FACE_LEFT = 0,	// -x
+	OCTREE_FACE_RIGHT,		// +x
+	OCTREE_FACE_BOTTOM,		// -y
+	OCTREE_FACE_TOP,		// +y
+	OCTREE_FACE_BACK,		// -z
+	OCTREE_FACE_FRONT		// +z
+};
+
+// classification of octree cells, see Octree::classifyCells
+enum OctreeCellLabel
+{
+	OCTREE_CELL_UNKNOWN = 0,
+	OCTREE_CELL_OUTSIDE,
+	OCTREE_CELL_INSIDE,
+	OCTREE_CELL_SURFACE		// the cell overlaps surface triangles
+};
+
+// state shared by all nodes of one octree, owned by the Octree
+struct OctreeContext
+{
+	const std::vector<Vec3f>*		points;		// pointer to surface mesh points
+	const std::vector<Triangle>*	tris;		// pointer to surface mesh triangles
+	OctreeBuildOptions				options;
+};
+
 class DLL_EXPORT OctreeNode
 {
 private:
 	const OctreeNode*			_parent;
+	const OctreeContext*		_context; // shared by all nodes of the tree
 	unsigned int				_depth; // current depth level of our octree
-	static unsigned int			_maxDepth; // static int for maximum depth of our octree
 	std::vector<OctreeNode*>	_nodes; // a maximum of 8 children is possible
-	static std::vector<Vec3f>*	_points; // pointer to surface mesh points
-	static std::vector<Triangle>* _tris;
 	//std::vector<Vec3f*>			_pointsInSelf;	// list of point-pointers to know which surface points are contained in the current child
 	Vec3f						_minBC, _maxBC;	// 3D points for opposite corners
+	std::vector<unsigned int>	_triangles;	// indices of the triangles overlapping this node, only kept for leafs
 	const int					_quadrant;
+	unsigned char				_cellLabel;	// OctreeCellLabel, set by Octree::classifyCells
 	
-	void buildNode();
+	// classifies our triangles against the 8 child boxes and creates the occupied children
+	// (without building them); the classification is split across threads if requested
+	void buildNode(const bool classifyInParallel_);
+
+	// returns false if one of the termination criteria of the build options holds for this node
+	bool shouldSplit() const;
+
+	// creates all 8 children and hands them our triangles, regardless of the termination criteria
+	void split();
+
+	// builds this node and its whole subtree; the nodes above taskDepth_ are split level
+	// by level, the subtrees at taskDepth_ are built concurrently by one ParallelFor,
+	// the resulting tree is the same for any number of threads
+	void buildSubtree(const unsigned int taskDepth_);
+
+	// builds this node and its whole subtree on the calling thread
+	void buildSubtreeSerial();
 
 	// tmp children for return....
 	std::vector<OctreeNode*>	_tmpChildren;
 
+	// appends the leafs of the subtree in getLeafs order
+	void collectLeafs(const bool leafsOnly_, std::vector<OctreeNode*>& leafs_);
+
+	template <typename Filter, typename Visitor>
+	bool visitLevelRecursive(const unsigned int depth_, const Filter& filter_, const Visitor& visitor_) const;
+
 public:
-	// only necessary for root node
-	OctreeNode(const unsigned int maxDepth_, std::vector<Vec3f>* inPoints_, const Vec3f& minBC_, const Vec3f& maxBC_, std::vector<Triangle>* inTris_);
-	// this constructor is only for the child nodes
-	OctreeNode(const OctreeNode* parent_, const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int depth_, const int quadrant_);
+	// only necessary for root node, context_ has to outlive the tree
+	OctreeNode(const OctreeContext* context_, const Vec3f& minBC_, const Vec3f& maxBC_);
+	// this constructor is only for the child nodes, triangles_ (the triangles overlapping the child) is taken over
+	OctreeNode(const OctreeNode* parent_, const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int depth_, const int quadrant_, std::vector<unsigned int>& triangles_);
 	~OctreeNode();
 
 	/**
@@ -58,14 +125,98 @@ public:
 
 	const Vec3f& getMaxBC() const;
 
+	const OctreeContext* getContext() const
+	{
+		return _context;
+	}
+
+	// returns the indices (into the surface triangle list) of all triangles overlapping
+	// this node; only leafs keep their list, it is empty for inner nodes
+	const std::vector<unsigned int>& getTriangles() const;
+
+	// computes the box of the child in quadrant_ of the cube minBC_/maxBC_
+	static void getChildBounds(const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int quadrant_, Vec3f& childMin_, Vec3f& childMax_);
+
+	// returns a mask with bit q set when the triangle overlaps the child box in quadrant q
+	// of the cube minBC_/maxBC_ (SAT test against each of the 8 child boxes), see
+	// OctreeBuildOptions::conservativeOverlap for conservative_
+	static unsigned int getChildOverlapMask(const Vec3f& minBC_, const Vec3f& maxBC_, const Vec3f triPoints_[3], const bool conservative_=false);
+
 	// returns true if the current node has children
 	const bool hasChildren() const;
 
+	/**
+	 *	Returns the neighbour across face_ with the same depth or, if that does not exist,
+	 *	the deepest leaf larger than this node that covers the face. Returns NULL at the
+	 *	boundary of the bounding cube and for empty quadrants of partially split nodes.
+	 */
+	const OctreeNode* getFaceNeighbour(const OctreeFace face_) const;
+
+	OctreeNode* getFaceNeighbour(const OctreeFace face_);
+
+	// true if this node is node_ or one of its descendants
+	bool isInSubtreeOf(const OctreeNode* node_) const;
+
+	/**
+	 *	Adds empty leafs for the empty quadrants of all split nodes, so the leafs
+	 *	partition the whole bounding cube.
+	 */
+	void completeChildren();
+
+	/**
+	 *	Splits leafs of this subtree until face neighbouring leafs differ by at most one
+	 *	level (2:1 balance). Completes the subtree first. Returns the number of split leafs.
+	 */
+	unsigned int balance();
+
 	// returns the smalles children i.e. the "leafs" as a recursively generated list
 	// when leafsOnly is set to true, we will only return the smallest child leafs,
 	// while ignoring the containing cubes.
+	// The list is stored in the node, prefer the visit* functions below for
+	// read-only or concurrent traversals.
 	const std::vector<OctreeNode*>& getLeafs(const bool leafsOnly_=false);
 
+	/**
+	 *	Traversal without allocations or modifications of the tree, safe to run from several threads.
+	 *	visitor_(const OctreeNode&) is called for every visited node. filter_(const OctreeNode&)
+	 *	returns false for nodes that are skipped together with their subtree, see the
+	 *	Octree*Filter structs below.
+	 */
+
+	// depth-first pre-order (node, then its children in quadrant order)
+	template <typename Visitor>
+	void visitDepthFirst(const Visitor& visitor_) const;
+
+	template <typename Filter, typename Visitor>
+	void visitDepthFirst(const Filter& filter_, const Visitor& visitor_) const;
+
+	// breadth-first (level by level); without a queue every level is reached by a
+	// depth-first walk from this node, so the upper levels are walked several times
+	template <typename Visitor>
+	void visitBreadthFirst(const Visitor& visitor_) const;
+
+	template <typename Filter, typename Visitor>
+	void visitBreadthFirst(const Filter& filter_, const Visitor& visitor_) const;
+
+	// visits the nodes at depth_ (absolute depth in the tree), returns false if there are none
+	template <typename Filter, typename Visitor>
+	bool visitLevel(const unsigned int depth_, const Filter& filter_, const Visitor& visitor_) const;
+
+	// visits the leafs (nodes without children) only, in getLeafs order
+	template <typename Visitor>
+	void visitLeafs(const Visitor& visitor_) const;
+
+	template <typename Filter, typename Visitor>
+	void visitLeafs(const Filter& filter_, const Visitor& visitor_) const;
+
+	// calls function_(const OctreeNode&) for all leafs that pass filter_ on all worker threads;
+	// the subtrees are split among the threads, so function_ must be thread-safe
+	template <typename Function>
+	void parallelForLeafs(const Function& function_) const;
+
+	template <typename Filter, typename Function>
+	void parallelForLeafs(const Filter& filter_, const Function& function_) const;
+
 	const unsigned int getDepth() const
 	{
 		return _depth;
@@ -76,5 +227,262 @@ public:
 		return _quadrant;
 	}
 
+	// OctreeCellLabel of a leaf; inner nodes are SURFACE if one of their leafs is,
+	// otherwise they have the common label of their leafs
+	OctreeCellLabel getCellLabel() const
+	{
+		return (OctreeCellLabel)_cellLabel;
+	}
+
+	void setCellLabel(const OctreeCellLabel label_)
+	{
+		_cellLabel = (unsigned char)label_;
+	}
+
+	// appends the leafs of this subtree that touch face_ of this node
+	void getFaceLeafs(const OctreeFace face_, std::vector<const OctreeNode*>& leafs_) const;
+
 };
  
+
+// accepts every node
+struct OctreeNoFilter
+{
+	bool operator()(const OctreeNode&) const
+	{
+		return true;
+	}
+};
+
+// accepts the nodes from depth 0 to maxDepth (use visitLevel for the nodes at one depth)
+struct OctreeDepthFilter
+{
+	unsigned int maxDepth;
+
+	explicit OctreeDepthFilter(const unsigned int maxDepth_) : maxDepth(maxDepth_) {}
+
+	bool operator()(const OctreeNode& node_) const
+	{
+		return node_.getDepth() <= maxDepth;
+	}
+};
+
+// accepts the nodes overlapping the box minBC/maxBC
+struct OctreeBoxFilter
+{
+	Vec3f minBC, maxBC;
+
+	OctreeBoxFilter(const Vec3f& minBC_, const Vec3f& maxBC_) : minBC(minBC_), maxBC(maxBC_) {}
+
+	bool operator()(const OctreeNode& node_) const
+	{
+		const Vec3f& nodeMin = node_.getMinBC();
+		const Vec3f& nodeMax = node_.getMaxBC();
+		return nodeMin.x <= maxBC.x && nodeMax.x >= minBC.x
+			&& nodeMin.y <= maxBC.y && nodeMax.y >= minBC.y
+			&& nodeMin.z <= maxBC.z && nodeMax.z >= minBC.z;
+	}
+};
+
+// accepts the nodes that are not completely outside one of the 6 frustum planes;
+// a point p is inside plane i if normals[i].dot(p) + offsets[i] >= 0
+struct OctreeFrustumFilter
+{
+	Vec3f normals[6];
+	float offsets[6];
+
+	OctreeFrustumFilter(const Vec3f normals_[6], const float offsets_[6])
+	{
+		for (unsigned int i=0; i<6; ++i)
+		{
+			normals[i] = normals_[i];
+			offsets[i] = offsets_[i];
+		}
+	}
+
+	bool operator()(const OctreeNode& node_) const
+	{
+		const Vec3f& nodeMin = node_.getMinBC();
+		const Vec3f& nodeMax = node_.getMaxBC();
+		for (unsigned int i=0; i<6; ++i)
+		{
+			// the box corner furthest along the plane normal
+			const Vec3f corner(normals[i].x >= 0.0f ? nodeMax.x : nodeMin.x,
+							   normals[i].y >= 0.0f ? nodeMax.y : nodeMin.y,
+							   normals[i].z >= 0.0f ? nodeMax.z : nodeMin.z);
+			if (normals[i].dot(corner) + offsets[i] < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+// accepts the nodes accepted by both filters
+template <typename FilterA, typename FilterB>
+struct OctreeAndFilter
+{
+	FilterA a;
+	FilterB b;
+
+	OctreeAndFilter(const FilterA& a_, const FilterB& b_) : a(a_), b(b_) {}
+
+	bool operator()(const OctreeNode& node_) const
+	{
+		return a(node_) && b(node_);
+	}
+};
+
+template <typename Visitor>
+void OctreeNode::visitDepthFirst(const Visitor& visitor_) const
+{
+	visitDepthFirst(OctreeNoFilter(), visitor_);
+}
+
+template <typename Filter, typename Visitor>
+void OctreeNode::visitDepthFirst(const Filter& filter_, const Visitor& visitor_) const
+{
+	if (!filter_(*this))
+	{
+		return;
+	}
+	visitor_(*this);
+	for (unsigned int i=0; i<8; ++i)
+	{
+		if (_nodes[i] != NULL)
+		{
+			_nodes[i]->visitDepthFirst(filter_, visitor_);
+		}
+	}
+}
+
+template <typename Filter, typename Visitor>
+bool OctreeNode::visitLevelRecursive(const unsigned int depth_, const Filter& filter_, const Visitor& visitor_) const
+{
+	if (!filter_(*this))
+	{
+		return false;
+	}
+	if (_depth == depth_)
+	{
+		visitor_(*this);
+		return true;
+	}
+	bool found = false;
+	for (unsigned int i=0; i<8; ++i)
+	{
+		if (_nodes[i] != NULL)
+		{
+			found = _nodes[i]->visitLevelRecursive(depth_, filter_, visitor_) || found;
+		}
+	}
+	return found;
+}
+
+template <typename Filter, typename Visitor>
+bool OctreeNode::visitLevel(const unsigned int depth_, const Filter& filter_, const Visitor& visitor_) const
+{
+	if (depth_ < _depth)
+	{
+		return false;
+	}
+	return visitLevelRecursive(depth_, filter_, visitor_);
+}
+
+template <typename Visitor>
+void OctreeNode::visitBreadthFirst(const Visitor& visitor_) const
+{
+	visitBreadthFirst(OctreeNoFilter(), visitor_);
+}
+
+template <typename Filter, typename Visitor>
+void OctreeNode::visitBreadthFirst(const Filter& filter_, const Visitor& visitor_) const
+{
+	for (unsigned int depth=_depth; visitLevel(depth, filter_, visitor_); ++depth)
+	{
+	}
+}
+
+template <typename Visitor>
+void OctreeNode::visitLeafs(const Visitor& visitor_) const
+{
+	visitLeafs(OctreeNoFilter(), visitor_);
+}
+
+template <typename Filter, typename Visitor>
+void OctreeNode::visitLeafs(const Filter& filter_, const Visitor& visitor_) const
+{
+	if (!filter_(*this))
+	{
+		return;
+	}
+	bool isLeaf = true;
+	for (unsigned int i=0; i<8; ++i)
+	{
+		if (_nodes[i] != NULL)
+		{
+			_nodes[i]->visitLeafs(filter_, visitor_);
+			isLeaf = false;
+		}
+	}
+	if (isLeaf)
+	{
+		visitor_(*this);
+	}
+}
+
+template <typename Function>
+void OctreeNode::parallelForLeafs(const Function& function_) const
+{
+	parallelForLeafs(OctreeNoFilter(), function_);
+}
+
+template <typename Filter, typename Function>
+void OctreeNode::parallelForLeafs(const Filter& filter_, const Function& function_) const
+{
+	if (!filter_(*this))
+	{
+		return;
+	}
+	// expand the tree until there are a few subtrees per thread; leafs stay in
+	// place, so the subtrees keep the leaf order of visitLeafs
+	const size_t numSubtrees = 4 * TetraTools::GetNumThreads();
+	std::vector<const OctreeNode*> subtrees(1, this);
+	std::vector<const OctreeNode*> expanded;
+	while (subtrees.size() < numSubtrees)
+	{
+		expanded.clear();
+		bool split = false;
+		for (size_t s=0; s<subtrees.size(); ++s)
+		{
+			size_t numChildren = 0;
+			for (unsigned int i=0; i<8; ++i)
+			{
+				const OctreeNode* child = subtrees[s]->_nodes[i];
+				if (child != NULL && filter_(*child))
+				{
+					expanded.push_back(child);
+					++numChildren;
+				}
+			}
+			if (numChildren == 0)
+			{
+				expanded.push_back(subtrees[s]);
+			}
+			split = split || numChildren > 0;
+		}
+		if (!split)
+		{
+			break;
+		}
+		subtrees.swap(expanded);
+	}
+	TetraTools::ParallelFor(0, subtrees.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t s=b_; s<e_; ++s)
+		{
+			subtrees[s]->visitLeafs(filter_, function_);
+		}
+	}, 1);
+}
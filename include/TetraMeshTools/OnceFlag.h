@@ -0,0 +1,82 @@
+/*
+ * OnceFlag.h
+ *
+ * A resettable once-flag for lazily generated topology data.
+ *
+ * Unlike std::once_flag this flag can be invalidated again when the
+ * underlying data changes (e.g. after Init() or SetEdges()), and it
+ * tracks validity explicitly, so an empty result is not recomputed
+ * on every access.
+ */
+
+#ifndef ONCEFLAG_H_
+#define ONCEFLAG_H_
+
+#include <atomic>
+#include <mutex>
+
+namespace TetraTools
+{
+	class OnceFlag
+	{
+	private:
+		std::atomic<bool>	_valid;
+		std::mutex			_mutex;
+
+	public:
+		OnceFlag() : _valid(false)
+		{}
+
+		/// copying a flag copies the validity state only
+		OnceFlag(const OnceFlag& other_) : _valid(other_.IsValid())
+		{}
+
+		OnceFlag& operator=(const OnceFlag& other_)
+		{
+			_valid.store(other_.IsValid(), std::memory_order_release);
+			return *this;
+		}
+
+		bool IsValid() const
+		{
+			return _valid.load(std::memory_order_acquire);
+		}
+
+		/**
+		 * Runs generator_ if the flag is not valid yet and marks it valid afterwards.
+		 * Concurrent callers block until the first caller has finished generating.
+		 */
+		template <typename Generator>
+		void CallOnce(const Generator& generator_)
+		{
+			if (IsValid())
+				return;
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!IsValid())
+			{
+				generator_();
+				_valid.store(true, std::memory_order_release);
+			}
+		}
+
+		/**
+		 * Marks the data as valid, e.g. after it has been set or generated explicitly.
+		 */
+		void SetValid()
+		{
+			_valid.store(true, std::memory_order_release);
+		}
+
+		/**
+		 * Marks the data as outdated. Must not be called while other threads
+		 * are reading the guarded data.
+		 */
+		void Invalidate()
+		{
+			_valid.store(false, std::memory_order_release);
+		}
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* ONCEFLAG_H_ */
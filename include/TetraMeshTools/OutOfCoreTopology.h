@@ -0,0 +1,138 @@
+/*
+ * OutOfCoreTopology.h
+ *
+ * Topology storage for tetrahedral meshes that are larger than RAM.
+ *
+ * Vertices, tetrahedra and all derived arrays live in memory-mapped files
+ * in one directory. The derived structures are built by streaming over the
+ * tetrahedra in chunks that fit into the memory budget: the faces and the
+ * vertex-tetrahedron incidences of every chunk are sorted in memory and
+ * merged from disk (see ExternalSort.h), so duplicate faces are found and
+ * the per-vertex lists are written in one sequential pass each.
+ *
+ * The arrays use the same element types as TetrahedronTopology. Triangles
+ * are numbered in sorted vertex order here, so triangle indices differ from
+ * the in-memory topology; tetrahedron and vertex indices are the same.
+ */
+
+#ifndef OUTOFCORETOPOLOGY_H_
+#define OUTOFCORETOPOLOGY_H_
+
+#include <string>
+#include "GeometryTypes.h"
+#include "TetrahedronTopology.h"
+#include "MappedFile.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	class DLL_EXPORT OutOfCoreTopology
+	{
+	protected:
+		std::string								_directory;
+		size_t									_memoryBudget;				/// bytes used for in-memory chunks
+
+		MappedArray<Vec3f>						_vertices;
+		MappedArray<Tetrahedron>				_tetrahedra;
+		MappedArray<Triangle>					_triangles;
+		MappedArray<Triangle>					_surfaceTriangles;
+		MappedArray<TetrahedronTriangles>		_tetraTriangles;
+		MappedArray<TetrahedronVertex>			_tetraVertices;
+		MappedArray<PrimitivesPerVertex>		_vertexTetrahedraLookup;
+
+		std::string GetFileName(const char* name_) const;
+
+		/**
+		 * Number of records of recordSize_ bytes that fit into the memory budget.
+		 */
+		size_t GetChunkSize(const size_t recordSize_) const;
+
+	public:
+		/**
+		 * All arrays are stored as files in directory_ (which must exist).
+		 * memoryBudget_ bounds the size of the in-memory sort chunks.
+		 */
+		OutOfCoreTopology(const std::string& directory_, const size_t memoryBudget_ = (size_t)1 << 30);
+
+		~OutOfCoreTopology();
+
+		/**
+		 * Creates the vertex and tetrahedron files with the given sizes. Fill them through
+		 * GetVertices() / GetTetrahedra() before generating any derived structure.
+		 */
+		bool Create(const size_t numVertices_, const size_t numTetras_);
+
+		/**
+		 * Creates the vertex and tetrahedron files from an in-memory topology.
+		 */
+		bool Create(TetrahedronTopology& topology_);
+
+		/**
+		 * Maps the files of a previously created topology; derived structures are mapped if they exist.
+		 */
+		bool Open();
+
+		void Close();
+
+		/**
+		 * Extracts the unique triangles, the surface triangles and the triangles of every
+		 * tetrahedron with an external sort of all tetrahedron faces.
+		 */
+		bool GenerateTriangles();
+
+		/**
+		 * Builds the tetrahedra-per-vertex lists and their lookup table (64-bit offsets)
+		 * with an external sort of all vertex-tetrahedron incidences.
+		 */
+		bool GenerateTetrahedronMap();
+
+		MappedArray<Vec3f>& GetVertices()
+		{
+			return _vertices;
+		}
+
+		MappedArray<Tetrahedron>& GetTetrahedra()
+		{
+			return _tetrahedra;
+		}
+
+		const MappedArray<Triangle>& GetTriangles() const
+		{
+			return _triangles;
+		}
+
+		const MappedArray<Triangle>& GetSurfaceTriangles() const
+		{
+			return _surfaceTriangles;
+		}
+
+		const MappedArray<TetrahedronTriangles>& GetTetraTriangles() const
+		{
+			return _tetraTriangles;
+		}
+
+		const MappedArray<TetrahedronVertex>& GetTetrasPerVertices() const
+		{
+			return _tetraVertices;
+		}
+
+		const MappedArray<PrimitivesPerVertex>& GetTetrasPerVertexLookupTable() const
+		{
+			return _vertexTetrahedraLookup;
+		}
+
+		size_t GetNumVertices() const
+		{
+			return _vertices.size();
+		}
+
+		size_t GetNumTetras() const
+		{
+			return _tetrahedra.size();
+		}
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* OUTOFCORETOPOLOGY_H_ */
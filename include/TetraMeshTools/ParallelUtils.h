@@ -0,0 +1,132 @@
+/*
+ * ParallelUtils.h
+ *
+ * Small helpers for splitting loops over mesh primitives across threads.
+ * Only relies on std::thread so it can be used wherever the topology
+ * containers are used.
+ */
+
+#ifndef PARALLELUTILS_H_
+#define PARALLELUTILS_H_
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+namespace TetraTools
+{
+	namespace Detail
+	{
+		/// thread count set by SetNumThreads, 0 for the hardware concurrency
+		inline std::atomic<unsigned int>& NumThreadsOverride()
+		{
+			static std::atomic<unsigned int> numThreads(0);
+			return numThreads;
+		}
+	}
+
+	/**
+	 * Limits the number of worker threads used by ParallelFor and the code built on it,
+	 * 0 restores the default (the hardware concurrency).
+	 */
+	inline void SetNumThreads(const unsigned int numThreads_)
+	{
+		Detail::NumThreadsOverride() = numThreads_;
+	}
+
+	/**
+	 * Returns the number of worker threads used by ParallelFor (at least 1).
+	 */
+	inline unsigned int GetNumThreads()
+	{
+		const unsigned int numThreads = Detail::NumThreadsOverride();
+		if (numThreads > 0)
+			return numThreads;
+		const unsigned int n = std::thread::hardware_concurrency();
+		return (n > 0) ? n : 1;
+	}
+
+	/**
+	 * Calls function_(rangeBegin, rangeEnd) for disjoint sub-ranges of [begin_, end_).
+	 * Ranges smaller than minChunkSize_ per thread are processed on the calling thread.
+	 * The function object must be safe to call concurrently for disjoint ranges.
+	 */
+	template <typename Function>
+	void ParallelFor(const size_t begin_, const size_t end_, const Function& function_, const size_t minChunkSize_ = 1024)
+	{
+		if (end_ <= begin_)
+			return;
+		const size_t count = end_ - begin_;
+		size_t numChunks = std::min<size_t>(GetNumThreads(), (count + minChunkSize_ - 1) / std::max<size_t>(minChunkSize_, 1));
+		if (numChunks <= 1)
+		{
+			function_(begin_, end_);
+			return;
+		}
+		const size_t chunkSize = (count + numChunks - 1) / numChunks;
+		std::vector<std::thread> threads;
+		threads.reserve(numChunks - 1);
+		for (size_t c=1; c<numChunks; ++c)
+		{
+			const size_t b = begin_ + c * chunkSize;
+			const size_t e = std::min(end_, b + chunkSize);
+			if (b >= e)
+				break;
+			threads.push_back(std::thread([&function_, b, e]() { function_(b, e); }));
+		}
+		/// the calling thread takes the first chunk
+		function_(begin_, std::min(end_, begin_ + chunkSize));
+		for (size_t t=0; t<threads.size(); ++t)
+		{
+			threads[t].join();
+		}
+	}
+
+	/**
+	 * Sorts [begin_, end_) with compare_ by sorting one run per thread and merging
+	 * neighbouring runs pairwise. Like std::sort the result is not stable, so use
+	 * a compare_ that breaks ties if a deterministic order is required.
+	 */
+	template <typename Iterator, typename Compare>
+	void ParallelSort(Iterator begin_, Iterator end_, const Compare& compare_, const size_t minChunkSize_ = 16384)
+	{
+		const size_t count = end_ - begin_;
+		const size_t numRuns = std::min<size_t>(GetNumThreads(), count / std::max<size_t>(minChunkSize_, 1));
+		if (numRuns <= 1)
+		{
+			std::sort(begin_, end_, compare_);
+			return;
+		}
+		const size_t runSize = (count + numRuns - 1) / numRuns;
+		std::vector<size_t> runBegin(numRuns + 1);
+		for (size_t r=0; r<=numRuns; ++r)
+		{
+			runBegin[r] = std::min(count, r * runSize);
+		}
+		ParallelFor(0, numRuns, [&](size_t b_, size_t e_)
+		{
+			for (size_t r=b_; r<e_; ++r)
+				std::sort(begin_ + runBegin[r], begin_ + runBegin[r + 1], compare_);
+		}, 1);
+		for (size_t width=1; width<numRuns; width*=2)
+		{
+			const size_t numMerges = (numRuns + 2 * width - 1) / (2 * width);
+			ParallelFor(0, numMerges, [&](size_t b_, size_t e_)
+			{
+				for (size_t m=b_; m<e_; ++m)
+				{
+					const size_t lo = m * 2 * width;
+					const size_t mid = std::min(lo + width, numRuns);
+					const size_t hi = std::min(lo + 2 * width, numRuns);
+					if (mid < hi)
+						std::inplace_merge(begin_ + runBegin[lo], begin_ + runBegin[mid], begin_ + runBegin[hi], compare_);
+				}
+			}, 1);
+		}
+	}
+
+}	/// end namespace TetraTools
+
+#endif /* PARALLELUTILS_H_ */
@@ -17,17 +17,17 @@ void findMinMax(float x0_, float x1_, float x2_, float& min_, float& max_);
 
 int planeBoxOverlap(const Vec3f& normal, const Vec3f& vert, const Vec3f& maxbox);
 
-int axisTest_x01(const float a, const float b, const float fa, const float fb);
+int axisTest_x01(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v2_, const Vec3f& boxhalfsize_);
 
-int axisTest_x2(const float a, const float b, const float fa, const float fb);
+int axisTest_x2(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v1_, const Vec3f& boxhalfsize_);
 
-int axisTest_y02(const float a, const float b, const float fa, const float fb);
+int axisTest_y02(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v2_, const Vec3f& boxhalfsize_);
 
-int axisTest_y1(const float a, const float b, const float fa, const float fb);
+int axisTest_y1(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v1_, const Vec3f& boxhalfsize_);
 
-int axisTest_z12(const float a, const float b, const float fa, const float fb);
+int axisTest_z12(const float a, const float b, const float fa, const float fb, const Vec3f& v1_, const Vec3f& v2_, const Vec3f& boxhalfsize_);
 
-int axisTest_z0(const float a, const float b, const float fa, const float fb);
+int axisTest_z0(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v1_, const Vec3f& boxhalfsize_);
 
 /**
  *	use separating axis theorem to test overlap between triangle and box
@@ -37,5 +37,23 @@ int axisTest_z0(const float a, const float b, const float fa, const float fb);
  *    2) normal of the triangle
  *    3) crossproduct(edge from tri, {x,y,z}-direction)
  *       this gives 3x3=9 more tests
+ *	The test keeps no global state and is safe to call from several threads.
  */
 int triBoxOverlap(const Vec3f& boxcenter, const Vec3f& boxhalfsize, const Vec3f triverts[3]);
+
+/**
+ *	Batched triBoxOverlap: tests one triangle against eight boxes of the same size, four
+ *	boxes per SIMD step (see SimdFloat4.h). The boxes are rejected against the bounding
+ *	box of the triangle before the edge axes are tested.
+ *	Returns a mask with bit k set if the triangle overlaps the box around boxcenters[k],
+ *	the result is the same as calling triBoxOverlap for every box.
+ */
+unsigned int triBoxOverlap8(const Vec3f boxcenters[8], const Vec3f& boxhalfsize, const Vec3f triverts[3]);
+
+/**
+ *	Batched triBoxOverlap: tests numTris triangles against one box, four triangles per SIMD
+ *	step. triverts holds three consecutive vertices per triangle, overlaps[i] is set to
+ *	1 if triangle i overlaps the box and to 0 otherwise.
+ *	Returns the number of overlapping triangles.
+ */
+unsigned int triBoxOverlapN(const Vec3f& boxcenter, const Vec3f& boxhalfsize, const Vec3f* triverts, const unsigned int numTris, unsigned char* overlaps);
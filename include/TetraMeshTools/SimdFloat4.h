@@ -0,0 +1,155 @@
+/*
+ * SimdFloat4.h
+ *
+ * A minimal 4-wide float vector for the batched geometry kernels.
+ *
+ * Maps to SSE when the compiler targets it and to a plain float[4]
+ * otherwise, so a kernel written against Float4 only exists once.
+ * Define TETRATOOLS_NO_SIMD to force the scalar version.
+ */
+
+#ifndef SIMDFLOAT4_H_
+#define SIMDFLOAT4_H_
+
+#include <math.h>
+
+#if !defined(TETRATOOLS_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#ifndef TETRATOOLS_USE_SSE
+#define TETRATOOLS_USE_SSE
+#endif
+#endif
+
+namespace TetraTools
+{
+	struct Float4
+	{
+#ifdef TETRATOOLS_USE_SSE
+		__m128 v;
+
+		static Float4 Set(const float a_, const float b_, const float c_, const float d_)
+		{
+			Float4 r; r.v = _mm_setr_ps(a_, b_, c_, d_); return r;
+		}
+
+		static Float4 Splat(const float f_)
+		{
+			Float4 r; r.v = _mm_set1_ps(f_); return r;
+		}
+
+		static Float4 Load(const float* p_)
+		{
+			Float4 r; r.v = _mm_loadu_ps(p_); return r;
+		}
+
+		void Store(float* p_) const
+		{
+			_mm_storeu_ps(p_, v);
+		}
+#else
+		float v[4];
+
+		static Float4 Set(const float a_, const float b_, const float c_, const float d_)
+		{
+			Float4 r; r.v[0] = a_; r.v[1] = b_; r.v[2] = c_; r.v[3] = d_; return r;
+		}
+
+		static Float4 Splat(const float f_)
+		{
+			return Set(f_, f_, f_, f_);
+		}
+
+		static Float4 Load(const float* p_)
+		{
+			return Set(p_[0], p_[1], p_[2], p_[3]);
+		}
+
+		void Store(float* p_) const
+		{
+			for (unsigned int i=0; i<4; ++i)
+				p_[i] = v[i];
+		}
+#endif
+	};
+
+#ifdef TETRATOOLS_USE_SSE
+	inline Float4 operator+(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_add_ps(a_.v, b_.v); return r; }
+	inline Float4 operator-(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_sub_ps(a_.v, b_.v); return r; }
+	inline Float4 operator*(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_mul_ps(a_.v, b_.v); return r; }
+	inline Float4 operator/(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_div_ps(a_.v, b_.v); return r; }
+	inline Float4 Min(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_min_ps(a_.v, b_.v); return r; }
+	inline Float4 Max(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_max_ps(a_.v, b_.v); return r; }
+	inline Float4 Sqrt(const Float4& a_) { Float4 r; r.v = _mm_sqrt_ps(a_.v); return r; }
+	inline Float4 Abs(const Float4& a_) { Float4 r; r.v = _mm_andnot_ps(_mm_set1_ps(-0.0f), a_.v); return r; }
+
+	/// comparisons return a lane mask (all bits set where true) for Select, And, Or and MoveMask
+	inline Float4 CmpGt(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_cmpgt_ps(a_.v, b_.v); return r; }
+	inline Float4 CmpGe(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_cmpge_ps(a_.v, b_.v); return r; }
+	inline Float4 CmpLt(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_cmplt_ps(a_.v, b_.v); return r; }
+	inline Float4 And(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_and_ps(a_.v, b_.v); return r; }
+	inline Float4 Or(const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_or_ps(a_.v, b_.v); return r; }
+	inline Float4 Select(const Float4& mask_, const Float4& a_, const Float4& b_) { Float4 r; r.v = _mm_or_ps(_mm_and_ps(mask_.v, a_.v), _mm_andnot_ps(mask_.v, b_.v)); return r; }
+	/// bit i is set if lane i of the mask is set
+	inline unsigned int MoveMask(const Float4& mask_) { return (unsigned int)_mm_movemask_ps(mask_.v); }
+#else
+	inline Float4 operator+(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] + b_.v[0], a_.v[1] + b_.v[1], a_.v[2] + b_.v[2], a_.v[3] + b_.v[3]); }
+	inline Float4 operator-(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] - b_.v[0], a_.v[1] - b_.v[1], a_.v[2] - b_.v[2], a_.v[3] - b_.v[3]); }
+	inline Float4 operator*(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] * b_.v[0], a_.v[1] * b_.v[1], a_.v[2] * b_.v[2], a_.v[3] * b_.v[3]); }
+	inline Float4 operator/(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] / b_.v[0], a_.v[1] / b_.v[1], a_.v[2] / b_.v[2], a_.v[3] / b_.v[3]); }
+	inline Float4 Min(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] < b_.v[0] ? a_.v[0] : b_.v[0], a_.v[1] < b_.v[1] ? a_.v[1] : b_.v[1], a_.v[2] < b_.v[2] ? a_.v[2] : b_.v[2], a_.v[3] < b_.v[3] ? a_.v[3] : b_.v[3]); }
+	inline Float4 Max(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] > b_.v[0] ? a_.v[0] : b_.v[0], a_.v[1] > b_.v[1] ? a_.v[1] : b_.v[1], a_.v[2] > b_.v[2] ? a_.v[2] : b_.v[2], a_.v[3] > b_.v[3] ? a_.v[3] : b_.v[3]); }
+	inline Float4 Sqrt(const Float4& a_) { return Float4::Set(sqrtf(a_.v[0]), sqrtf(a_.v[1]), sqrtf(a_.v[2]), sqrtf(a_.v[3])); }
+	inline Float4 Abs(const Float4& a_) { return Float4::Set(fabsf(a_.v[0]), fabsf(a_.v[1]), fabsf(a_.v[2]), fabsf(a_.v[3])); }
+
+	/// the scalar masks use 1.0f for true and 0.0f for false
+	inline Float4 CmpGt(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] > b_.v[0] ? 1.0f : 0.0f, a_.v[1] > b_.v[1] ? 1.0f : 0.0f, a_.v[2] > b_.v[2] ? 1.0f : 0.0f, a_.v[3] > b_.v[3] ? 1.0f : 0.0f); }
+	inline Float4 CmpGe(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] >= b_.v[0] ? 1.0f : 0.0f, a_.v[1] >= b_.v[1] ? 1.0f : 0.0f, a_.v[2] >= b_.v[2] ? 1.0f : 0.0f, a_.v[3] >= b_.v[3] ? 1.0f : 0.0f); }
+	inline Float4 CmpLt(const Float4& a_, const Float4& b_) { return Float4::Set(a_.v[0] < b_.v[0] ? 1.0f : 0.0f, a_.v[1] < b_.v[1] ? 1.0f : 0.0f, a_.v[2] < b_.v[2] ? 1.0f : 0.0f, a_.v[3] < b_.v[3] ? 1.0f : 0.0f); }
+	inline Float4 And(const Float4& a_, const Float4& b_) { return a_ * b_; }
+	inline Float4 Or(const Float4& a_, const Float4& b_) { return Max(a_, b_); }
+	inline Float4 Select(const Float4& mask_, const Float4& a_, const Float4& b_) { return Float4::Set(mask_.v[0] != 0.0f ? a_.v[0] : b_.v[0], mask_.v[1] != 0.0f ? a_.v[1] : b_.v[1], mask_.v[2] != 0.0f ? a_.v[2] : b_.v[2], mask_.v[3] != 0.0f ? a_.v[3] : b_.v[3]); }
+	inline unsigned int MoveMask(const Float4& mask_) { return (mask_.v[0] != 0.0f ? 1u : 0u) | (mask_.v[1] != 0.0f ? 2u : 0u) | (mask_.v[2] != 0.0f ? 4u : 0u) | (mask_.v[3] != 0.0f ? 8u : 0u); }
+#endif
+
+	/**
+	 * Three Float4 lanes forming four 3D vectors.
+	 */
+	struct Vec3f4
+	{
+		Float4 x;
+		Float4 y;
+		Float4 z;
+	};
+
+	inline Vec3f4 operator-(const Vec3f4& a_, const Vec3f4& b_)
+	{
+		Vec3f4 r; r.x = a_.x - b_.x; r.y = a_.y - b_.y; r.z = a_.z - b_.z; return r;
+	}
+
+	inline Vec3f4 operator+(const Vec3f4& a_, const Vec3f4& b_)
+	{
+		Vec3f4 r; r.x = a_.x + b_.x; r.y = a_.y + b_.y; r.z = a_.z + b_.z; return r;
+	}
+
+	inline Vec3f4 operator*(const Vec3f4& a_, const Float4& f_)
+	{
+		Vec3f4 r; r.x = a_.x * f_; r.y = a_.y * f_; r.z = a_.z * f_; return r;
+	}
+
+	inline Float4 Dot(const Vec3f4& a_, const Vec3f4& b_)
+	{
+		return a_.x * b_.x + a_.y * b_.y + a_.z * b_.z;
+	}
+
+	inline Vec3f4 Cross(const Vec3f4& a_, const Vec3f4& b_)
+	{
+		Vec3f4 r;
+		r.x = a_.y * b_.z - a_.z * b_.y;
+		r.y = a_.z * b_.x - a_.x * b_.z;
+		r.z = a_.x * b_.y - a_.y * b_.x;
+		return r;
+	}
+
+}	/// end namespace TetraTools
+
+#endif /* SIMDFLOAT4_H_ */
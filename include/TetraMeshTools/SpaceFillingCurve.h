@@ -0,0 +1,58 @@
+/*
+ * SpaceFillingCurve.h
+ *
+ * Morton (Z-order) and Hilbert keys for 3D points.
+ *
+ * Points are quantized to 21 bits per axis inside a bounding box and mapped
+ * to a 63 bit curve index. Sorting primitives by this index places spatially
+ * close primitives close to each other in memory, which is used to renumber
+ * meshes for better cache locality (see TetrahedronTopology::ReorderAlongCurve).
+ */
+
+#ifndef SPACEFILLINGCURVE_H_
+#define SPACEFILLINGCURVE_H_
+
+#include <vector>
+#include <stdint.h>
+#include "GeometryTypes.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	enum SpaceFillingCurve
+	{
+		CURVE_MORTON,
+		CURVE_HILBERT
+	};
+
+	/// number of bits per axis used for the curve keys
+	const unsigned int CurveBitsPerAxis = 21;
+
+	/**
+	 * Interleaves the lower 21 bits of x_, y_ and z_ (x in the most significant position).
+	 */
+	DLL_EXPORT uint64_t MortonKey(const uint32_t x_, const uint32_t y_, const uint32_t z_);
+
+	/**
+	 * Position of the cell (x_, y_, z_) along a 3D Hilbert curve of order 21.
+	 * Cells with consecutive keys are always face neighbours.
+	 */
+	DLL_EXPORT uint64_t HilbertKey(const uint32_t x_, const uint32_t y_, const uint32_t z_);
+
+	/**
+	 * Quantizes the points into the bounding box box_ (uniformly scaled along its
+	 * largest extent) and computes one curve key per point in parallel.
+	 */
+	DLL_EXPORT void ComputeCurveKeys(const std::vector<Vec3f>& points_, const BoundingBox& box_, const SpaceFillingCurve curve_, std::vector<uint64_t>& keys_);
+
+	/**
+	 * Sorts the points along the curve and returns the resulting renumbering:
+	 * permutation_[oldIndex] is the new index of a point. Points with identical
+	 * keys keep their relative order.
+	 */
+	DLL_EXPORT void ComputeCurvePermutation(const std::vector<Vec3f>& points_, const BoundingBox& box_, const SpaceFillingCurve curve_, std::vector<unsigned int>& permutation_);
+
+}	/// end namespace TetraTools
+
+#endif /* SPACEFILLINGCURVE_H_ */
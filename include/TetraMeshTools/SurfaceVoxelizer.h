@@ -0,0 +1,157 @@
+/*
+ * SurfaceVoxelizer.h
+ *
+ * Conservative voxelization of triangle surfaces into a bit-packed grid.
+ *
+ * The grid is stored as bricks of 8x8x8 voxels, one bit per voxel: a brick
+ * is 8 words of 64 bits, word z holds the 8x8 voxels of brick layer z with
+ * bit 8 * y + x, so every row of 8 voxels along x is one byte. A 1024^3
+ * grid takes 128 MB.
+ *
+ * The triangles are binned into the bricks they overlap (SAT test against
+ * the brick box) and the bricks are processed in parallel. Within a brick
+ * every triangle is tested against its candidate rows with triBoxOverlap8,
+ * which classifies the 8 voxels of a row in one batched call. A voxel is
+ * set if its closed box overlaps a triangle.
+ *
+ * Optionally the interior of a closed surface is filled by row parity: the
+ * crossings of the line through the voxel centers of every (y, z) row with
+ * the surface are sorted along x, and the voxels with centers between the
+ * first and second, third and fourth, ... crossing are set. Edges and
+ * vertices hit by a row are counted once with a top-left rule, so a
+ * watertight mesh gives an even number of crossings per row. Rows with an
+ * odd number (open surfaces) ignore their last crossing.
+ */
+
+#ifndef SURFACEVOXELIZER_H_
+#define SURFACEVOXELIZER_H_
+
+#include <vector>
+#include <stdint.h>
+#include "GeometryTypes.h"
+#include "TriangleTopology.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	class DLL_EXPORT SurfaceVoxelizer
+	{
+	protected:
+		unsigned int			_resolution;			/// voxels per axis, a multiple of 8
+		unsigned int			_numBricksPerAxis;
+		Vec3f					_origin;				/// min corner of the grid
+		float					_voxelSize;
+		bool					_fillInside;
+		std::vector<uint64_t>	_bricks;				/// 8 words per brick, x fastest, then y, then z
+		size_t					_numSurfaceVoxels;
+		size_t					_numInsideVoxels;		/// voxels set by the inside filling only
+		size_t					_numSurfaceBricks;		/// bricks overlapped by at least one triangle
+
+		void VoxelizeSurface(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_);
+
+		void FillInside(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_);
+
+		/**
+		 * Sets the voxels [begin_, end_] of the row (y_, z_).
+		 */
+		void SetRow(const unsigned int y_, const unsigned int z_, const unsigned int begin_, const unsigned int end_);
+
+		size_t CountVoxels() const;
+
+	public:
+		SurfaceVoxelizer();
+
+		/**
+		 * Fill the interior of closed surfaces in the next Voxelize() call.
+		 */
+		void SetFillInside(const bool fillInside_)
+		{
+			_fillInside = fillInside_;
+		}
+
+		bool GetFillInside() const
+		{
+			return _fillInside;
+		}
+
+		/**
+		 * Voxelizes the surface into a grid of resolution_^3 voxels (rounded up to a multiple
+		 * of 8, at most 8192) that is fitted to the bounding box of the mesh with a margin of
+		 * one voxel on every side.
+		 */
+		bool Voxelize(const TriangleTopology& topology_, const unsigned int resolution_);
+
+		/**
+		 * Voxelizes the surface into a grid with the given placement, triangles outside of
+		 * the grid are clipped.
+		 */
+		bool Voxelize(const TriangleTopology& topology_, const unsigned int resolution_, const Vec3f& origin_, const float voxelSize_);
+
+		bool Voxelize(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const unsigned int resolution_, const Vec3f& origin_, const float voxelSize_);
+
+		void Clear();
+
+		bool IsSet(const unsigned int x_, const unsigned int y_, const unsigned int z_) const
+		{
+			const size_t brick = ((size_t)(z_ >> 3) * _numBricksPerAxis + (y_ >> 3)) * _numBricksPerAxis + (x_ >> 3);
+			return ((_bricks[brick * 8 + (z_ & 7)] >> (((y_ & 7) << 3) | (x_ & 7))) & 1) != 0;
+		}
+
+		/**
+		 * The 8 words of brick (x_, y_, z_), see the layout above.
+		 */
+		const uint64_t* GetBrick(const unsigned int x_, const unsigned int y_, const unsigned int z_) const
+		{
+			return &_bricks[(((size_t)z_ * _numBricksPerAxis + y_) * _numBricksPerAxis + x_) * 8];
+		}
+
+		const std::vector<uint64_t>& GetBricks() const
+		{
+			return _bricks;
+		}
+
+		unsigned int GetResolution() const
+		{
+			return _resolution;
+		}
+
+		unsigned int GetNumBricksPerAxis() const
+		{
+			return _numBricksPerAxis;
+		}
+
+		const Vec3f& GetOrigin() const
+		{
+			return _origin;
+		}
+
+		float GetVoxelSize() const
+		{
+			return _voxelSize;
+		}
+
+		Vec3f GetVoxelCenter(const unsigned int x_, const unsigned int y_, const unsigned int z_) const
+		{
+			return Vec3f(_origin.x + (x_ + 0.5f) * _voxelSize, _origin.y + (y_ + 0.5f) * _voxelSize, _origin.z + (z_ + 0.5f) * _voxelSize);
+		}
+
+		size_t GetNumSurfaceVoxels() const
+		{
+			return _numSurfaceVoxels;
+		}
+
+		size_t GetNumInsideVoxels() const
+		{
+			return _numInsideVoxels;
+		}
+
+		size_t GetNumSurfaceBricks() const
+		{
+			return _numSurfaceBricks;
+		}
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* SURFACEVOXELIZER_H_ */
@@ -11,6 +11,7 @@
 #include <string>
 #include <vector>
 #include "GeometryTypes.h"
+#include "TetrahedronTopology.h"
 
 #include "TetraToolsExports.h"
 
@@ -27,6 +28,12 @@ public:
 	 *	filename argument will have no extension. Required extensions will be added automatically.
 	 */
 	bool SaveToFile(const std::string& fileName_, const std::vector<Vec3f>& verts, const std::vector<Tetrahedron>& tetras);
+
+	/**
+	 *	Writes the vertices and tetrahedra of topology_ in their current numbering,
+	 *	e.g. after TetrahedronTopology::ReorderReverseCuthillMcKee().
+	 */
+	bool SaveToFile(const std::string& fileName_, TetrahedronTopology& topology_);
 };
 
 } /// end namespace TetraTools
@@ -0,0 +1,148 @@
+/*
+ * TetraQuality.h
+ *
+ * Element quality metrics for tetrahedral meshes.
+ *
+ * For every tetrahedron the signed volume, the minimum and maximum dihedral
+ * angle (degrees), the radius-edge ratio (circumradius / shortest edge,
+ * sqrt(6)/4 ~ 0.612 for the regular tetrahedron) and the aspect ratio
+ * (longest edge / (2 sqrt(6) inradius), 1 for the regular tetrahedron) are
+ * computed. The metrics are evaluated for four tetrahedra at a time with
+ * Float4 and the batches are distributed across threads.
+ *
+ * Tetrahedra are expected to be positively oriented (as produced by CGAL),
+ * a non-positive volume flags a tetrahedron as inverted.
+ */
+
+#ifndef TETRAQUALITY_H_
+#define TETRAQUALITY_H_
+
+#include <vector>
+#include <iostream>
+#include "GeometryTypes.h"
+#include "TetrahedronTopology.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	enum QualityMetric
+	{
+		QUALITY_VOLUME,
+		QUALITY_MIN_DIHEDRAL,
+		QUALITY_MAX_DIHEDRAL,
+		QUALITY_RADIUS_EDGE_RATIO,
+		QUALITY_ASPECT_RATIO,
+		QUALITY_NUM_METRICS
+	};
+
+	enum QualityFlag
+	{
+		QUALITY_FLAG_INVERTED	= 1 << 0,
+		QUALITY_FLAG_SLIVER		= 1 << 1
+	};
+
+	struct QualityStatistics
+	{
+		float	min;
+		float	max;
+		float	mean;
+	};
+
+	class DLL_EXPORT TetraQuality
+	{
+	protected:
+		std::vector<float>			_values[QUALITY_NUM_METRICS];
+		std::vector<unsigned char>	_flags;				/// QualityFlag bits per tetrahedron
+		size_t						_numInverted;
+		size_t						_numSlivers;
+		float						_sliverAngle;		/// min dihedral angle (degrees) below which a tet is a sliver
+
+	public:
+		TetraQuality();
+
+		/**
+		 * Computes all metrics and flags for the given mesh. Degenerate tetrahedra get
+		 * a radius-edge and aspect ratio of FLT_MAX.
+		 */
+		void Compute(const std::vector<Vec3f>& vertices_, const std::vector<Tetrahedron>& tetras_);
+
+		void Compute(TetrahedronTopology& topology_);
+
+		void Clear();
+
+		/**
+		 * Tetrahedra that are not inverted but have a minimum dihedral angle below
+		 * angle_ (degrees) are flagged as slivers. Takes effect with the next Compute().
+		 */
+		void SetSliverAngle(const float angle_)
+		{
+			_sliverAngle = angle_;
+		}
+
+		float GetSliverAngle() const
+		{
+			return _sliverAngle;
+		}
+
+		/**
+		 * One value per tetrahedron (same order as the tetrahedra passed to Compute()).
+		 */
+		const std::vector<float>& GetValues(const QualityMetric metric_) const
+		{
+			return _values[metric_];
+		}
+
+		const std::vector<unsigned char>& GetFlags() const
+		{
+			return _flags;
+		}
+
+		size_t GetNumTetras() const
+		{
+			return _flags.size();
+		}
+
+		size_t GetNumInverted() const
+		{
+			return _numInverted;
+		}
+
+		size_t GetNumSlivers() const
+		{
+			return _numSlivers;
+		}
+
+		QualityStatistics GetStatistics(const QualityMetric metric_) const;
+
+		/**
+		 * Returns true if smaller values of the metric mean worse elements
+		 * (volume, minimum dihedral angle), false otherwise.
+		 */
+		static bool IsLowerWorse(const QualityMetric metric_);
+
+		static const char* GetMetricName(const QualityMetric metric_);
+
+		/**
+		 * Counts the values of metric_ in numBins_ equally sized bins over [min_, max_].
+		 * Values outside the range are counted in the first / last bin, non-finite values
+		 * are not counted.
+		 */
+		void ComputeHistogram(const QualityMetric metric_, const unsigned int numBins_, const float min_, const float max_, std::vector<unsigned int>& bins_) const;
+
+		/**
+		 * Returns the indices of the count_ worst tetrahedra with respect to metric_,
+		 * worst first.
+		 */
+		void GetWorst(const QualityMetric metric_, const size_t count_, std::vector<unsigned int>& indices_) const;
+
+		/**
+		 * Prints statistics for all metrics, the inverted / sliver counts and
+		 * histograms of the dihedral angles.
+		 */
+		void PrintReport(std::ostream& out_) const;
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* TETRAQUALITY_H_ */
@@ -0,0 +1,110 @@
+/*
+ * TetraSmoothing.h
+ *
+ * Vertex smoothing for tetrahedral meshes.
+ *
+ * Only interior vertices (vertices that are not part of a surface triangle)
+ * are moved. Each vertex is relaxed towards a target position, either the
+ * average of its one-ring (Laplacian) or the volume weighted average of the
+ * circumcentres of its tetrahedra (optimal Delaunay triangulation, ODT).
+ * A move is only accepted if none of the incident tetrahedra is inverted by
+ * it, otherwise the step is halved a few times before the vertex is left
+ * where it is.
+ *
+ * The vertices are processed colour by colour (see GetVertexColourOrder()).
+ * Vertices of one colour share no tetrahedron, so they are moved in parallel
+ * in place without locks or atomics, and the result does not depend on the
+ * number of threads.
+ */
+
+#ifndef TETRASMOOTHING_H_
+#define TETRASMOOTHING_H_
+
+#include <vector>
+#include "GeometryTypes.h"
+#include "TetrahedronTopology.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	enum SmoothingMethod
+	{
+		SMOOTHING_LAPLACIAN,
+		SMOOTHING_ODT
+	};
+
+	struct SmoothingStatistics
+	{
+		size_t	numInteriorVertices;
+		size_t	numMoved;				/// accepted moves, summed over all iterations
+		size_t	numRejected;			/// moves rejected because every step size inverted a tetrahedron
+		float	maxDisplacement;		/// largest accepted move in the last iteration
+	};
+
+	class DLL_EXPORT TetraSmoother
+	{
+	protected:
+		SmoothingMethod		_method;
+		unsigned int		_numIterations;
+		float				_relaxation;		/// fraction of the way to the target position tried first
+		unsigned int		_numBacktracks;		/// how often the step is halved before a move is rejected
+
+	public:
+		TetraSmoother();
+
+		void SetMethod(const SmoothingMethod method_)
+		{
+			_method = method_;
+		}
+
+		SmoothingMethod GetMethod() const
+		{
+			return _method;
+		}
+
+		void SetNumIterations(const unsigned int numIterations_)
+		{
+			_numIterations = numIterations_;
+		}
+
+		unsigned int GetNumIterations() const
+		{
+			return _numIterations;
+		}
+
+		/**
+		 * Relaxation factor in (0, 1], 1 moves a vertex all the way to its target.
+		 */
+		void SetRelaxation(const float relaxation_)
+		{
+			_relaxation = relaxation_;
+		}
+
+		float GetRelaxation() const
+		{
+			return _relaxation;
+		}
+
+		void SetNumBacktracks(const unsigned int numBacktracks_)
+		{
+			_numBacktracks = numBacktracks_;
+		}
+
+		unsigned int GetNumBacktracks() const
+		{
+			return _numBacktracks;
+		}
+
+		/**
+		 * Smooths the interior vertices of topology_ and applies the new positions with
+		 * UpdateVertices(), so connectivity and generated structures are kept.
+		 * Tetrahedra are expected to be positively oriented; tetrahedra that are already
+		 * inverted are never made worse.
+		 */
+		SmoothingStatistics Smooth(TetrahedronTopology& topology_);
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* TETRASMOOTHING_H_ */
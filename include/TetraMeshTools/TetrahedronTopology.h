@@ -7,7 +7,13 @@
  * This is a topology container for tetrahedral meshes based on the TriangleTopology.
  */
 
+#ifndef TETRAHEDRONTOPOLOGY_H_
+#define TETRAHEDRONTOPOLOGY_H_
+
 #include "TriangleTopology.h"
+#include "SpaceFillingCurve.h"
+#include "GraphOrdering.h"
+#include "GraphColouring.h"
 
 #include "TetraToolsExports.h"
 
@@ -45,6 +51,23 @@ namespace TetraTools
 		std::vector<TetrahedronEdges>		_tetraEdges;
 		std::vector<TetrahedronTriangles>	_tetraTriangles;
 		std::vector<Triangle>				_surfaceTriangles;
+		std::vector<unsigned int>			_vertexNeighboursOffsets;	/// CSR offsets into _vertexNeighbours, numVertices+1 entries
+		std::vector<unsigned int>			_vertexNeighbours;			/// one-ring vertex indices, sorted ascending per vertex
+		std::vector<Vec3f>					_tetraCentroids;			/// one centroid per tetrahedron
+		std::vector<unsigned int>			_vertexColourOffsets;		/// range of every colour in _vertexColourOrder, numColours+1 entries
+		std::vector<unsigned int>			_vertexColourOrder;			/// vertex indices grouped by colour
+		std::vector<unsigned int>			_tetraColourOffsets;		/// range of every colour in _tetraColourOrder, numColours+1 entries
+		std::vector<unsigned int>			_tetraColourOrder;			/// tetrahedron indices grouped by colour
+
+		/// validity flags for the lazily generated data-structures above
+		OnceFlag							_tetraEdgesFlag;
+		OnceFlag							_tetraMapFlag;
+		OnceFlag							_surfaceTrianglesFlag;
+		OnceFlag							_tetraTrianglesFlag;
+		OnceFlag							_vertexNeighboursFlag;
+		OnceFlag							_tetraCentroidsFlag;
+		OnceFlag							_vertexColoursFlag;
+		OnceFlag							_tetraColoursFlag;
 
 		/**
 		 * Generate Triangles from the tetrahedra.
@@ -69,6 +92,42 @@ namespace TetraTools
 
 		void GenerateTetraTriangles();
 
+		/**
+		 * Generate the vertex one-ring (vertex-vertex adjacency) in CSR form from the edge set.
+		 * The neighbours of vertex i are _vertexNeighbours[_vertexNeighboursOffsets[i] ..
+		 * _vertexNeighboursOffsets[i+1]), sorted ascending and free of duplicates.
+		 */
+		void GenerateVertexNeighbours();
+
+		/**
+		 * Colours the vertex adjacency graph (see GraphColouring.h) so that no two
+		 * vertices of the same colour share an edge, and groups the vertices by colour.
+		 */
+		void GenerateVertexColours();
+
+		/**
+		 * Colours the tetrahedra so that no two tetrahedra of the same colour share a
+		 * vertex, and groups them by colour (ascending index within a colour).
+		 */
+		void GenerateTetraColours();
+
+		/**
+		 * Computes the centroids of all tetrahedra (or, with onlyDirty_, of all tetrahedra
+		 * that contain a vertex flagged in _dirtyVertices).
+		 */
+		void GenerateTetraCentroids(const bool onlyDirty_ = false);
+
+		/**
+		 * Extends the base version by refreshing the centroids of tetrahedra with moved vertices.
+		 */
+		virtual void UpdatePositionDependentData();
+
+		virtual void InvalidateEdgeData();
+
+		virtual void InvalidateAll();
+
+		virtual void CollectGenerators(const unsigned int structures_, std::vector<std::function<void()> >& tasks_);
+
 		/**
 		 * Swap edge order to have the smaller index in the first position
 		 */
@@ -90,12 +149,58 @@ namespace TetraTools
 
 		TetrahedronTopology(const std::vector<Vec3f>& vertices_, const std::vector<Tetrahedron>& tetras_, const bool complete_);
 
+		TetrahedronTopology(std::vector<Vec3f>&& vertices_, std::vector<Tetrahedron>&& tetras_, const bool complete_);
+
 		~TetrahedronTopology();
 
 		virtual void Init(const std::vector<Vec3f>& vertices_, const std::vector<Tetrahedron>& tetras_, const bool complete_ = false);
 
+		/**
+		 * Same as above, but takes over the given buffers instead of copying them.
+		 * vertices_ and tetras_ are empty afterwards.
+		 */
+		virtual void Init(std::vector<Vec3f>&& vertices_, std::vector<Tetrahedron>&& tetras_, const bool complete_ = false);
+
 		virtual void Clear();
 
+		virtual void SetEdges(const std::vector<Edge>& edges_);
+
+		virtual unsigned int GetGeneratedStructures() const;
+
+		/**
+		 * Renumbers vertices and tetrahedra. vertexPermutation_[oldIndex] is the new index of a
+		 * vertex, tetraPermutation_[oldIndex] the new index of a tetrahedron; an empty vector
+		 * keeps the current order. The triangles are re-derived from the renumbered tetrahedra
+		 * with one parallel sort of their faces, the edges and centroids are remapped, and every
+		 * other derived structure that had been generated before is generated again; the result
+		 * is the same as after Init() with the renumbered lists. Structures that had not been
+		 * generated stay lazy. Returns false (and leaves the mesh untouched) if a
+		 * permutation has the wrong size or is not a bijection.
+		 */
+		bool ApplyPermutation(const std::vector<unsigned int>& vertexPermutation_, const std::vector<unsigned int>& tetraPermutation_);
+
+		/**
+		 * Sorts the vertices along a Morton or Hilbert curve through the bounding box and
+		 * the tetrahedra along the same curve by their centroids, then applies the result
+		 * with ApplyPermutation. Neighbouring elements end up close to each other in memory.
+		 * The applied permutations (old index -> new index) are returned in
+		 * vertexPermutation_ and tetraPermutation_, e.g. to remap per-vertex user data.
+		 */
+		void ReorderAlongCurve(const SpaceFillingCurve curve_, std::vector<unsigned int>& vertexPermutation_, std::vector<unsigned int>& tetraPermutation_);
+
+		/**
+		 * Bandwidth and profile of the vertex adjacency in the current numbering.
+		 */
+		BandwidthInfo GetBandwidthInfo();
+
+		/**
+		 * Renumbers the vertices with Reverse Cuthill-McKee on the vertex adjacency to
+		 * reduce the bandwidth and profile of matrices assembled on the mesh. Logs both
+		 * before and after, the tetrahedron order is kept. The applied permutation
+		 * (old index -> new index) is returned in vertexPermutation_.
+		 */
+		void ReorderReverseCuthillMcKee(std::vector<unsigned int>& vertexPermutation_);
+
 		const std::vector<Tetrahedron>& GetTetrahedra()
 		{
 			return _tetrahedra;
@@ -103,29 +208,25 @@ namespace TetraTools
 
 		const std::vector<TetrahedronEdges>& GetTetraEdges()
 		{
-			if (_tetraEdges.size() == 0)
-				GenerateTetraEdges();
+			_tetraEdgesFlag.CallOnce([this]() { GenerateTetraEdges(); });
 			return _tetraEdges;
 		}
 
 		const std::vector<TetrahedronVertex>& GetTetrasPerVertices()
 		{
-			if (_tetraVertices.size() == 0)
-				GenerateTetrahedronMap();
+			_tetraMapFlag.CallOnce([this]() { GenerateTetrahedronMap(); });
 			return _tetraVertices;
 		}
 
 		const std::vector<PrimitivesPerVertex>& GetTetrasPerVertexLookupTable()
 		{
-			if (_vertexTetrahedraLookup.size() == 0)
-				GenerateTetrahedronMap();
+			_tetraMapFlag.CallOnce([this]() { GenerateTetrahedronMap(); });
 			return _vertexTetrahedraLookup;
 		}
 
 		const std::vector<Triangle>& GetSurfaceTriangles()
 		{
-			if (_surfaceTriangles.size() == 0)
-				GenerateSurfaceTriangles();
+			_surfaceTrianglesFlag.CallOnce([this]() { GenerateSurfaceTriangles(); });
 			return _surfaceTriangles;
 		}
 
@@ -136,11 +237,90 @@ namespace TetraTools
 
 		const std::vector<TetrahedronTriangles>& GetTetraTriangles()
 		{
-			if (_tetraTriangles.size() == 0)
-				GenerateTetraTriangles();
+			_tetraTrianglesFlag.CallOnce([this]() { GenerateTetraTriangles(); });
 			return _tetraTriangles;
 		}
 
+		/**
+		 * Returns the concatenated, per-vertex sorted one-ring neighbour lists.
+		 * Use GetVertexNeighboursOffsets() to find the range for a vertex.
+		 */
+		const std::vector<unsigned int>& GetVertexNeighbours()
+		{
+			_vertexNeighboursFlag.CallOnce([this]() { GenerateVertexNeighbours(); });
+			return _vertexNeighbours;
+		}
+
+		/**
+		 * Returns the CSR offsets for GetVertexNeighbours() (numVertices+1 entries).
+		 */
+		const std::vector<unsigned int>& GetVertexNeighboursOffsets()
+		{
+			_vertexNeighboursFlag.CallOnce([this]() { GenerateVertexNeighbours(); });
+			return _vertexNeighboursOffsets;
+		}
+
+		/**
+		 * Returns the vertices grouped by colour. Vertices of one colour are never
+		 * connected by an edge and can be moved concurrently; the vertices of colour c are
+		 * GetVertexColourOrder()[GetVertexColourOffsets()[c] .. GetVertexColourOffsets()[c+1]).
+		 */
+		const std::vector<unsigned int>& GetVertexColourOrder()
+		{
+			_vertexColoursFlag.CallOnce([this]() { GenerateVertexColours(); });
+			return _vertexColourOrder;
+		}
+
+		/**
+		 * Returns the CSR offsets for GetVertexColourOrder() (numColours+1 entries).
+		 */
+		const std::vector<unsigned int>& GetVertexColourOffsets()
+		{
+			_vertexColoursFlag.CallOnce([this]() { GenerateVertexColours(); });
+			return _vertexColourOffsets;
+		}
+
+		unsigned int GetNumVertexColours()
+		{
+			return GetVertexColourOffsets().size() - 1;
+		}
+
+		/**
+		 * Returns the tetrahedra grouped by colour. Tetrahedra of one colour share no vertex,
+		 * so per-vertex sums (assembly, normals, lumped masses) can be accumulated for all
+		 * tetrahedra of a colour in parallel without atomics. The tetrahedra of colour c are
+		 * GetTetraColourOrder()[GetTetraColourOffsets()[c] .. GetTetraColourOffsets()[c+1]),
+		 * in ascending order, so a mesh sorted along a curve is also traversed in memory order.
+		 */
+		const std::vector<unsigned int>& GetTetraColourOrder()
+		{
+			_tetraColoursFlag.CallOnce([this]() { GenerateTetraColours(); });
+			return _tetraColourOrder;
+		}
+
+		/**
+		 * Returns the CSR offsets for GetTetraColourOrder() (numColours+1 entries).
+		 */
+		const std::vector<unsigned int>& GetTetraColourOffsets()
+		{
+			_tetraColoursFlag.CallOnce([this]() { GenerateTetraColours(); });
+			return _tetraColourOffsets;
+		}
+
+		unsigned int GetNumTetraColours()
+		{
+			return GetTetraColourOffsets().size() - 1;
+		}
+
+		/**
+		 * Returns one centroid per tetrahedron (same order as GetTetrahedra()).
+		 */
+		const std::vector<Vec3f>& GetTetraCentroids()
+		{
+			_tetraCentroidsFlag.CallOnce([this]() { GenerateTetraCentroids(); });
+			return _tetraCentroids;
+		}
+
 		unsigned int GetNumTetras()
 		{
 			return _tetrahedra.size();
@@ -148,3 +328,5 @@ namespace TetraTools
 	};
 
 }	/// end namespace TetraTools
+
+#endif /* TETRAHEDRONTOPOLOGY_H_ */
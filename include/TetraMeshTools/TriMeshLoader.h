@@ -31,7 +31,7 @@ public:
 		return _vertices;
 	}
 
-	const std::vector<Triangle>	GetTriangles()
+	const std::vector<Triangle>&	GetTriangles()
 	{
 		return _triangles;
 	}
@@ -39,6 +39,12 @@ public:
 	// loads the file on object construction
 	bool loadFile(const std::string& path_and_filename);
 
+	/**
+	 * Hands the loaded vertices and triangles over to the caller without copying.
+	 * The loader is empty afterwards.
+	 */
+	void release(std::vector<Vec3f>& vertices_, std::vector<Triangle>& triangles_);
+
 protected:
 	std::vector<Vec3f>	_vertices;
 	std::vector<Triangle>	_triangles;
@@ -20,15 +20,59 @@
  *
  * Additionally this container will automatically detect topology changes
  * and re-generate any relevant data-structures when necessary.
+ * When only the vertex positions change (e.g. in a simulation loop),
+ * UpdateVertices() keeps all connectivity and only refreshes the
+ * position-dependent data of the vertices that actually moved.
  */
 
+#ifndef TRIANGLETOPOLOGY_H_
+#define TRIANGLETOPOLOGY_H_
+
 #include <vector>
+#include <functional>
+#include <stdint.h>
 #include "GeometryTypes.h"
+#include "OnceFlag.h"
+#include "VertexArraySoA.h"
 
 #include "TetraToolsExports.h"
 
 namespace TetraTools
 {
+	/**
+	 * Bit flags for the derived data-structures that can be requested from
+	 * TriangleTopology::EnsureAll and TetrahedronTopology::EnsureAll.
+	 */
+	enum TopologyStructure
+	{
+		TOPOLOGY_EDGES					= 1 << 0,
+		TOPOLOGY_EDGE_INDEX				= 1 << 1,
+		TOPOLOGY_TRIANGLE_EDGES			= 1 << 2,
+		TOPOLOGY_EDGE_MAP				= 1 << 3,
+		TOPOLOGY_TRIANGLE_MAP			= 1 << 4,
+		TOPOLOGY_NORMALS				= 1 << 5,
+		TOPOLOGY_TETRA_EDGES			= 1 << 6,
+		TOPOLOGY_TETRA_MAP				= 1 << 7,
+		TOPOLOGY_SURFACE_TRIANGLES		= 1 << 8,
+		TOPOLOGY_TETRA_TRIANGLES		= 1 << 9,
+		TOPOLOGY_VERTEX_NEIGHBOURS		= 1 << 10,
+		TOPOLOGY_TETRA_CENTROIDS		= 1 << 11,
+		TOPOLOGY_VERTEX_SOA				= 1 << 12,
+		TOPOLOGY_VERTEX_COLOURS			= 1 << 13,
+		TOPOLOGY_TETRA_COLOURS			= 1 << 14,
+		TOPOLOGY_ALL					= 0xFFFFFFFF
+	};
+
+	/**
+	 * Storage layout used by the bulk vertex kernels.
+	 * VERTEX_LAYOUT_AOS works directly on the Vec3f list, VERTEX_LAYOUT_SOA keeps an
+	 * additional structure-of-arrays copy (see VertexArraySoA) for SIMD-friendly loops.
+	 */
+	enum VertexLayout
+	{
+		VERTEX_LAYOUT_AOS,
+		VERTEX_LAYOUT_SOA
+	};
 
 	/**
 	 * This struct contains an Edge index whose corresponding Edge
@@ -52,6 +96,12 @@ namespace TetraTools
 		unsigned int indexInTriangle;
 	};
 
+	/**
+	 * Index into the per-vertex primitive lists. These lists hold 3-4 entries per
+	 * primitive, so they outgrow 32 bits long before vertex or primitive indices do.
+	 */
+	typedef uint64_t PrimitiveOffset;
+
 	/**
 	 * This struct contains an offset and a length to describe
 	 * how many edges or triangles are connected to a vertex.
@@ -60,7 +110,7 @@ namespace TetraTools
 	 */
 	struct PrimitivesPerVertex
 	{
-		unsigned int offset;		/// offset in the PrimitiveVertex list
+		PrimitiveOffset offset;		/// offset in the PrimitiveVertex list
 		unsigned int length;		/// length of the segment in the list
 	};
 
@@ -91,6 +141,21 @@ namespace TetraTools
 		std::vector<TriangleVertex>			_triangleVertices;		/// triangles-per-vertex list, 1..n entries per vertex
 		std::vector<PrimitivesPerVertex>	_vertexTrianglesLookup;	/// contains one entry per vertex
 		std::vector<TriangleEdges>			_triangleEdges;			/// the list of edges-per-triangle, 1 struct per triangle
+		std::vector<unsigned int>			_edgeIndexTable;		/// open-addressing hash (ordered vertex pair -> edge index), built on demand
+
+		/// validity flags for the lazily generated data-structures above
+		OnceFlag							_edgesFlag;
+		OnceFlag							_edgeIndexFlag;
+		OnceFlag							_triangleEdgesFlag;
+		OnceFlag							_edgeMapFlag;
+		OnceFlag							_triangleMapFlag;
+		OnceFlag							_normalsFlag;
+
+		std::vector<unsigned char>			_dirtyVertices;			/// 1 for every vertex that moved in the last UpdateVertices call
+		size_t								_numDirtyVertices;		/// number of vertices that moved in the last UpdateVertices call
+		VertexLayout						_vertexLayout;			/// layout used by the bulk kernels
+		VertexArraySoA						_vertexSoA;				/// SoA copy of _vertices, built on demand
+		OnceFlag							_vertexSoAFlag;
 
 		float radius;	/// maximum distance from origin (useful for QGLViewer)
 
@@ -112,12 +177,80 @@ namespace TetraTools
 
 		void GenerateBoundingBox(const std::vector<Vec3f>& vertices_);
 
+		/**
+		 * Recomputes bounding box, bounding cubes and radius without logging.
+		 */
+		void UpdateBoundingBox(const std::vector<Vec3f>& vertices_);
+
+		static void ComputeBoundingBoxAoS(const std::vector<Vec3f>& vertices_, BoundingBox& box_, float& maxSquaredLength_);
+
+		/**
+		 * Averaged normal of all triangles connected to a vertex.
+		 * Requires the triangle map.
+		 */
+		Vec3f ComputeVertexNormal(const unsigned int vertexIndex_) const;
+
+		/**
+		 * Called by UpdateVertices after vertices have moved (see _dirtyVertices).
+		 * Refreshes the bounding volumes and the normals (only if they have been
+		 * generated before). Derived classes extend this for their own cached data.
+		 */
+		virtual void UpdatePositionDependentData();
+
+		/**
+		 * Builds the hashed edge index used by FindEdgeByIndex.
+		 * The table has a power-of-two size of at least twice the number of edges
+		 * and uses linear probing.
+		 */
+		void GenerateEdgeIndex();
+
+		/**
+		 * Looks up an edge in the hashed edge index. The index has to be built already.
+		 * Returns -1 if the edge does not exist.
+		 */
+		unsigned int LookupEdge(const unsigned int i0, const unsigned int i1) const;
+
+		/// thread-safe lazy generation of the derived data-structures
+		void EnsureEdges()
+		{
+			_edgesFlag.CallOnce([this]() { GenerateEdges(); });
+		}
+
+		/// the index is built from the edge list, so the edges are generated first
+		void EnsureEdgeIndex()
+		{
+			EnsureEdges();
+			_edgeIndexFlag.CallOnce([this]() { GenerateEdgeIndex(); });
+		}
+
+		/**
+		 * Invalidates everything that has been derived from the edge list.
+		 */
+		virtual void InvalidateEdgeData();
+
+		/**
+		 * Invalidates all lazily generated data-structures.
+		 */
+		virtual void InvalidateAll();
+
+		/**
+		 * Appends one generator per requested structure (see TopologyStructure) to tasks_.
+		 */
+		virtual void CollectGenerators(const unsigned int structures_, std::vector<std::function<void()> >& tasks_);
+
 	public:
+		/**
+		 * Returns the TopologyStructure bits of all derived structures that are currently generated.
+		 */
+		virtual unsigned int GetGeneratedStructures() const;
+
 		/// Constructors
 		TriangleTopology();
 
 		TriangleTopology(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const bool complete_ = false);
 
+		TriangleTopology(std::vector<Vec3f>&& vertices_, std::vector<Triangle>&& triangles_, const bool complete_ = false);
+
 		~TriangleTopology();
 
 		virtual void Clear();
@@ -130,11 +263,50 @@ namespace TetraTools
 		 */
 		virtual void Init(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const bool fullUpdate_ = false);
 
+		/**
+		 * Same as above, but takes over the given buffers instead of copying them.
+		 * vertices_ and triangles_ are empty afterwards.
+		 */
+		virtual void Init(std::vector<Vec3f>&& vertices_, std::vector<Triangle>&& triangles_, const bool fullUpdate_ = false);
+
 		/**
 		 * Set Edges separately (e.g. when Edges have been generated from the tetrahedra already.
 		 * This will also clear any edge-related mappings.
 		 */
-		void SetEdges(const std::vector<Edge>& edges_);
+		virtual void SetEdges(const std::vector<Edge>& edges_);
+
+		/**
+		 * Replaces the vertex positions while keeping all connectivity data-structures.
+		 * The number of vertices has to stay the same, otherwise false is returned
+		 * and nothing is changed. Only vertices that actually moved are marked dirty
+		 * and only their position-dependent data is recomputed. Passing the topology's
+		 * own vertex array (after editing it through GetVertices()) marks all vertices
+		 * dirty, as in MarkVerticesChanged().
+		 */
+		bool UpdateVertices(const Vec3f* vertices_, const size_t numVertices_);
+
+		bool UpdateVertices(const std::vector<Vec3f>& vertices_);
+
+		/**
+		 * Per-vertex flags of the last UpdateVertices call (1 = moved).
+		 */
+		const std::vector<unsigned char>& GetDirtyVertices() const
+		{
+			return _dirtyVertices;
+		}
+
+		size_t GetNumDirtyVertices() const
+		{
+			return _numDirtyVertices;
+		}
+
+		/**
+		 * Generates all requested data-structures (a combination of TopologyStructure flags).
+		 * With parallel_ set, independent structures are built concurrently.
+		 * All accessors below are safe to call from several threads at the same time;
+		 * Init(), Clear() and SetEdges() must not run concurrently with readers.
+		 */
+		void EnsureAll(const unsigned int structures_ = TOPOLOGY_ALL, const bool parallel_ = true);
 
 		/// accessor functions
 		const std::vector<Vec3f>& GetVertices() const
@@ -142,15 +314,48 @@ namespace TetraTools
 			return _vertices;
 		}
 
+		/**
+		 * Writable access to the vertices. Changes made through this reference are not
+		 * tracked: call MarkVerticesChanged() after editing positions in place, otherwise
+		 * the bounding box, the normals and the SoA copy keep the old positions.
+		 * Prefer UpdateVertices() for position updates.
+		 */
 		std::vector<Vec3f>& GetVertices()
 		{
 			return _vertices;
 		}
 
+		/**
+		 * Marks all vertices as moved after in-place edits through GetVertices(): discards
+		 * the SoA copy and updates the position-dependent data. Must not run concurrently
+		 * with readers.
+		 */
+		void MarkVerticesChanged();
+
+		/**
+		 * Selects the storage layout used by the bulk kernels
+		 * (bounding box, normals, tetrahedron centroids).
+		 */
+		void SetVertexLayout(const VertexLayout layout_);
+
+		VertexLayout GetVertexLayout() const
+		{
+			return _vertexLayout;
+		}
+
+		/**
+		 * Structure-of-arrays copy of the vertices with 64-byte aligned x/y/z arrays.
+		 * Built on first access (independent of the selected layout) and kept in sync by UpdateVertices().
+		 */
+		const VertexArraySoA& GetVertexSoA()
+		{
+			_vertexSoAFlag.CallOnce([this]() { _vertexSoA.Assign(_vertices); });
+			return _vertexSoA;
+		}
+
 		std::vector<Edge>& GetEdges()
 		{
-			if (_edges.size() == 0)
-				GenerateEdges();
+			EnsureEdges();
 			return _edges;
 		}
 
@@ -166,36 +371,31 @@ namespace TetraTools
 
 		const std::vector<TriangleVertex>& GetTrianglesPerVertices()
 		{
-			if (_triangleVertices.size() == 0)
-				GenerateTriangleMap();
+			_triangleMapFlag.CallOnce([this]() { GenerateTriangleMap(); });
 			return _triangleVertices;
 		}
 
 		const std::vector<EdgeVertex>& GetEdgesPerVertices()
 		{
-			if (_edgeVertices.size() == 0)
-				GenerateEdgeMap();
+			_edgeMapFlag.CallOnce([this]() { GenerateEdgeMap(); });
 			return _edgeVertices;
 		}
 
 		const std::vector<PrimitivesPerVertex>& GetEdgesPerVertexLookupTable()
 		{
-			if (_vertexEdgesLookup.size() == 0)
-				GenerateEdgeMap();
+			_edgeMapFlag.CallOnce([this]() { GenerateEdgeMap(); });
 			return _vertexEdgesLookup;
 		}
 
 		const std::vector<PrimitivesPerVertex>& GetTrianglesPerVertexLookupTable()
 		{
-			if (_vertexTrianglesLookup.size() == 0)
-				GenerateTriangleMap();
+			_triangleMapFlag.CallOnce([this]() { GenerateTriangleMap(); });
 			return _vertexTrianglesLookup;
 		}
 
 		const std::vector<TriangleEdges>& GetTriangleEdges()
 		{
-			if (_triangleEdges.size() == 0)
-				GenerateTriangleEdges();
+			_triangleEdgesFlag.CallOnce([this]() { GenerateTriangleEdges(); });
 			return _triangleEdges;
 		}
 
@@ -216,8 +416,7 @@ namespace TetraTools
 
 		const std::vector<Vec3f>& GetNormals()
 		{
-			if (_normals.size() == 0)
-				GenerateNormals();
+			_normalsFlag.CallOnce([this]() { GenerateNormals(); });
 			return _normals;
 		}
 
@@ -232,10 +431,19 @@ namespace TetraTools
 		void GenerateNormals();
 
 		/**
-		 * Find the Edge that is constructed by indices i0 and i1
+		 * Find the Edge that is constructed by indices i0 and i1.
+		 * Uses a hashed edge index that is built on the first call and
+		 * discarded whenever the edges change. Returns -1 if there is no such edge.
 		 */
 		const unsigned int FindEdgeByIndex(const unsigned int i0, const unsigned int i1);
 
+		/**
+		 * Batch version of FindEdgeByIndex: resolves all edges_ in parallel and writes
+		 * one edge index (or -1) per input edge to indices_. The order of the two
+		 * vertex indices in an input edge does not matter.
+		 */
+		void FindEdgesByIndex(const std::vector<Edge>& edges_, std::vector<unsigned int>& indices_);
+
 		float GetRadius()
 		{
 			return radius;
@@ -268,3 +476,5 @@ namespace TetraTools
 
 	};
 }	/// end namespace TetraTools
+
+#endif /* TRIANGLETOPOLOGY_H_ */
@@ -18,10 +18,6 @@ public:
 		x = 0.0f;
 		y = 0.0f;
 	}
-	Vec2f(const Vec2f &v) {
-		x = v.x;
-		y = v.y;
-	}
 	Vec2f(float nx, float ny) {
 		x = nx;
 		y = ny;
@@ -37,11 +37,6 @@ public:
 		y = 0.0f;
 		z = 0.0f;
 	}
-	Vec3f(const Vec3f &v) {
-		x = v.x;
-		y = v.y;
-		z = v.z;
-	}
 	Vec3f(float nx, float ny, float nz) {
 		x = nx;
 		y = ny;
@@ -20,12 +20,6 @@ public:
 		z = 0.0f;
 		w = 0.0f;
 	}
-	Vec4f(const Vec4f &v) {
-		x = v.x;
-		y = v.y;
-		z = v.z;
-		w = v.w;
-	}
 	// convenience constructor to allow constructing a
 	// Vec4f from a Vec3f and an additional parameter
 	Vec4f(const Vec3f &v, float f) {
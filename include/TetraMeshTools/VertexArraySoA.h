@@ -0,0 +1,162 @@
+/*
+ * VertexArraySoA.h
+ *
+ * Structure-of-arrays storage for vertex positions.
+ *
+ * The x, y and z coordinates are kept in three separate, 64-byte aligned
+ * float arrays so that bulk kernels (bounding volumes, normals, centroids)
+ * can process several vertices per SIMD instruction instead of working on
+ * interleaved Vec3f objects.
+ */
+
+#ifndef VERTEXARRAYSOA_H_
+#define VERTEXARRAYSOA_H_
+
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "GeometryTypes.h"
+
+#include "TetraToolsExports.h"
+
+namespace TetraTools
+{
+	/**
+	 * Minimal STL allocator returning memory aligned to Alignment bytes.
+	 */
+	template <typename T, size_t Alignment>
+	class AlignedAllocator
+	{
+	public:
+		typedef T			value_type;
+		typedef T*			pointer;
+		typedef const T*	const_pointer;
+		typedef T&			reference;
+		typedef const T&	const_reference;
+		typedef size_t		size_type;
+		typedef ptrdiff_t	difference_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef AlignedAllocator<U, Alignment> other;
+		};
+
+		AlignedAllocator()
+		{}
+
+		template <typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+		{}
+
+		T* allocate(const size_t n_)
+		{
+			if (n_ == 0)
+				return NULL;
+			void* p = NULL;
+#ifdef _WIN32
+			p = _aligned_malloc(n_ * sizeof(T), Alignment);
+#else
+			if (posix_memalign(&p, Alignment, n_ * sizeof(T)) != 0)
+				p = NULL;
+#endif
+			if (p == NULL)
+				throw std::bad_alloc();
+			return static_cast<T*>(p);
+		}
+
+		void deallocate(T* p_, const size_t)
+		{
+#ifdef _WIN32
+			_aligned_free(p_);
+#else
+			free(p_);
+#endif
+		}
+
+		template <typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const
+		{
+			return true;
+		}
+
+		template <typename U>
+		bool operator!=(const AlignedAllocator<U, Alignment>&) const
+		{
+			return false;
+		}
+	};
+
+	class DLL_EXPORT VertexArraySoA
+	{
+	public:
+		typedef std::vector<float, AlignedAllocator<float, 64> > FloatArray;
+
+		/**
+		 * Copies (transposes) an AoS vertex list into the three coordinate arrays.
+		 */
+		void Assign(const std::vector<Vec3f>& vertices_);
+
+		/**
+		 * Writes the vertices back into an AoS list.
+		 */
+		void ToAoS(std::vector<Vec3f>& vertices_) const;
+
+		/**
+		 * Computes the axis-aligned bounds and the maximum squared distance from the origin.
+		 * Returns false if the array is empty.
+		 */
+		bool ComputeBounds(Vec3f& min_, Vec3f& max_, float& maxSquaredLength_) const;
+
+		void Resize(const size_t size_)
+		{
+			_x.resize(size_);
+			_y.resize(size_);
+			_z.resize(size_);
+		}
+
+		void Clear()
+		{
+			_x.clear();
+			_y.clear();
+			_z.clear();
+		}
+
+		size_t Size() const
+		{
+			return _x.size();
+		}
+
+		Vec3f Get(const size_t index_) const
+		{
+			return Vec3f(_x[index_], _y[index_], _z[index_]);
+		}
+
+		void Set(const size_t index_, const Vec3f& v_)
+		{
+			_x[index_] = v_.x;
+			_y[index_] = v_.y;
+			_z[index_] = v_.z;
+		}
+
+		const float* X() const { return _x.empty() ? NULL : &_x[0]; }
+		const float* Y() const { return _y.empty() ? NULL : &_y[0]; }
+		const float* Z() const { return _z.empty() ? NULL : &_z[0]; }
+
+		float* X() { return _x.empty() ? NULL : &_x[0]; }
+		float* Y() { return _y.empty() ? NULL : &_y[0]; }
+		float* Z() { return _z.empty() ? NULL : &_z[0]; }
+
+	private:
+		FloatArray	_x;
+		FloatArray	_y;
+		FloatArray	_z;
+	};
+
+}	/// end namespace TetraTools
+
+#endif /* VERTEXARRAYSOA_H_ */
@@ -16,7 +16,19 @@ if( NOT TARGET ciTetraMesher )
                	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/TetgenWriter.cpp
                	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/TriMeshWriter.cpp
              	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/Octree.cpp
-               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/TetrahedronTopology.cpp 
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/TetrahedronTopology.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/VertexArraySoA.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/SpaceFillingCurve.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/GraphOrdering.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/TetraQuality.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/GraphColouring.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/TetraSmoothing.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/MeshPartition.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/MappedFile.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/OutOfCoreTopology.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/LinearOctree.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/SurfaceVoxelizer.cpp
+               	${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/ConsistencyChecks.cpp
 
 				# trimesh
 				${ciTetraMesher_SOURCE_PATH}/TetraMeshTools/trimesh2/conn_comps.cc
@@ -58,6 +70,8 @@ if( NOT TARGET ciTetraMesher )
 													 "${ciTetraMesher_INCLUDE_PATH}"
 	)
 	target_include_directories( ciTetraMesher BEFORE PUBLIC "${CINDER_PATH}/include" )
+	find_package( Threads REQUIRED )
+	target_link_libraries( ciTetraMesher PUBLIC Threads::Threads )
 	find_package( CGAL REQUIRED COMPONENTS Core )
 	if( CGAL_FOUND )
 		target_link_libraries( ciTetraMesher PUBLIC CGAL::CGAL CGAL::CGAL_Core )
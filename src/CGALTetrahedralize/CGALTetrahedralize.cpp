@@ -24,11 +24,15 @@
 #include <CGAL/Polyhedral_mesh_domain_3.h>
 #include <CGAL/make_mesh_3.h>
 #include <CGAL/refine_mesh_3.h>
+#include <CGAL/optimize_mesh_3.h>
 
 // IO
 #include <CGAL/IO/Polyhedron_iostream.h>
 #include <iostream>
 #include <map>
+#include <chrono>
+#include <algorithm>
+#include "TetraQuality.h"
 
 
 
@@ -139,14 +143,12 @@ class Build_triangle : public CGAL::Modifier_base<HDS>
 {
 
 private:
-	std::vector<Triangle>		tris;
-	std::vector<Vec3f>			verts;
+	const std::vector<Triangle>&	tris;
+	const std::vector<Vec3f>&		verts;
 	
 public:
-	Build_triangle(const std::vector<Triangle>& tris_, const std::vector<Vec3f>& verts_) 
+	Build_triangle(const std::vector<Triangle>& tris_, const std::vector<Vec3f>& verts_) : tris(tris_), verts(verts_)
 	{
-		tris = tris_;
-		verts = verts_;
 	}
 	void operator()( HDS& hds) 
 	{
@@ -188,6 +190,143 @@ public:
 	}
 };
 
+/*
+ *	Copies the vertices and cells of the complex into our own data structures.
+ */
+static void CopyComplex(const C3t3& c3t3, std::vector<Vec3f>& tetraPoints, std::vector<Tetrahedron>& tetraIndices)
+{
+	tetraPoints.clear();
+	tetraIndices.clear();
+	const Tr& t = c3t3.triangulation();
+	unsigned int i = 0;
+	//std::cout<<"NumVerts: "<<t.number_of_vertices()<<std::endl;
+	// Vertex map for storing the vertex indices (these are needed to generate the triangle indices from the vertex values)
+	std::map<Point_3, int> V;
+	tetraPoints.reserve(t.number_of_vertices());
+	tetraIndices.reserve(c3t3.number_of_cells_in_complex());
+	//for (Tr::All_vertices_iterator it=t.all_vertices_begin(); it != t.all_vertices_end(); ++it)
+	for( Finite_vertices_iterator it = t.finite_vertices_begin(); it != t.finite_vertices_end(); ++it)
+	{
+		// add the current point to the vertex map to re-use this map to generate the triangle-indices afterwards.
+		V[it->point()] = i;
+		Vec3f v;
+		v.x = it->point().x();
+		v.y = it->point().y();
+		v.z = it->point().z();
+		tetraPoints.push_back(v);
+		++i;
+	}
+	for (Complex_Cell_Iterator it = c3t3.cells_in_complex_begin(); it != c3t3.cells_in_complex_end(); ++it)
+	{
+		Tetrahedron tet;
+		for (int j=0; j<4; ++j)
+		{
+			tet.index[j] = V[it->vertex(j)->point()];
+		}
+		tetraIndices.push_back(tet);
+	}
+}
+
+/*
+ *	Measures the worst-element quality of the current complex.
+ */
+static CGALOptimizationStep EvaluateComplex(const C3t3& c3t3, const std::string& name, const double seconds)
+{
+	std::vector<Vec3f> points;
+	std::vector<Tetrahedron> tetras;
+	CopyComplex(c3t3, points, tetras);
+	TetraTools::TetraQuality quality;
+	quality.Compute(points, tetras);
+	CGALOptimizationStep step;
+	step.name = name;
+	step.seconds = seconds;
+	step.minDihedral = quality.GetStatistics(TetraTools::QUALITY_MIN_DIHEDRAL).min;
+	step.maxRadiusEdgeRatio = quality.GetStatistics(TetraTools::QUALITY_RADIUS_EDGE_RATIO).max;
+	step.numSlivers = quality.GetNumSlivers();
+	std::cout<<"\t"<<name<<": "<<seconds<<"s, min dihedral "<<step.minDihedral<<", max radius-edge ratio "<<step.maxRadiusEdgeRatio<<", slivers "<<step.numSlivers<<std::endl;
+	return step;
+}
+
+/*
+ *	Runs the enabled CGAL optimisers on the complex within the time budget and records
+ *	the worst-element quality after every step.
+ */
+static void OptimizeComplex(C3t3& c3t3, const Mesh_domain& domain, const CGALOptimizationOptions& optimization_, std::vector<CGALOptimizationStep>& optimizationReport)
+{
+	typedef std::chrono::steady_clock Clock;
+	std::cout<<"Optimizing mesh..."<<std::endl;
+	optimizationReport.push_back(EvaluateComplex(c3t3, "Initial mesh", 0.0));
+	int remainingSteps = (optimization_.lloyd ? 1 : 0) + (optimization_.odt ? 1 : 0) + (optimization_.perturb ? 1 : 0) + (optimization_.exude ? 1 : 0);
+	const Clock::time_point start = Clock::now();
+	Clock::time_point stepStart = start;
+
+	/// time limit for the next step, returns false if the budget is used up
+	auto nextStep = [&](double& limit_) -> bool
+	{
+		stepStart = Clock::now();
+		limit_ = 0.0;
+		if (optimization_.timeLimit <= 0.0)
+			return true;
+		const double left = optimization_.timeLimit - std::chrono::duration<double>(stepStart - start).count();
+		if (left <= 0.0)
+			return false;
+		limit_ = left / remainingSteps;
+		return true;
+	};
+	auto finishStep = [&](const char* name_)
+	{
+		--remainingSteps;
+		const double seconds = std::chrono::duration<double>(Clock::now() - stepStart).count();
+		optimizationReport.push_back(EvaluateComplex(c3t3, name_, seconds));
+	};
+
+	double limit = 0.0;
+	if (optimization_.lloyd)
+	{
+		if (nextStep(limit))
+		{
+			CGAL::lloyd_optimize_mesh_3(c3t3, domain, time_limit=limit);
+			finishStep("Lloyd");
+		}
+		else
+			std::cout<<"\tSkipping Lloyd, time budget used up"<<std::endl;
+	}
+	if (optimization_.odt)
+	{
+		if (nextStep(limit))
+		{
+			CGAL::odt_optimize_mesh_3(c3t3, domain, time_limit=limit);
+			finishStep("ODT");
+		}
+		else
+			std::cout<<"\tSkipping ODT, time budget used up"<<std::endl;
+	}
+	if (optimization_.perturb)
+	{
+		if (nextStep(limit))
+		{
+			CGAL::perturb_mesh_3(c3t3, domain, time_limit=limit, sliver_bound=optimization_.sliverBound);
+			finishStep("Perturb");
+		}
+		else
+			std::cout<<"\tSkipping perturb, time budget used up"<<std::endl;
+	}
+	if (optimization_.exude)
+	{
+		if (nextStep(limit))
+		{
+			CGAL::exude_mesh_3(c3t3, time_limit=limit, sliver_bound=optimization_.sliverBound);
+			finishStep("Exude");
+		}
+		else
+			std::cout<<"\tSkipping exude, time budget used up"<<std::endl;
+	}
+	const CGALOptimizationStep& first = optimizationReport.front();
+	const CGALOptimizationStep& last = optimizationReport.back();
+	std::cout<<"Optimization took "<<std::chrono::duration<double>(Clock::now() - start).count()<<"s: min dihedral "<<first.minDihedral<<" -> "<<last.minDihedral
+		<<", max radius-edge ratio "<<first.maxRadiusEdgeRatio<<" -> "<<last.maxRadiusEdgeRatio<<", slivers "<<first.numSlivers<<" -> "<<last.numSlivers<<std::endl;
+}
+
 CGALTetrahedralize::CGALTetrahedralize()
 {
 	//clear();
@@ -196,9 +335,19 @@ CGALTetrahedralize::CGALTetrahedralize()
 void CGALTetrahedralize::clear()
 {
 	tetraPoints.clear();
+	tetraNormals.clear();
 	tetraIndices.clear();
 }
 
+void CGALTetrahedralize::Release(std::vector<Vec3f>& vertices_, std::vector<Tetrahedron>& tetras_)
+{
+	vertices_.clear();
+	tetras_.clear();
+	vertices_.swap(tetraPoints);
+	tetras_.swap(tetraIndices);
+	clear();
+}
+
 CGALTetrahedralize::~CGALTetrahedralize()
 {
 	clear();
@@ -208,7 +357,7 @@ CGALTetrahedralize::~CGALTetrahedralize()
 /// Helpful documentation note for self:
 /// http://doc.cgal.org/latest/Mesh_3/index.html#Chapter_3D_Mesh_Generation
 
-void CGALTetrahedralize::GenerateFromSurface(const std::vector<Triangle>& tris, const std::vector<Vec3f>& verts, const double cell_size_, const double facet_angle_, const double facet_size_, const double face_distance_, const double cell_radius_edge_ratio_)
+void CGALTetrahedralize::GenerateFromSurface(const std::vector<Triangle>& tris, const std::vector<Vec3f>& verts, const double cell_size_, const double facet_angle_, const double facet_size_, const double face_distance_, const double cell_radius_edge_ratio_, const CGALOptimizationOptions& optimization_)
 {
 	std::cout<<"Generating CGAL surface mesh from our own data structure..."<<std::endl;
 	Polyhedron2 polyhedron;
@@ -223,9 +372,8 @@ void CGALTetrahedralize::GenerateFromSurface(const std::vector<Triangle>& tris,
 
 	//std::cout<<"Copying CGAL surface to new structure to generate tetrahedral mesh mesh from surface..."<<std::endl;
     poly_copy(polyhedron, tmpPoly);
-    
-	unsigned int i=0;
-	
+	tmpPoly.clear();
+
 	// Create domain
 	std::cout<<"Creating domain..."<<std::endl;
 	Mesh_domain domain(polyhedron);
@@ -240,6 +388,12 @@ void CGALTetrahedralize::GenerateFromSurface(const std::vector<Triangle>& tris,
 	C3t3 c3t3 = CGAL::make_mesh_3<C3t3>(domain, criteria, no_perturb(), no_exude());
 
 	std::cout<<"C3T3 Number of cells : "<<c3t3.number_of_cells()<<std::endl;
+
+	optimizationReport.clear();
+	if (optimization_.lloyd || optimization_.odt || optimization_.perturb || optimization_.exude)
+	{
+		OptimizeComplex(c3t3, domain, optimization_, optimizationReport);
+	}
 /*	
 	Mesh_criteria new_criteria(cell_radius_edge_ratio=3, cell_size=0.03);
 	// Mesh refinement
@@ -250,44 +404,9 @@ void CGALTetrahedralize::GenerateFromSurface(const std::vector<Triangle>& tris,
 */
 	// clear all existing output data structures
 	clear();
-	
+
 	// Copy all data from CGAL data structures to our own structure.
-	Tr t = c3t3.triangulation();
-	i = 0;
-	//std::cout<<"NumVerts: "<<t.number_of_vertices()<<std::endl;
-	// Vertex map for storing the vertex indices (these are needed to generate the triangle indices from the vertex values)
-	std::map<Point_3, int> V;
-	//for (Tr::All_vertices_iterator it=t.all_vertices_begin(); it != t.all_vertices_end(); ++it)
-	for( Finite_vertices_iterator it = t.finite_vertices_begin(); it != t.finite_vertices_end(); ++it)
-	{
-		// add the current point to the vertex map to re-use this map to generate the triangle-indices afterwards.
-		V[it->point()] = i;
-		Vec3f v;
-		v.x = it->point().x();
-		v.y = it->point().y();
-		v.z = it->point().z();
-		tetraPoints.push_back(v);
-		++i;
-	}
-	i = 0;
-	for (Complex_Cell_Iterator it = c3t3.cells_in_complex_begin(); it != c3t3.cells_in_complex_end(); ++it)
-	//for (Tr::All_cells_iterator it = t.all_cells_begin(); it != t.all_cells_end(); ++it)
-	{
-		//const Tr::Cell c(*it);
-		/*
-		const C3t3::Vertex_handle v0 = c.vertex(0);
-		const C3t3::Vertex_handle v1 = c.vertex(1);
-		const C3t3::Vertex_handle v2 = c.vertex(2);
-		const C3t3::Vertex_handle v3 = c.vertex(3);
-		*/
-		Tetrahedron tet;
-		for (int j=0; j<4; ++j)
-		{
-			tet.index[j] = V[it->vertex(j)->point()];
-		}
-		tetraIndices.push_back(tet);
-		++i;
-	}
+	CopyComplex(c3t3, tetraPoints, tetraIndices);
 }
 
 std::vector<Vec3f>& CGALTetrahedralize::GetTetraNormals()
@@ -20,9 +20,10 @@ TetraMesh::TetraMesh( const fs::path& path,
                         const double facetAngle,
                         const double facetSize,
                         const double facetDistance,
-                        const double cellRadiusEdgeRatio )
+                        const double cellRadiusEdgeRatio,
+                        const CGALOptimizationOptions& optimization )
 {
-    generateTetrasFromSurface( loadSurface( path.string() ), cellSize, facetAngle, facetSize, facetDistance, cellRadiusEdgeRatio );
+    generateTetrasFromSurface( loadSurface( path.string() ), cellSize, facetAngle, facetSize, facetDistance, cellRadiusEdgeRatio, optimization );
 }
 
 TriangleTopologyRef TetraMesh::loadSurface(const std::string& filename )
@@ -35,24 +36,29 @@ TriangleTopologyRef TetraMesh::loadSurface(const std::string& filename )
         return nullptr;
     }
 
-    mSurface = std::make_shared<TetraTools::TriangleTopology>();
-    mSurface->Init( loader.GetVertices(), loader.GetTriangles() );
-    mSurface->GenerateNormals();
-   
+	// Vec3f and Triangle are plain float / index records, so the loaded buffers
+	// are copied into the cinder position and index buffers in one go.
+	const auto& loadedVertices = loader.GetVertices();
+	const auto& loadedTriangles = loader.GetTriangles();
 	mTriMesh = TriMesh::create();
-	for( const auto& vertex : loader.GetVertices() ) {
-		mTriMesh->appendPosition( ci::vec3( vertex.x, vertex.y, vertex.z ) );
-	}
-	for( const auto& triangle : loader.GetTriangles() ) {
-		mTriMesh->appendTriangle( triangle.index[0], triangle.index[1], triangle.index[2] );
-	}
+	auto& positions = mTriMesh->getBufferPositions();
+	positions.resize( loadedVertices.size() * 3 );
+	TetraTools::CopyToFloats( loadedVertices.data(), loadedVertices.size(), positions.data() );
+	auto& indices = mTriMesh->getIndices();
+	indices.resize( loadedTriangles.size() * 3 );
+	TetraTools::CopyToIndices( loadedTriangles.data(), loadedTriangles.size(), indices.data() );
+
+    std::vector<Vec3f> vertices;
+    std::vector<Triangle> triangles;
+    loader.release( vertices, triangles );
+    auto surface = std::make_shared<TetraTools::TriangleTopology>( std::move( vertices ), std::move( triangles ) );
     
     timer.stop();
     CI_LOG_I("Finished loading Surface Mesh for : " << filename << " in " << timer.getSeconds() << " seconds " );
-    return mSurface;
+    return surface;
 }
 
-TetraTopologyRef TetraMesh::generateTetrasFromSurface( const TriangleTopologyRef& triMesh, const double cellSize, const double facetAngle, const double facetSize, const double facetDistance, const double cellRadiusEdgeRatio  )
+TetraTopologyRef TetraMesh::generateTetrasFromSurface( const TriangleTopologyRef& triMesh, const double cellSize, const double facetAngle, const double facetSize, const double facetDistance, const double cellRadiusEdgeRatio, const CGALOptimizationOptions& optimization )
 {
     if( !triMesh ) return nullptr;
     
@@ -64,7 +70,7 @@ TetraTopologyRef TetraMesh::generateTetrasFromSurface( const TriangleTopologyRef
     CGALTetrahedralizeRef cth = std::make_shared<CGALTetrahedralize>();
     
     try {
-        cth->GenerateFromSurface( tris, verts, cellSize, facetAngle, facetSize, facetDistance, cellRadiusEdgeRatio );
+        cth->GenerateFromSurface( tris, verts, cellSize, facetAngle, facetSize, facetDistance, cellRadiusEdgeRatio, optimization );
     }
     
     catch( std::exception e ) {
@@ -77,9 +83,14 @@ TetraTopologyRef TetraMesh::generateTetrasFromSurface( const TriangleTopologyRef
     
     timer.stop();
     
+    std::vector<Vec3f> tetraVertices;
+    std::vector<Tetrahedron> tetras;
+    cth->Release( tetraVertices, tetras );
+    cth.reset();
+
     mTopology = std::make_shared<TetraTools::TetrahedronTopology>();
-    mTopology->Init( cth->GetTetraVertices(), cth->GetTetras(), false );
-    CI_LOG_I( "Generated tetrahedral mesh in : " << timer.getSeconds() << " with " << cth->GetTetras().size() << " tetras and " << cth->GetTetraVertices().size() << " vertices " );
+    mTopology->Init( std::move( tetraVertices ), std::move( tetras ), false );
+    CI_LOG_I( "Generated tetrahedral mesh in : " << timer.getSeconds() << " with " << mTopology->GetNumTetras() << " tetras and " << mTopology->GetNumVertices() << " vertices " );
     return mTopology;
 }
 
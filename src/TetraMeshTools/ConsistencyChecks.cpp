@@ -0,0 +1,371 @@
+/*
+ * ConsistencyChecks.cpp
+ */
+
+#include "ConsistencyChecks.h"
+#include "GeometryTypes.h"
+#include "SATriangleBoxIntersection.h"
+#include "Octree.h"
+#include "ParallelUtils.h"
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+	/// centers of the 8 children of the cube around center_ with child half size halfSize_, in octree quadrant order
+	void ChildCenters(const Vec3f& center_, const float halfSize_, Vec3f centers_[8])
+	{
+		for (unsigned int k=0; k<8; ++k)
+		{
+			centers_[k] = Vec3f(center_.x + ((k & 1) ? halfSize_ : -halfSize_),
+								center_.y + ((k < 4) ? halfSize_ : -halfSize_),
+								center_.z + ((k & 2) ? halfSize_ : -halfSize_));
+		}
+	}
+
+	struct TriBoxCheck
+	{
+		Vec3f						centers[8];
+		Vec3f						halfSize;
+		std::vector<Vec3f>			triverts;		/// three vertices per triangle
+		size_t						numTests;
+		size_t						numOverlaps;
+		size_t						numMismatches8;
+		size_t						numMismatchesN;
+		bool						reportMismatches;	/// print the first mismatch of each test
+
+		TriBoxCheck(const Vec3f& center_, const float halfSize_) : halfSize(halfSize_, halfSize_, halfSize_), numTests(0), numOverlaps(0), numMismatches8(0), numMismatchesN(0), reportMismatches(true)
+		{
+			ChildCenters(center_, halfSize_, centers);
+		}
+
+		void Add(const Vec3f& v0_, const Vec3f& v1_, const Vec3f& v2_)
+		{
+			triverts.push_back(v0_);
+			triverts.push_back(v1_);
+			triverts.push_back(v2_);
+		}
+
+		/// adds the triangle and its degenerate variants: a segment, a segment with a collinear midpoint and a point
+		void AddWithDegenerates(const Vec3f& v0_, const Vec3f& v1_, const Vec3f& v2_)
+		{
+			Add(v0_, v1_, v2_);
+			Add(v0_, v1_, v1_);
+			Add(v0_, v1_, (v0_ + v1_) * 0.5f);
+			Add(v2_, v2_, v2_);
+		}
+
+		void Run(const char* name_)
+		{
+			const unsigned int numTris = (unsigned int)(triverts.size() / 3);
+			for (unsigned int t=0; t<numTris; ++t)
+			{
+				const Vec3f* tv = &triverts[3 * t];
+				unsigned int reference = 0;
+				for (unsigned int k=0; k<8; ++k)
+				{
+					if (triBoxOverlap(centers[k], halfSize, tv) == 1)
+					{
+						reference |= 1u << k;
+						++numOverlaps;
+					}
+				}
+				if (triBoxOverlap8(centers, halfSize, tv) != reference)
+				{
+					if (reportMismatches && numMismatches8 == 0)
+						std::cerr<<"ERROR! triBoxOverlap8 differs from triBoxOverlap ("<<name_<<") for triangle "<<tv[0]<<", "<<tv[1]<<", "<<tv[2]<<std::endl;
+					++numMismatches8;
+				}
+				numTests += 8;
+			}
+			/// one guard byte behind the results, triBoxOverlapN must not write it
+			std::vector<unsigned char> overlaps(numTris + 1);
+			for (unsigned int k=0; k<8; ++k)
+			{
+				overlaps[numTris] = 0xAB;
+				const unsigned int count = triBoxOverlapN(centers[k], halfSize, &triverts[0], numTris, &overlaps[0]);
+				unsigned int referenceCount = 0;
+				for (unsigned int t=0; t<numTris; ++t)
+				{
+					const unsigned char reference = (triBoxOverlap(centers[k], halfSize, &triverts[3 * t]) == 1) ? 1 : 0;
+					referenceCount += reference;
+					if (overlaps[t] != reference)
+					{
+						if (reportMismatches && numMismatchesN == 0)
+							std::cerr<<"ERROR! triBoxOverlapN differs from triBoxOverlap ("<<name_<<") for triangle "<<triverts[3 * t]<<", "<<triverts[3 * t + 1]<<", "<<triverts[3 * t + 2]<<std::endl;
+						++numMismatchesN;
+					}
+				}
+				if (count != referenceCount || overlaps[numTris] != 0xAB)
+				{
+					if (reportMismatches && numMismatchesN == 0)
+						std::cerr<<"ERROR! triBoxOverlapN returned a wrong count or wrote past its results ("<<name_<<")"<<std::endl;
+					++numMismatchesN;
+				}
+			}
+			numTests += 8 * (size_t)numTris;
+		}
+	};
+
+	/// flattened octree in depth-first order, the leaf triangle lists are concatenated
+	struct OctreeRecord
+	{
+		struct Node
+		{
+			unsigned int	depth;
+			int				quadrant;
+			unsigned int	childMask;
+			Vec3f			minBC, maxBC;
+			size_t			numTriangles;
+		};
+
+		std::vector<Node>			nodes;
+		std::vector<unsigned int>	triangles;
+
+		void Add(const unsigned int depth_, const int quadrant_, const unsigned int childMask_, const Vec3f& minBC_, const Vec3f& maxBC_, const std::vector<unsigned int>& triangles_)
+		{
+			Node node;
+			node.depth = depth_;
+			node.quadrant = quadrant_;
+			node.childMask = childMask_;
+			node.minBC = minBC_;
+			node.maxBC = maxBC_;
+			node.numTriangles = triangles_.size();
+			nodes.push_back(node);
+			triangles.insert(triangles.end(), triangles_.begin(), triangles_.end());
+		}
+
+		void Add(const OctreeNode& node_)
+		{
+			unsigned int childMask = 0;
+			for (unsigned int k=0; k<8; ++k)
+			{
+				if (node_.getChildren()[k] != NULL)
+					childMask |= 1u << k;
+			}
+			Add(node_.getDepth(), node_.getQuadrant(), childMask, node_.getMinBC(), node_.getMaxBC(), node_.getTriangles());
+		}
+
+		/// returns the index of the first differing node, nodes.size() if both are the same
+		size_t Compare(const OctreeRecord& other_) const
+		{
+			size_t triangle = 0;
+			for (size_t n=0; n<nodes.size(); ++n)
+			{
+				if (n >= other_.nodes.size())
+					return n;
+				const Node& a = nodes[n];
+				const Node& b = other_.nodes[n];
+				if (a.depth != b.depth || a.quadrant != b.quadrant || a.childMask != b.childMask || a.numTriangles != b.numTriangles
+					|| a.minBC.x != b.minBC.x || a.minBC.y != b.minBC.y || a.minBC.z != b.minBC.z
+					|| a.maxBC.x != b.maxBC.x || a.maxBC.y != b.maxBC.y || a.maxBC.z != b.maxBC.z
+					|| !std::equal(triangles.begin() + triangle, triangles.begin() + triangle + a.numTriangles, other_.triangles.begin() + triangle))
+					return n;
+				triangle += a.numTriangles;
+			}
+			return (nodes.size() == other_.nodes.size()) ? nodes.size() : nodes.size() + 1;
+		}
+	};
+
+	void RecordOctree(const OctreeBuildOptions& options_, std::vector<Vec3f>& vertices_, std::vector<Triangle>& triangles_, OctreeRecord& record_)
+	{
+		const Octree octree(options_, &vertices_, &triangles_);
+		octree.getRootNode()->visitDepthFirst([&](const OctreeNode& node_)
+		{
+			record_.Add(node_);
+		});
+	}
+
+	/// the octree build before the batched test: a serial recursion with one triBoxOverlap call per child
+	void RecordReferenceOctree(	const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const unsigned int maxDepth_,
+								const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int depth_, const int quadrant_,
+								const std::vector<unsigned int>& nodeTriangles_, OctreeRecord& record_)
+	{
+		std::vector<unsigned int> childTriangles[8];
+		unsigned int childMask = 0;
+		if (depth_ < maxDepth_ && !nodeTriangles_.empty())
+		{
+			Vec3f center = minBC_ + maxBC_;
+			center /= 2.0f;
+			const float bcQuarterLength = (maxBC_.x - minBC_.x) * 0.25f;
+			const Vec3f boxQuarterSize(bcQuarterLength, bcQuarterLength, bcQuarterLength);
+			Vec3f childCenters[8];
+			ChildCenters(center, bcQuarterLength, childCenters);
+			for (size_t i=0; i<nodeTriangles_.size(); ++i)
+			{
+				const Triangle& t = triangles_[nodeTriangles_[i]];
+				const Vec3f triPoints[3] = {vertices_[t.index[0]], vertices_[t.index[1]], vertices_[t.index[2]]};
+				for (unsigned int k=0; k<8; ++k)
+				{
+					if (triBoxOverlap(childCenters[k], boxQuarterSize, triPoints) == 1)
+					{
+						childTriangles[k].push_back(nodeTriangles_[i]);
+						childMask |= 1u << k;
+					}
+				}
+			}
+		}
+		record_.Add(depth_, quadrant_, childMask, minBC_, maxBC_, (childMask != 0) ? std::vector<unsigned int>() : nodeTriangles_);
+		for (unsigned int k=0; k<8; ++k)
+		{
+			if (childMask & (1u << k))
+			{
+				Vec3f childMin, childMax;
+				OctreeNode::getChildBounds(minBC_, maxBC_, k, childMin, childMax);
+				RecordReferenceOctree(vertices_, triangles_, maxDepth_, childMin, childMax, depth_ + 1, k, childTriangles[k], record_);
+			}
+		}
+	}
+
+	bool CompareOctrees(const char* name_, const OctreeRecord& a_, const OctreeRecord& b_)
+	{
+		const size_t n = a_.Compare(b_);
+		if (n < a_.nodes.size() || a_.nodes.size() != b_.nodes.size())
+		{
+			std::cerr<<"ERROR! "<<name_<<": the octrees differ at node "<<n<<" ("<<a_.nodes.size()<<" / "<<b_.nodes.size()<<" nodes)"<<std::endl;
+			return false;
+		}
+		std::cout<<"\t"<<name_<<": "<<a_.nodes.size()<<" nodes, "<<a_.triangles.size()<<" leaf triangles, identical"<<std::endl;
+		return true;
+	}
+
+	void Report(const char* name_, const size_t numTriangles_, const size_t mismatches8_, const size_t mismatchesN_)
+	{
+		std::cout<<"\t"<<name_<<": "<<numTriangles_<<" triangles, "<<mismatches8_<<" / "<<mismatchesN_<<" mismatches (triBoxOverlap8 / triBoxOverlapN)"<<std::endl;
+	}
+}
+
+bool TetraTools::CheckTriBoxOverlapBatches(const unsigned int numRandomTriangles_)
+{
+	std::cout<<"Checking the batched triangle-box overlap tests..."<<std::endl;
+	std::mt19937 rng(1);
+	size_t numTests = 0;
+	size_t numOverlaps = 0;
+	size_t numMismatches = 0;
+
+	/// hand picked cases around the children of the cube [-1, 1]^3
+	{
+		TriBoxCheck check(Vec3f(0.0f, 0.0f, 0.0f), 0.5f);
+		/// in the split plane shared by four children and in an outer face
+		check.AddWithDegenerates(Vec3f(0.0f, -0.7f, -0.2f), Vec3f(0.0f, 0.3f, 0.6f), Vec3f(0.0f, 0.8f, -0.9f));
+		check.AddWithDegenerates(Vec3f(1.0f, -0.7f, -0.2f), Vec3f(1.0f, 0.3f, 0.6f), Vec3f(1.0f, 0.8f, -0.9f));
+		/// outside, touching an outer edge in one point and along a segment
+		check.AddWithDegenerates(Vec3f(1.0f, 1.0f, 0.2f), Vec3f(1.5f, 1.2f, 0.3f), Vec3f(1.3f, 1.5f, -0.4f));
+		check.AddWithDegenerates(Vec3f(1.0f, 1.0f, -0.5f), Vec3f(1.0f, 1.0f, 0.5f), Vec3f(1.5f, 1.5f, 0.0f));
+		/// outside, touching a corner
+		check.AddWithDegenerates(Vec3f(1.0f, 1.0f, 1.0f), Vec3f(1.5f, 1.2f, 1.1f), Vec3f(1.2f, 1.5f, 1.3f));
+		/// along the edge shared by all children and through the center
+		check.AddWithDegenerates(Vec3f(0.0f, 0.0f, -0.8f), Vec3f(0.0f, 0.0f, 0.8f), Vec3f(0.3f, 0.3f, 0.0f));
+		/// just outside of an outer face
+		check.AddWithDegenerates(Vec3f(1.0001f, -0.7f, -0.2f), Vec3f(1.0001f, 0.3f, 0.6f), Vec3f(1.0001f, 0.8f, -0.9f));
+		check.Run("touching");
+		Report("touching", check.triverts.size() / 3, check.numMismatches8, check.numMismatchesN);
+		numTests += check.numTests;
+		numOverlaps += check.numOverlaps;
+		numMismatches += check.numMismatches8 + check.numMismatchesN;
+	}
+
+	/// vertices on a lattice aligned with the box faces, so many triangles lie in faces or touch edges
+	/// and corners, at the origin and on a scaled and shifted copy that is not exactly representable
+	for (unsigned int s=0; s<2; ++s)
+	{
+		const Vec3f center = (s == 0) ? Vec3f(0.0f, 0.0f, 0.0f) : Vec3f(0.3f, -1.7f, 2.1f);
+		const float halfSize = (s == 0) ? 0.5f : 0.37f;
+		TriBoxCheck check(center, halfSize);
+		std::uniform_int_distribution<int> lattice(-3, 3);
+		for (unsigned int t=0; t<numRandomTriangles_ / 8; ++t)
+		{
+			Vec3f tv[3];
+			for (unsigned int i=0; i<3; ++i)
+			{
+				tv[i] = center + Vec3f((float)lattice(rng), (float)lattice(rng), (float)lattice(rng)) * halfSize;
+			}
+			check.AddWithDegenerates(tv[0], tv[1], tv[2]);
+		}
+		const char* name = (s == 0) ? "lattice" : "scaled lattice";
+		check.Run(name);
+		Report(name, check.triverts.size() / 3, check.numMismatches8, check.numMismatchesN);
+		numTests += check.numTests;
+		numOverlaps += check.numOverlaps;
+		numMismatches += check.numMismatches8 + check.numMismatchesN;
+	}
+
+	/// random triangles of all sizes, a new set of boxes every 1000 triangles
+	{
+		std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> size(0.01f, 0.6f);
+		size_t numTriangles = 0;
+		size_t mismatches8 = 0;
+		size_t mismatchesN = 0;
+		for (unsigned int b=0; b<(numRandomTriangles_ + 999) / 1000; ++b)
+		{
+			const Vec3f center(coordinate(rng), coordinate(rng), coordinate(rng));
+			TriBoxCheck check(center * 0.5f, size(rng));
+			for (unsigned int t=0; t<1000 && b * 1000 + t<numRandomTriangles_; ++t)
+			{
+				Vec3f tv[3];
+				const float scale = (t & 1) ? 1.0f : 0.1f;
+				for (unsigned int i=0; i<3; ++i)
+				{
+					tv[i] = center + Vec3f(coordinate(rng), coordinate(rng), coordinate(rng)) * scale;
+				}
+				if (t % 7 == 0)
+					check.AddWithDegenerates(tv[0], tv[1], tv[2]);
+				else
+					check.Add(tv[0], tv[1], tv[2]);
+			}
+			check.reportMismatches = (mismatches8 + mismatchesN == 0);
+			check.Run("random");
+			numTriangles += check.triverts.size() / 3;
+			mismatches8 += check.numMismatches8;
+			mismatchesN += check.numMismatchesN;
+			numTests += check.numTests;
+			numOverlaps += check.numOverlaps;
+		}
+		Report("random", numTriangles, mismatches8, mismatchesN);
+		numMismatches += mismatches8 + mismatchesN;
+	}
+
+	std::cout<<"\t"<<numTests<<" tests, "<<numOverlaps<<" overlaps, "<<numMismatches<<" mismatches"<<std::endl;
+	return numMismatches == 0;
+}
+
+bool TetraTools::CheckOctreeBuild(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const unsigned int maxDepth_, const unsigned int numThreads_)
+{
+	std::cout<<"Checking the octree build..."<<std::endl;
+	/// the octree keeps non-const pointers to its input
+	std::vector<Vec3f> vertices(vertices_);
+	std::vector<Triangle> triangles(triangles_);
+	const unsigned int numThreads = (numThreads_ > 0) ? numThreads_ : GetNumThreads();
+	const unsigned int previousNumThreads = Detail::NumThreadsOverride();
+	bool identical = true;
+	for (unsigned int c=0; c<2; ++c)
+	{
+		OctreeBuildOptions options(maxDepth_);
+		options.conservativeOverlap = (c == 1);
+		OctreeRecord serial, parallel;
+		SetNumThreads(1);
+		RecordOctree(options, vertices, triangles, serial);
+		SetNumThreads(numThreads);
+		RecordOctree(options, vertices, triangles, parallel);
+		SetNumThreads(previousNumThreads);
+		identical = CompareOctrees(options.conservativeOverlap ? "conservative, 1 thread / N threads" : "default, 1 thread / N threads", serial, parallel) && identical;
+		if (!options.conservativeOverlap)
+		{
+			Vec3f minBC, maxBC;
+			Octree::computeBoundingCube(vertices, minBC, maxBC);
+			std::vector<unsigned int> rootTriangles(triangles.size());
+			for (unsigned int i=0; i<rootTriangles.size(); ++i)
+			{
+				rootTriangles[i] = i;
+			}
+			OctreeRecord reference;
+			RecordReferenceOctree(vertices, triangles, maxDepth_, minBC, maxBC, 0, -1, rootTriangles, reference);
+			identical = CompareOctrees("default / scalar reference", reference, serial) && identical;
+		}
+	}
+	std::cout<<"\tbuilt with 1 and "<<numThreads<<" threads"<<std::endl;
+	return identical;
+}
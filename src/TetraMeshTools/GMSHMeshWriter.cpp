@@ -37,4 +37,10 @@ bool TetraTools::GMSHMeshWriter::SaveToFile(const std::string& fileName_, const
 		return false;
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+bool TetraTools::GMSHMeshWriter::SaveToFile(const std::string& fileName_, TetrahedronTopology& topology_)
+{
+	const TetrahedronTopology& topology = topology_;
+	return SaveToFile(fileName_, topology.GetVertices(), topology_.GetTetrahedra());
+}
@@ -0,0 +1,61 @@
+/*
+ * GraphColouring.cpp
+ *
+ * CSR front end for the Jones-Plassmann colouring and colour class grouping.
+ */
+
+#include "GraphColouring.h"
+
+namespace
+{
+	/**
+	 * Neighbour enumeration over a CSR adjacency for the colouring template.
+	 */
+	struct CSRNeighbours
+	{
+		const std::vector<unsigned int>& offsets;
+		const std::vector<unsigned int>& neighbours;
+
+		CSRNeighbours(const std::vector<unsigned int>& offsets_, const std::vector<unsigned int>& neighbours_)
+			: offsets(offsets_), neighbours(neighbours_)
+		{
+		}
+
+		template <typename Visitor>
+		void operator()(const unsigned int node_, const Visitor& visitor_) const
+		{
+			for (unsigned int k=offsets[node_]; k<offsets[node_+1]; ++k)
+				visitor_(neighbours[k]);
+		}
+	};
+}
+
+unsigned int TetraTools::ComputeGraphColouring(const std::vector<unsigned int>& offsets_, const std::vector<unsigned int>& neighbours_, std::vector<unsigned int>& colours_)
+{
+	if (offsets_.size() < 2)
+	{
+		colours_.clear();
+		return 0;
+	}
+	const unsigned int numNodes = offsets_.size() - 1;
+	return ComputeGraphColouring(numNodes, CSRNeighbours(offsets_, neighbours_), colours_);
+}
+
+void TetraTools::GroupByColour(const std::vector<unsigned int>& colours_, const unsigned int numColours_, std::vector<unsigned int>& offsets_, std::vector<unsigned int>& order_)
+{
+	offsets_.assign(numColours_ + 1, 0);
+	for (size_t i=0; i<colours_.size(); ++i)
+	{
+		++offsets_[colours_[i] + 1];
+	}
+	for (unsigned int c=0; c<numColours_; ++c)
+	{
+		offsets_[c+1] += offsets_[c];
+	}
+	order_.resize(colours_.size());
+	std::vector<unsigned int> cursor(offsets_.begin(), offsets_.end() - 1);
+	for (size_t i=0; i<colours_.size(); ++i)
+	{
+		order_[cursor[colours_[i]]++] = (unsigned int)i;
+	}
+}
@@ -0,0 +1,174 @@
+/*
+ * GraphOrdering.cpp
+ *
+ * Bandwidth / profile measurement and Reverse Cuthill-McKee ordering.
+ */
+
+#include "GraphOrdering.h"
+#include "ParallelUtils.h"
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+	/**
+	 * Breadth-first level structure rooted at root_. The visited vertices are written to
+	 * queue_ in level order; vertices with mark_[v] == stamp_ count as visited.
+	 * Returns the number of levels, lastLevelBegin_ is the index of the first vertex
+	 * of the last level in queue_.
+	 */
+	unsigned int BuildLevelStructure(	const unsigned int root_,
+										const std::vector<unsigned int>& offsets_,
+										const std::vector<unsigned int>& neighbours_,
+										std::vector<unsigned int>& mark_,
+										const unsigned int stamp_,
+										std::vector<unsigned int>& queue_,
+										size_t& lastLevelBegin_)
+	{
+		queue_.clear();
+		queue_.push_back(root_);
+		mark_[root_] = stamp_;
+		size_t levelBegin = 0;
+		unsigned int numLevels = 0;
+		while (levelBegin < queue_.size())
+		{
+			const size_t levelEnd = queue_.size();
+			lastLevelBegin_ = levelBegin;
+			++numLevels;
+			for (size_t q=levelBegin; q<levelEnd; ++q)
+			{
+				const unsigned int v = queue_[q];
+				for (unsigned int k=offsets_[v]; k<offsets_[v+1]; ++k)
+				{
+					const unsigned int n = neighbours_[k];
+					if (mark_[n] != stamp_)
+					{
+						mark_[n] = stamp_;
+						queue_.push_back(n);
+					}
+				}
+			}
+			levelBegin = levelEnd;
+		}
+		return numLevels;
+	}
+
+	inline unsigned int Degree(const std::vector<unsigned int>& offsets_, const unsigned int v_)
+	{
+		return offsets_[v_+1] - offsets_[v_];
+	}
+}
+
+TetraTools::BandwidthInfo TetraTools::ComputeBandwidth(	const std::vector<unsigned int>& offsets_,
+														const std::vector<unsigned int>& neighbours_,
+														const std::vector<unsigned int>& permutation_)
+{
+	BandwidthInfo info;
+	info.bandwidth = 0;
+	info.profile = 0;
+	if (offsets_.size() < 2)
+		return info;
+	const size_t numVerts = offsets_.size() - 1;
+	const bool permuted = !permutation_.empty();
+	std::mutex mutex;
+	ParallelFor(0, numVerts, [&](size_t b_, size_t e_)
+	{
+		unsigned int bandwidth = 0;
+		uint64_t profile = 0;
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const unsigned int row = permuted ? permutation_[i] : (unsigned int)i;
+			unsigned int firstColumn = row;
+			for (unsigned int k=offsets_[i]; k<offsets_[i+1]; ++k)
+			{
+				const unsigned int column = permuted ? permutation_[neighbours_[k]] : neighbours_[k];
+				bandwidth = std::max(bandwidth, (column > row) ? column - row : row - column);
+				firstColumn = std::min(firstColumn, column);
+			}
+			profile += row - firstColumn;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		info.bandwidth = std::max(info.bandwidth, bandwidth);
+		info.profile += profile;
+	});
+	return info;
+}
+
+void TetraTools::ComputeReverseCuthillMcKee(const std::vector<unsigned int>& offsets_,
+											const std::vector<unsigned int>& neighbours_,
+											std::vector<unsigned int>& permutation_)
+{
+	permutation_.clear();
+	if (offsets_.size() < 2)
+		return;
+	const unsigned int numVerts = offsets_.size() - 1;
+	/// Cuthill-McKee order (new -> old), reversed at the end
+	std::vector<unsigned int> order;
+	order.reserve(numVerts);
+	std::vector<unsigned char> numbered(numVerts, 0);
+	std::vector<unsigned int> mark(numVerts, 0);
+	unsigned int stamp = 0;
+	std::vector<unsigned int> levels;
+	std::vector<unsigned int> candidateLevels;
+	std::vector<unsigned int> candidates;
+
+	for (unsigned int start=0; start<numVerts; ++start)
+	{
+		if (numbered[start])
+			continue;
+
+		/// find a pseudo-peripheral vertex of this component
+		unsigned int root = start;
+		size_t lastLevelBegin = 0;
+		unsigned int eccentricity = BuildLevelStructure(root, offsets_, neighbours_, mark, ++stamp, levels, lastLevelBegin);
+		while (true)
+		{
+			unsigned int candidate = levels[lastLevelBegin];
+			for (size_t q=lastLevelBegin+1; q<levels.size(); ++q)
+			{
+				if (Degree(offsets_, levels[q]) < Degree(offsets_, candidate))
+					candidate = levels[q];
+			}
+			size_t candidateLastLevel = 0;
+			const unsigned int candidateEccentricity = BuildLevelStructure(candidate, offsets_, neighbours_, mark, ++stamp, candidateLevels, candidateLastLevel);
+			if (candidateEccentricity <= eccentricity)
+				break;
+			root = candidate;
+			eccentricity = candidateEccentricity;
+			levels.swap(candidateLevels);
+			lastLevelBegin = candidateLastLevel;
+		}
+
+		/// breadth-first numbering, unnumbered neighbours by ascending degree
+		size_t head = order.size();
+		order.push_back(root);
+		numbered[root] = 1;
+		while (head < order.size())
+		{
+			const unsigned int v = order[head++];
+			candidates.clear();
+			for (unsigned int k=offsets_[v]; k<offsets_[v+1]; ++k)
+			{
+				const unsigned int n = neighbours_[k];
+				if (!numbered[n])
+				{
+					numbered[n] = 1;
+					candidates.push_back(n);
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [&offsets_](const unsigned int a_, const unsigned int b_)
+			{
+				const unsigned int da = Degree(offsets_, a_);
+				const unsigned int db = Degree(offsets_, b_);
+				return (da < db) || (da == db && a_ < b_);
+			});
+			order.insert(order.end(), candidates.begin(), candidates.end());
+		}
+	}
+
+	permutation_.resize(numVerts);
+	for (unsigned int i=0; i<numVerts; ++i)
+	{
+		permutation_[order[i]] = numVerts - 1 - i;
+	}
+}
@@ -0,0 +1,373 @@
+/**
+ *	LinearOctree.cpp
+ *
+ */
+
+#include "LinearOctree.h"
+#include <iostream>
+#include <algorithm>
+#include "Octree.h"
+#include "ParallelUtils.h"
+
+namespace
+{
+	unsigned int countBits(unsigned int mask_)
+	{
+		unsigned int count = 0;
+		for (; mask_ != 0; mask_ &= mask_ - 1)
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
+LinearOctree::LinearOctree(const unsigned int maxDepth_, const std::vector<Vec3f>* inPoints_, const std::vector<Triangle>* inTris_) : _maxDepth(std::min(maxDepth_, 21u))
+{
+	if (maxDepth_ > 21)
+	{
+		std::cerr<<"ERROR! LinearOctree: depth "<<maxDepth_<<" exceeds the 21 levels of the locational code, using 21."<<std::endl;
+	}
+	Octree::computeBoundingCube(*inPoints_, _minBC, _maxBC);
+	build(*inPoints_, *inTris_);
+}
+
+unsigned int LinearOctree::quadrantToMorton(const unsigned int quadrant_)
+{
+	const unsigned int x = quadrant_ & 1;
+	const unsigned int y = (quadrant_ < 4) ? 1 : 0;
+	const unsigned int z = (quadrant_ >> 1) & 1;
+	return x | (y << 1) | (z << 2);
+}
+
+unsigned int LinearOctree::mortonToQuadrant(const unsigned int morton_)
+{
+	const unsigned int x = morton_ & 1;
+	const unsigned int y = (morton_ >> 1) & 1;
+	const unsigned int z = (morton_ >> 2) & 1;
+	return (y ? 0 : 4) + (z ? 2 : 0) + x;
+}
+
+void LinearOctree::build(const std::vector<Vec3f>& points_, const std::vector<Triangle>& tris_)
+{
+	// The tree is built level by level. The nodes of the current level keep their
+	// boxes (computed exactly like OctreeNode does, so both trees are identical)
+	// and their triangle lists in CSR form until the next level is created.
+	std::vector<Vec3f> levelMin(1, _minBC), levelMax(1, _maxBC);
+	std::vector<uint64_t> levelOffsets(2, 0);
+	std::vector<unsigned int> levelTriangles(tris_.size());
+	for (unsigned int i=0; i<levelTriangles.size(); ++i)
+	{
+		levelTriangles[i] = i;
+	}
+	levelOffsets[1] = levelTriangles.size();
+
+	_nodes.clear();
+	_leafTriangleOffsets.assign(1, 0);
+	_leafTriangles.clear();
+	LinearOctreeNode root;
+	root.code = 1;
+	root.first = 0;
+	root.childMask = 0;
+	root.depth = 0;
+	_nodes.push_back(root);
+
+	size_t levelBegin = 0;
+	for (unsigned int depth=0; ; ++depth)
+	{
+		const size_t numLevelNodes = _nodes.size() - levelBegin;
+
+		// child overlap mask (Morton slots) of every triangle entry of the level
+		std::vector<unsigned char> masks(levelTriangles.size(), 0);
+		if (depth < _maxDepth)
+		{
+			TetraTools::ParallelFor(0, levelTriangles.size(), [&](size_t b_, size_t e_)
+			{
+				size_t n = std::upper_bound(levelOffsets.begin(), levelOffsets.end(), (uint64_t)b_) - levelOffsets.begin() - 1;
+				for (size_t e=b_; e<e_; ++e)
+				{
+					while (levelOffsets[n+1] <= e)
+					{
+						++n;
+					}
+					const Triangle& t = tris_[levelTriangles[e]];
+					const Vec3f triPoints[3] = {points_[t.index[0]], points_[t.index[1]], points_[t.index[2]]};
+					const unsigned int quadrantMask = OctreeNode::getChildOverlapMask(levelMin[n], levelMax[n], triPoints);
+					unsigned char mask = 0;
+					for (unsigned int q=0; q<8; ++q)
+					{
+						if (quadrantMask & (1u << q))
+						{
+							mask |= (unsigned char)(1u << quadrantToMorton(q));
+						}
+					}
+					masks[e] = mask;
+				}
+			}, 256);
+		}
+
+		// child masks and the number of triangles per child
+		std::vector<unsigned char> childMasks(numLevelNodes, 0);
+		std::vector<uint64_t> childCounts(numLevelNodes * 8, 0);
+		TetraTools::ParallelFor(0, numLevelNodes, [&](size_t b_, size_t e_)
+		{
+			for (size_t n=b_; n<e_; ++n)
+			{
+				for (uint64_t e=levelOffsets[n]; e<levelOffsets[n+1]; ++e)
+				{
+					childMasks[n] |= masks[e];
+					for (unsigned int m=0; m<8; ++m)
+					{
+						childCounts[n * 8 + m] += (masks[e] >> m) & 1;
+					}
+				}
+			}
+		}, 256);
+
+		// append the next level in parent order and Morton order within a parent,
+		// which keeps the node array sorted by locational code
+		const size_t nextLevelBegin = _nodes.size();
+		std::vector<Vec3f> nextMin, nextMax;
+		std::vector<uint64_t> nextOffsets(1, 0);
+		for (size_t n=0; n<numLevelNodes; ++n)
+		{
+			const size_t index = levelBegin + n;
+			_nodes[index].childMask = childMasks[n];
+			if (childMasks[n] == 0)
+			{
+				_nodes[index].first = (unsigned int)_leafTriangleOffsets.size() - 1;
+				_leafTriangleOffsets.push_back(_leafTriangleOffsets.back() + (levelOffsets[n+1] - levelOffsets[n]));
+				continue;
+			}
+			_nodes[index].first = (unsigned int)_nodes.size();
+			for (unsigned int m=0; m<8; ++m)
+			{
+				if ((childMasks[n] & (1u << m)) == 0)
+				{
+					continue;
+				}
+				LinearOctreeNode child;
+				child.code = (_nodes[index].code << 3) | m;
+				child.first = 0;
+				child.childMask = 0;
+				child.depth = (unsigned char)(depth + 1);
+				_nodes.push_back(child);
+				Vec3f childMin, childMax;
+				OctreeNode::getChildBounds(levelMin[n], levelMax[n], mortonToQuadrant(m), childMin, childMax);
+				nextMin.push_back(childMin);
+				nextMax.push_back(childMax);
+				nextOffsets.push_back(nextOffsets.back() + childCounts[n * 8 + m]);
+			}
+		}
+
+		// scatter the triangle lists into the children and the leaf payloads
+		std::vector<unsigned int> nextTriangles(nextOffsets.back());
+		_leafTriangles.resize(_leafTriangleOffsets.back());
+		TetraTools::ParallelFor(0, numLevelNodes, [&](size_t b_, size_t e_)
+		{
+			for (size_t n=b_; n<e_; ++n)
+			{
+				const LinearOctreeNode& node = _nodes[levelBegin + n];
+				if (node.childMask == 0)
+				{
+					std::copy(levelTriangles.begin() + levelOffsets[n], levelTriangles.begin() + levelOffsets[n+1], _leafTriangles.begin() + _leafTriangleOffsets[node.first]);
+					continue;
+				}
+				uint64_t cursors[8];
+				unsigned int child = node.first - (unsigned int)nextLevelBegin;
+				for (unsigned int m=0; m<8; ++m)
+				{
+					if (node.childMask & (1u << m))
+					{
+						cursors[m] = nextOffsets[child++];
+					}
+				}
+				for (uint64_t e=levelOffsets[n]; e<levelOffsets[n+1]; ++e)
+				{
+					for (unsigned int m=0; m<8; ++m)
+					{
+						if (masks[e] & (1u << m))
+						{
+							nextTriangles[cursors[m]++] = levelTriangles[e];
+						}
+					}
+				}
+			}
+		}, 256);
+
+		if (_nodes.size() == nextLevelBegin)
+		{
+			break;
+		}
+		levelBegin = nextLevelBegin;
+		levelMin.swap(nextMin);
+		levelMax.swap(nextMax);
+		levelOffsets.swap(nextOffsets);
+		levelTriangles.swap(nextTriangles);
+	}
+	std::cout<<"LinearOctree: "<<_nodes.size()<<" nodes, "<<getNumLeafs()<<" leafs"<<std::endl;
+}
+
+int LinearOctree::getChild(const unsigned int index_, const unsigned int morton_) const
+{
+	const LinearOctreeNode& node = _nodes[index_];
+	if ((node.childMask & (1u << morton_)) == 0)
+	{
+		return -1;
+	}
+	return (int)(node.first + countBits(node.childMask & ((1u << morton_) - 1)));
+}
+
+int LinearOctree::findNode(const uint64_t code_) const
+{
+	int lo = 0;
+	int hi = (int)_nodes.size();
+	while (lo < hi)
+	{
+		const int mid = lo + (hi - lo) / 2;
+		if (_nodes[mid].code < code_)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	if (lo < (int)_nodes.size() && _nodes[lo].code == code_)
+	{
+		return lo;
+	}
+	return -1;
+}
+
+void LinearOctree::decodePosition(const uint64_t code_, const unsigned int depth_, unsigned int& x_, unsigned int& y_, unsigned int& z_)
+{
+	x_ = y_ = z_ = 0;
+	for (unsigned int l=0; l<depth_; ++l)
+	{
+		const unsigned int m = (unsigned int)(code_ >> (3 * l)) & 7;
+		x_ |= (m & 1) << l;
+		y_ |= ((m >> 1) & 1) << l;
+		z_ |= ((m >> 2) & 1) << l;
+	}
+}
+
+void LinearOctree::getNodeBounds(const unsigned int index_, Vec3f& minBC_, Vec3f& maxBC_) const
+{
+	const LinearOctreeNode& node = _nodes[index_];
+	unsigned int x, y, z;
+	decodePosition(node.code, node.depth, x, y, z);
+	const float size = (_maxBC.x - _minBC.x) / (float)(1u << node.depth);
+	minBC_ = Vec3f(_minBC.x + x * size, _minBC.y + y * size, _minBC.z + z * size);
+	maxBC_ = Vec3f(_minBC.x + (x + 1) * size, _minBC.y + (y + 1) * size, _minBC.z + (z + 1) * size);
+}
+
+void LinearOctree::collectLeafs(const unsigned int index_, const bool leafsOnly_, std::vector<NodeRef>& leafs_) const
+{
+	const LinearOctreeNode& node = _nodes[index_];
+	if (node.childMask != 0)
+	{
+		for (unsigned int q=0; q<8; ++q)
+		{
+			const int child = getChild(index_, quadrantToMorton(q));
+			if (child >= 0)
+			{
+				collectLeafs((unsigned int)child, leafsOnly_, leafs_);
+			}
+		}
+		if (leafsOnly_)
+		{
+			return;
+		}
+	}
+	leafs_.push_back(NodeRef(this, index_));
+}
+
+LinearOctree::NodeRef LinearOctree::NodeRef::getParent() const
+{
+	if (_index == 0)
+	{
+		return NodeRef();
+	}
+	return NodeRef(_tree, (unsigned int)_tree->findNode(_tree->_nodes[_index].code >> 3));
+}
+
+std::vector<LinearOctree::NodeRef> LinearOctree::NodeRef::getChildren() const
+{
+	std::vector<NodeRef> children(8);
+	for (unsigned int m=0; m<8; ++m)
+	{
+		const int child = _tree->getChild(_index, m);
+		if (child >= 0)
+		{
+			children[mortonToQuadrant(m)] = NodeRef(_tree, (unsigned int)child);
+		}
+	}
+	return children;
+}
+
+std::vector<LinearOctree::NodeRef> LinearOctree::NodeRef::getLeafs(const bool leafsOnly_) const
+{
+	std::vector<NodeRef> leafs;
+	_tree->collectLeafs(_index, leafsOnly_, leafs);
+	return leafs;
+}
+
+Vec3f LinearOctree::NodeRef::getMinBC() const
+{
+	Vec3f minBC, maxBC;
+	_tree->getNodeBounds(_index, minBC, maxBC);
+	return minBC;
+}
+
+Vec3f LinearOctree::NodeRef::getMaxBC() const
+{
+	Vec3f minBC, maxBC;
+	_tree->getNodeBounds(_index, minBC, maxBC);
+	return maxBC;
+}
+
+bool LinearOctree::NodeRef::hasChildren() const
+{
+	return _tree->_nodes[_index].childMask != 0;
+}
+
+unsigned int LinearOctree::NodeRef::getDepth() const
+{
+	return _tree->_nodes[_index].depth;
+}
+
+int LinearOctree::NodeRef::getQuadrant() const
+{
+	if (_index == 0)
+	{
+		return -1;
+	}
+	return (int)mortonToQuadrant((unsigned int)(_tree->_nodes[_index].code & 7));
+}
+
+const unsigned int* LinearOctree::NodeRef::trianglesBegin() const
+{
+	const LinearOctreeNode& node = _tree->_nodes[_index];
+	if (node.childMask != 0)
+	{
+		return NULL;
+	}
+	return _tree->_leafTriangles.data() + _tree->_leafTriangleOffsets[node.first];
+}
+
+const unsigned int* LinearOctree::NodeRef::trianglesEnd() const
+{
+	const LinearOctreeNode& node = _tree->_nodes[_index];
+	if (node.childMask != 0)
+	{
+		return NULL;
+	}
+	return _tree->_leafTriangles.data() + _tree->_leafTriangleOffsets[node.first + 1];
+}
+
+unsigned int LinearOctree::NodeRef::getNumTriangles() const
+{
+	return (unsigned int)(trianglesEnd() - trianglesBegin());
+}
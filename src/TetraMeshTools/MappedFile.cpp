@@ -0,0 +1,155 @@
+/*
+ * MappedFile.cpp
+ *
+ * POSIX (mmap) and Windows (file mapping) implementation of MappedFile.
+ */
+
+#include "MappedFile.h"
+#include <iostream>
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+TetraTools::MappedFile::MappedFile()
+	: _data(NULL), _size(0), _writable(false)
+#ifdef WIN32
+	, _fileHandle(INVALID_HANDLE_VALUE), _mappingHandle(NULL)
+#else
+	, _fileDescriptor(-1)
+#endif
+{
+}
+
+TetraTools::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool TetraTools::MappedFile::Create(const std::string& fileName_, const uint64_t size_)
+{
+	Close();
+#ifdef WIN32
+	_fileHandle = CreateFileA(fileName_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr<<"ERROR! Cannot create mapped file "<<fileName_<<"!"<<std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	size.QuadPart = (LONGLONG)size_;
+	if (!SetFilePointerEx(_fileHandle, size, NULL, FILE_BEGIN) || !SetEndOfFile(_fileHandle))
+	{
+		std::cerr<<"ERROR! Cannot resize mapped file "<<fileName_<<" to "<<size_<<" bytes!"<<std::endl;
+		CloseHandle(_fileHandle);
+		_fileHandle = INVALID_HANDLE_VALUE;
+		return false;
+	}
+#else
+	_fileDescriptor = open(fileName_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (_fileDescriptor < 0)
+	{
+		std::cerr<<"ERROR! Cannot create mapped file "<<fileName_<<"!"<<std::endl;
+		return false;
+	}
+	if (ftruncate(_fileDescriptor, (off_t)size_) != 0)
+	{
+		std::cerr<<"ERROR! Cannot resize mapped file "<<fileName_<<" to "<<size_<<" bytes!"<<std::endl;
+		close(_fileDescriptor);
+		_fileDescriptor = -1;
+		return false;
+	}
+#endif
+	_fileName = fileName_;
+	_size = size_;
+	_writable = true;
+	return Map();
+}
+
+bool TetraTools::MappedFile::Open(const std::string& fileName_, const bool writable_)
+{
+	Close();
+#ifdef WIN32
+	_fileHandle = CreateFileA(fileName_.c_str(), writable_ ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr<<"ERROR! Cannot open mapped file "<<fileName_<<"!"<<std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(_fileHandle, &size);
+	_size = (uint64_t)size.QuadPart;
+#else
+	_fileDescriptor = open(fileName_.c_str(), writable_ ? O_RDWR : O_RDONLY);
+	if (_fileDescriptor < 0)
+	{
+		std::cerr<<"ERROR! Cannot open mapped file "<<fileName_<<"!"<<std::endl;
+		return false;
+	}
+	struct stat status;
+	fstat(_fileDescriptor, &status);
+	_size = (uint64_t)status.st_size;
+#endif
+	_fileName = fileName_;
+	_writable = writable_;
+	return Map();
+}
+
+bool TetraTools::MappedFile::Map()
+{
+	/// empty files stay unmapped
+	if (_size == 0)
+		return true;
+#ifdef WIN32
+	_mappingHandle = CreateFileMappingA(_fileHandle, NULL, _writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(_size >> 32), (DWORD)(_size & 0xFFFFFFFFu), NULL);
+	if (_mappingHandle != NULL)
+		_data = MapViewOfFile(_mappingHandle, _writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+#else
+	_data = mmap(NULL, (size_t)_size, _writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _fileDescriptor, 0);
+	if (_data == MAP_FAILED)
+		_data = NULL;
+#endif
+	if (_data == NULL)
+	{
+		std::cerr<<"ERROR! Cannot map "<<_size<<" bytes of "<<_fileName<<"!"<<std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void TetraTools::MappedFile::AdviseSequential()
+{
+#ifndef WIN32
+	if (_data != NULL)
+		madvise(_data, (size_t)_size, MADV_SEQUENTIAL);
+#endif
+}
+
+void TetraTools::MappedFile::Close()
+{
+#ifdef WIN32
+	if (_data != NULL)
+		UnmapViewOfFile(_data);
+	if (_mappingHandle != NULL)
+		CloseHandle(_mappingHandle);
+	if (_fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(_fileHandle);
+	_mappingHandle = NULL;
+	_fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (_data != NULL)
+		munmap(_data, (size_t)_size);
+	if (_fileDescriptor >= 0)
+		close(_fileDescriptor);
+	_fileDescriptor = -1;
+#endif
+	_data = NULL;
+	_size = 0;
+	_fileName.clear();
+}
@@ -0,0 +1,469 @@
+/*
+ * MeshPartition.cpp
+ *
+ * Recursive coordinate / inertial bisection, dual graph refinement and part extraction.
+ */
+
+#include "MeshPartition.h"
+#include "TetgenWriter.h"
+#include "ParallelUtils.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <stdint.h>
+#ifndef WIN32
+#include <cfloat>
+#include <math.h>
+#else
+#include <float.h>
+#endif
+
+namespace
+{
+	/**
+	 * A tetrahedron face with sorted vertex indices, tetFace = 4 * tetra + opposite vertex.
+	 */
+	struct FaceKey
+	{
+		unsigned int v[3];
+		unsigned int tetFace;
+
+		bool operator<(const FaceKey& f_) const
+		{
+			if (v[0] != f_.v[0])
+				return v[0] < f_.v[0];
+			if (v[1] != f_.v[1])
+				return v[1] < f_.v[1];
+			if (v[2] != f_.v[2])
+				return v[2] < f_.v[2];
+			return tetFace < f_.tetFace;
+		}
+
+		bool SameFace(const FaceKey& f_) const
+		{
+			return v[0] == f_.v[0] && v[1] == f_.v[1] && v[2] == f_.v[2];
+		}
+	};
+
+	/**
+	 * Principal axis of the points order_[begin_, end_) by power iteration on their covariance,
+	 * started from the longest bounding box axis.
+	 */
+	Vec3f PrincipalAxis(const std::vector<Vec3f>& points_, const std::vector<unsigned int>& order_, const size_t begin_, const size_t end_, const Vec3f& start_)
+	{
+		double mean[3] = {0.0, 0.0, 0.0};
+		for (size_t i=begin_; i<end_; ++i)
+		{
+			const Vec3f& p = points_[order_[i]];
+			mean[0] += p.x;
+			mean[1] += p.y;
+			mean[2] += p.z;
+		}
+		const double n = (double)(end_ - begin_);
+		for (unsigned int j=0; j<3; ++j)
+			mean[j] /= n;
+		double cov[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+		for (size_t i=begin_; i<end_; ++i)
+		{
+			const Vec3f& p = points_[order_[i]];
+			const double d[3] = {p.x - mean[0], p.y - mean[1], p.z - mean[2]};
+			for (unsigned int r=0; r<3; ++r)
+				for (unsigned int c=0; c<3; ++c)
+					cov[r][c] += d[r] * d[c];
+		}
+		double axis[3] = {start_.x, start_.y, start_.z};
+		for (unsigned int iteration=0; iteration<64; ++iteration)
+		{
+			double next[3];
+			for (unsigned int r=0; r<3; ++r)
+				next[r] = cov[r][0] * axis[0] + cov[r][1] * axis[1] + cov[r][2] * axis[2];
+			const double length = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length <= DBL_MIN)
+				return start_;
+			for (unsigned int r=0; r<3; ++r)
+				axis[r] = next[r] / length;
+		}
+		return Vec3f((float)axis[0], (float)axis[1], (float)axis[2]);
+	}
+}
+
+TetraTools::MeshPartitioner::MeshPartitioner()
+	: _method(PARTITION_INERTIAL_BISECTION), _numParts(2), _numRefinementPasses(4), _imbalance(0.03f), _numHaloLayers(1), _numCutFaces(0)
+{
+}
+
+void TetraTools::MeshPartitioner::GenerateFaceNeighbours(const std::vector<Tetrahedron>& tetras_)
+{
+	const size_t numTetras = tetras_.size();
+	std::vector<FaceKey> faces(4 * numTetras);
+	ParallelFor(0, numTetras, [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const Tetrahedron& t = tetras_[i];
+			for (unsigned int j=0; j<4; ++j)
+			{
+				FaceKey& f = faces[4 * i + j];
+				f.v[0] = t.index[(j+1)%4];
+				f.v[1] = t.index[(j+2)%4];
+				f.v[2] = t.index[(j+3)%4];
+				std::sort(f.v, f.v + 3);
+				f.tetFace = (unsigned int)(4 * i + j);
+			}
+		}
+	});
+	ParallelSort(faces.begin(), faces.end(), [](const FaceKey& a_, const FaceKey& b_) { return a_ < b_; });
+
+	_faceNeighbours.assign(4 * numTetras, NoFaceNeighbour);
+	ParallelFor(1, faces.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			/// only the first two tetrahedra of a (non-manifold) face are paired
+			if (faces[i].SameFace(faces[i-1]) && (i == 1 || !faces[i-1].SameFace(faces[i-2])))
+			{
+				_faceNeighbours[faces[i].tetFace] = faces[i-1].tetFace / 4;
+				_faceNeighbours[faces[i-1].tetFace] = faces[i].tetFace / 4;
+			}
+		}
+	});
+}
+
+void TetraTools::MeshPartitioner::Bisect(	const std::vector<Vec3f>& centroids_,
+											std::vector<unsigned int>& order_,
+											const size_t begin_,
+											const size_t end_,
+											const unsigned int firstPart_,
+											const unsigned int numParts_,
+											const unsigned int depth_)
+{
+	if (numParts_ == 1)
+	{
+		for (size_t i=begin_; i<end_; ++i)
+			_tetraParts[order_[i]] = firstPart_;
+		return;
+	}
+
+	/// cut direction: longest axis of the bounding box, or the principal axis for inertial bisection
+	Vec3f lo(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3f hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i=begin_; i<end_; ++i)
+	{
+		const Vec3f& c = centroids_[order_[i]];
+		lo = Vec3f(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+		hi = Vec3f(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+	}
+	const Vec3f extent = hi - lo;
+	Vec3f direction(1.0f, 0.0f, 0.0f);
+	if (extent.y > extent.x && extent.y >= extent.z)
+		direction = Vec3f(0.0f, 1.0f, 0.0f);
+	else if (extent.z > extent.x && extent.z > extent.y)
+		direction = Vec3f(0.0f, 0.0f, 1.0f);
+	if (_method == PARTITION_INERTIAL_BISECTION)
+		direction = PrincipalAxis(centroids_, order_, begin_, end_, direction);
+
+	/// split at the weighted median, ties broken by index so the result is deterministic
+	const unsigned int numLeft = numParts_ / 2;
+	const size_t split = begin_ + (size_t)((uint64_t)(end_ - begin_) * numLeft / numParts_);
+	std::nth_element(order_.begin() + begin_, order_.begin() + split, order_.begin() + end_, [&](const unsigned int a_, const unsigned int b_)
+	{
+		const float ka = centroids_[a_].dot(direction);
+		const float kb = centroids_[b_].dot(direction);
+		return (ka < kb) || (ka == kb && a_ < b_);
+	});
+
+	/// the upper levels run their halves concurrently
+	if ((1u << depth_) < GetNumThreads() && end_ - begin_ > 65536)
+	{
+		std::thread left([&]() { Bisect(centroids_, order_, begin_, split, firstPart_, numLeft, depth_ + 1); });
+		Bisect(centroids_, order_, split, end_, firstPart_ + numLeft, numParts_ - numLeft, depth_ + 1);
+		left.join();
+	}
+	else
+	{
+		Bisect(centroids_, order_, begin_, split, firstPart_, numLeft, depth_ + 1);
+		Bisect(centroids_, order_, split, end_, firstPart_ + numLeft, numParts_ - numLeft, depth_ + 1);
+	}
+}
+
+void TetraTools::MeshPartitioner::Refine()
+{
+	const size_t numTetras = _tetraParts.size();
+	std::vector<unsigned int> sizes;
+	GetPartSizes(sizes);
+	const double average = (double)numTetras / _numParts;
+	const unsigned int maxSize = std::max((unsigned int)ceil(average * (1.0 + _imbalance)), *std::max_element(sizes.begin(), sizes.end()));
+	const unsigned int minSize = std::min((unsigned int)floor(average * (1.0 - _imbalance)), *std::min_element(sizes.begin(), sizes.end()));
+
+	for (unsigned int pass=0; pass<_numRefinementPasses; ++pass)
+	{
+		size_t numMoved = 0;
+		for (size_t t=0; t<numTetras; ++t)
+		{
+			const unsigned int part = _tetraParts[t];
+			unsigned int candidates[4];
+			unsigned int counts[4];
+			unsigned int numCandidates = 0;
+			unsigned int internal = 0;
+			for (unsigned int j=0; j<4; ++j)
+			{
+				const unsigned int n = _faceNeighbours[4 * t + j];
+				if (n == NoFaceNeighbour)
+					continue;
+				const unsigned int p = _tetraParts[n];
+				if (p == part)
+				{
+					++internal;
+					continue;
+				}
+				unsigned int c = 0;
+				while (c < numCandidates && candidates[c] != p)
+					++c;
+				if (c == numCandidates)
+				{
+					candidates[numCandidates] = p;
+					counts[numCandidates++] = 0;
+				}
+				++counts[c];
+			}
+			/// move to the neighbouring part sharing most faces if that removes cut faces
+			unsigned int best = 0;
+			unsigned int bestCount = 0;
+			for (unsigned int c=0; c<numCandidates; ++c)
+			{
+				if (counts[c] > bestCount && sizes[candidates[c]] < maxSize)
+				{
+					best = candidates[c];
+					bestCount = counts[c];
+				}
+			}
+			if (bestCount > internal && sizes[part] > minSize)
+			{
+				_tetraParts[t] = best;
+				--sizes[part];
+				++sizes[best];
+				++numMoved;
+			}
+		}
+		if (numMoved == 0)
+			break;
+	}
+}
+
+void TetraTools::MeshPartitioner::CountCutFaces()
+{
+	_numCutFaces = 0;
+	for (size_t i=0; i<_faceNeighbours.size(); ++i)
+	{
+		const unsigned int n = _faceNeighbours[i];
+		if (n != NoFaceNeighbour && n > i / 4 && _tetraParts[n] != _tetraParts[i / 4])
+			++_numCutFaces;
+	}
+}
+
+bool TetraTools::MeshPartitioner::Partition(TetrahedronTopology& topology_)
+{
+	const std::vector<Tetrahedron>& tetras = topology_.GetTetrahedra();
+	if (_numParts == 0 || tetras.size() < _numParts)
+	{
+		std::cerr<<"ERROR! Cannot partition "<<tetras.size()<<" tetrahedra into "<<_numParts<<" parts!"<<std::endl;
+		return false;
+	}
+	std::cout<<"Generating "<<_numParts<<" parts ("<<((_method == PARTITION_INERTIAL_BISECTION) ? "inertial" : "coordinate")<<" bisection)..."<<std::endl;
+	const std::vector<Vec3f>& centroids = topology_.GetTetraCentroids();
+	GenerateFaceNeighbours(tetras);
+
+	std::vector<unsigned int> order(tetras.size());
+	for (size_t i=0; i<order.size(); ++i)
+	{
+		order[i] = (unsigned int)i;
+	}
+	_tetraParts.assign(tetras.size(), 0);
+	Bisect(centroids, order, 0, order.size(), 0, _numParts, 0);
+	CountCutFaces();
+	std::cout<<"\tCut faces: "<<_numCutFaces;
+	if (_numRefinementPasses > 0 && _numParts > 1)
+	{
+		Refine();
+		CountCutFaces();
+		std::cout<<" -> "<<_numCutFaces<<" (refined)";
+	}
+	std::cout<<std::endl;
+
+	/// a vertex belongs to the lowest part among its tetrahedra, vertices without tetrahedra to none
+	_vertexOwners.assign(topology_.GetNumVertices(), 0xFFFFFFFFu);
+	for (size_t i=0; i<tetras.size(); ++i)
+	{
+		for (unsigned int j=0; j<4; ++j)
+		{
+			unsigned int& owner = _vertexOwners[tetras[i].index[j]];
+			owner = std::min(owner, _tetraParts[i]);
+		}
+	}
+	return true;
+}
+
+void TetraTools::MeshPartitioner::GetPartSizes(std::vector<unsigned int>& sizes_) const
+{
+	sizes_.assign(_numParts, 0);
+	for (size_t i=0; i<_tetraParts.size(); ++i)
+	{
+		++sizes_[_tetraParts[i]];
+	}
+}
+
+bool TetraTools::MeshPartitioner::ExtractPart(TetrahedronTopology& topology_, const unsigned int part_, MeshPart& meshPart_) const
+{
+	const std::vector<Tetrahedron>& tetras = topology_.GetTetrahedra();
+	if (part_ >= _numParts || _tetraParts.size() != tetras.size())
+	{
+		std::cerr<<"ERROR! Cannot extract part "<<part_<<". Partition the mesh first!"<<std::endl;
+		return false;
+	}
+	const TetrahedronTopology& topology = topology_;
+	const std::vector<Vec3f>& vertices = topology.GetVertices();
+	const std::vector<TetrahedronVertex>& tetrasPerVertex = topology_.GetTetrasPerVertices();
+	const std::vector<PrimitivesPerVertex>& lookup = topology_.GetTetrasPerVertexLookupTable();
+
+	meshPart_.index = part_;
+	meshPart_.tetraGlobalIndices.clear();
+	meshPart_.tetraLayerOffsets.assign(1, 0);
+	for (size_t i=0; i<tetras.size(); ++i)
+	{
+		if (_tetraParts[i] == part_)
+			meshPart_.tetraGlobalIndices.push_back((unsigned int)i);
+	}
+	meshPart_.tetraLayerOffsets.push_back(meshPart_.tetraGlobalIndices.size());
+
+	/// every halo layer holds the tetrahedra sharing a vertex with the previous layer
+	std::vector<unsigned int>& selected = meshPart_.tetraGlobalIndices;
+	std::vector<unsigned int> sortedSelected(selected);
+	std::vector<unsigned int> layer;
+	for (unsigned int l=0; l<_numHaloLayers; ++l)
+	{
+		layer.clear();
+		for (unsigned int k=meshPart_.tetraLayerOffsets[l]; k<meshPart_.tetraLayerOffsets[l+1]; ++k)
+		{
+			const Tetrahedron& t = tetras[selected[k]];
+			for (unsigned int j=0; j<4; ++j)
+			{
+				const PrimitivesPerVertex& range = lookup[t.index[j]];
+				for (PrimitiveOffset n=range.offset; n<range.offset+range.length; ++n)
+					layer.push_back(tetrasPerVertex[n].tetraIndex);
+			}
+		}
+		std::sort(layer.begin(), layer.end());
+		layer.erase(std::unique(layer.begin(), layer.end()), layer.end());
+		const size_t layerBegin = selected.size();
+		std::set_difference(layer.begin(), layer.end(), sortedSelected.begin(), sortedSelected.end(), std::back_inserter(selected));
+		std::vector<unsigned int> merged;
+		merged.reserve(selected.size());
+		std::merge(sortedSelected.begin(), sortedSelected.end(), selected.begin() + layerBegin, selected.end(), std::back_inserter(merged));
+		sortedSelected.swap(merged);
+		meshPart_.tetraLayerOffsets.push_back(selected.size());
+	}
+
+	/// local vertices: owned ones first, ascending global index within both groups
+	std::vector<unsigned int> globals;
+	globals.reserve(4 * selected.size());
+	for (size_t k=0; k<selected.size(); ++k)
+	{
+		const Tetrahedron& t = tetras[selected[k]];
+		globals.insert(globals.end(), t.index, t.index + 4);
+	}
+	std::sort(globals.begin(), globals.end());
+	globals.erase(std::unique(globals.begin(), globals.end()), globals.end());
+	std::vector<unsigned int> localIndex(globals.size());
+	meshPart_.vertexGlobalIndices.clear();
+	meshPart_.vertexGlobalIndices.reserve(globals.size());
+	for (unsigned int pass=0; pass<2; ++pass)
+	{
+		for (size_t k=0; k<globals.size(); ++k)
+		{
+			if ((_vertexOwners[globals[k]] == part_) == (pass == 0))
+			{
+				localIndex[k] = meshPart_.vertexGlobalIndices.size();
+				meshPart_.vertexGlobalIndices.push_back(globals[k]);
+			}
+		}
+		if (pass == 0)
+			meshPart_.numOwnedVertices = meshPart_.vertexGlobalIndices.size();
+	}
+	meshPart_.vertices.resize(globals.size());
+	meshPart_.vertexOwners.resize(globals.size());
+	for (size_t k=0; k<meshPart_.vertexGlobalIndices.size(); ++k)
+	{
+		meshPart_.vertices[k] = vertices[meshPart_.vertexGlobalIndices[k]];
+		meshPart_.vertexOwners[k] = _vertexOwners[meshPart_.vertexGlobalIndices[k]];
+	}
+	meshPart_.tetras.resize(selected.size());
+	meshPart_.tetraOwners.resize(selected.size());
+	for (size_t k=0; k<selected.size(); ++k)
+	{
+		const Tetrahedron& t = tetras[selected[k]];
+		Tetrahedron& local = meshPart_.tetras[k];
+		for (unsigned int j=0; j<4; ++j)
+		{
+			local.index[j] = localIndex[std::lower_bound(globals.begin(), globals.end(), t.index[j]) - globals.begin()];
+		}
+		meshPart_.tetraOwners[k] = _tetraParts[selected[k]];
+	}
+	return true;
+}
+
+bool TetraTools::MeshPartitioner::WritePart(const MeshPart& meshPart_, const std::string& fileName_)
+{
+	TetgenWriter writer;
+	if (!writer.SaveToFile(fileName_, meshPart_.vertices, meshPart_.tetras))
+	{
+		std::cerr<<"ERROR! Cannot write part "<<fileName_<<"!"<<std::endl;
+		return false;
+	}
+	std::ofstream mapFile((fileName_ + std::string(".map")).c_str());
+	if (!mapFile.is_open())
+	{
+		std::cerr<<"ERROR! Cannot write part map "<<fileName_<<".map!"<<std::endl;
+		return false;
+	}
+	/// indices are 1-based like in the .node / .ele files, parts are 0-based
+	mapFile<<"# Part index"<<std::endl;
+	mapFile<<meshPart_.index<<std::endl;
+	mapFile<<"# Vertex count, owned vertex count"<<std::endl;
+	mapFile<<meshPart_.vertices.size()<<" "<<meshPart_.numOwnedVertices<<std::endl;
+	mapFile<<"# Tetra count, halo layer count, first tetra of every layer (layer 0 = owned)"<<std::endl;
+	mapFile<<meshPart_.tetras.size()<<" "<<(meshPart_.tetraLayerOffsets.size() - 2);
+	for (size_t l=0; l+1<meshPart_.tetraLayerOffsets.size(); ++l)
+	{
+		mapFile<<" "<<(meshPart_.tetraLayerOffsets[l] + 1);
+	}
+	mapFile<<std::endl;
+	mapFile<<"# Local vertex index, global vertex index, owner part"<<std::endl;
+	for (size_t i=0; i<meshPart_.vertices.size(); ++i)
+	{
+		mapFile<<(i+1)<<" "<<(meshPart_.vertexGlobalIndices[i]+1)<<" "<<meshPart_.vertexOwners[i]<<"\n";
+	}
+	mapFile<<"# Local tetra index, global tetra index, owner part"<<std::endl;
+	for (size_t i=0; i<meshPart_.tetras.size(); ++i)
+	{
+		mapFile<<(i+1)<<" "<<(meshPart_.tetraGlobalIndices[i]+1)<<" "<<meshPart_.tetraOwners[i]<<"\n";
+	}
+	mapFile<<"# End of map..."<<std::endl;
+	return true;
+}
+
+bool TetraTools::MeshPartitioner::WriteParts(TetrahedronTopology& topology_, const std::string& fileName_) const
+{
+	MeshPart meshPart;
+	for (unsigned int p=0; p<_numParts; ++p)
+	{
+		if (!ExtractPart(topology_, p, meshPart))
+			return false;
+		std::ostringstream partName;
+		partName<<fileName_<<"."<<p;
+		if (!WritePart(meshPart, partName.str()))
+			return false;
+	}
+	return true;
+}
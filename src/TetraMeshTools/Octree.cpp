@@ -6,8 +6,10 @@
  */
 
 #include "Octree.h"
+#include "ParallelUtils.h"
 #include <algorithm>
 #include <limits>
+#include <cmath>
 #ifndef WIN32
 #include <cfloat>
 #include <math.h>
@@ -15,10 +17,132 @@
 #include <float.h>
 #endif
 
-Octree::Octree(const unsigned int maxDepth_, std::vector<Vec3f>* inPoints_, std::vector<Triangle>* inTris_) : _inPoints(inPoints_), _maxDepth(maxDepth_), _inTris(inTris_)
+
+namespace
+{
+	// closest point on triangle a_, b_, c_ to p_ (Ericson, Real-Time Collision Detection 5.1.5)
+	Vec3f closestPointOnTriangle(const Vec3f& p_, const Vec3f& a_, const Vec3f& b_, const Vec3f& c_)
+	{
+		const Vec3f ab = b_ - a_;
+		const Vec3f ac = c_ - a_;
+		const Vec3f ap = p_ - a_;
+		const float d1 = ab.dot(ap);
+		const float d2 = ac.dot(ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a_;
+		const Vec3f bp = p_ - b_;
+		const float d3 = ab.dot(bp);
+		const float d4 = ac.dot(bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return b_;
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a_ + ab * (d1 / (d1 - d3));
+		const Vec3f cp = p_ - c_;
+		const float d5 = ab.dot(cp);
+		const float d6 = ac.dot(cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return c_;
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a_ + ac * (d2 / (d2 - d6));
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b_ + (c_ - b_) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		const float denom = 1.0f / (va + vb + vc);
+		return a_ + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	float squaredDistanceToBox(const Vec3f& p_, const Vec3f& min_, const Vec3f& max_)
+	{
+		float d = 0.0f;
+		for (unsigned int i=0; i<3; ++i)
+		{
+			const float v = p_[i];
+			if (v < min_[i])
+				d += (min_[i] - v) * (min_[i] - v);
+			else if (v > max_[i])
+				d += (v - max_[i]) * (v - max_[i]);
+		}
+		return d;
+	}
+
+	// slab test, returns the parameter interval [tEnter_, tExit_] of the ray inside the box
+	bool rayBoxInterval(const Vec3f& origin_, const Vec3f& direction_, const Vec3f& min_, const Vec3f& max_, float& tEnter_, float& tExit_)
+	{
+		tEnter_ = 0.0f;
+		tExit_ = std::numeric_limits<float>::max();
+		for (unsigned int i=0; i<3; ++i)
+		{
+			if (direction_[i] == 0.0f)
+			{
+				if (origin_[i] < min_[i] || origin_[i] > max_[i])
+					return false;
+				continue;
+			}
+			const float inv = 1.0f / direction_[i];
+			float t0 = (min_[i] - origin_[i]) * inv;
+			float t1 = (max_[i] - origin_[i]) * inv;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			tEnter_ = std::max(tEnter_, t0);
+			tExit_ = std::min(tExit_, t1);
+			if (tEnter_ > tExit_)
+				return false;
+		}
+		return true;
+	}
+
+	// Moeller-Trumbore, both sides, returns the ray parameter in t_
+	bool rayTriangle(const Vec3f& origin_, const Vec3f& direction_, const Vec3f& a_, const Vec3f& b_, const Vec3f& c_, float& t_)
+	{
+		const Vec3f e1 = b_ - a_;
+		const Vec3f e2 = c_ - a_;
+		const Vec3f p = direction_.cross(e2);
+		const float det = e1.dot(p);
+		if (det == 0.0f)
+			return false;
+		const float invDet = 1.0f / det;
+		const Vec3f s = origin_ - a_;
+		const float u = s.dot(p) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+		const Vec3f q = s.cross(e1);
+		const float v = direction_.dot(q) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+		t_ = e2.dot(q) * invDet;
+		return true;
+	}
+
+	// sorts the existing children of node_ by key_ (ascending), returns their number
+	unsigned int sortChildren(const OctreeNode* node_, const float keys_[8], unsigned int order_[8])
+	{
+		unsigned int count = 0;
+		for (unsigned int i=0; i<8; ++i)
+		{
+			if (node_->getChildren()[i] == NULL)
+				continue;
+			unsigned int k = count++;
+			for (; k > 0 && keys_[order_[k-1]] > keys_[i]; --k)
+				order_[k] = order_[k-1];
+			order_[k] = i;
+		}
+		return count;
+	}
+}
+
+Octree::Octree(const unsigned int maxDepth_, std::vector<Vec3f>* inPoints_, std::vector<Triangle>* inTris_) : Octree(OctreeBuildOptions(maxDepth_), inPoints_, inTris_)
+{
+}
+
+Octree::Octree(const OctreeBuildOptions& options_, std::vector<Vec3f>* inPoints_, std::vector<Triangle>* inTris_) : _inPoints(inPoints_), _maxDepth(options_.maxDepth), _inTris(inTris_)
 {
+	_context.points = inPoints_;
+	_context.tris = inTris_;
+	_context.options = options_;
 	generateBoundingCube();
-	_root = new OctreeNode(maxDepth_, inPoints_, _minBC, _maxBC, inTris_);
+	_root = new OctreeNode(&_context, _minBC, _maxBC);
 }
 
 Octree::~Octree()
@@ -31,6 +155,11 @@ Octree::~Octree()
 }
 
 void Octree::generateBoundingCube()
+{
+	computeBoundingCube(*_inPoints, _minBC, _maxBC);
+}
+
+void Octree::computeBoundingCube(const std::vector<Vec3f>& points_, Vec3f& minBC_, Vec3f& maxBC_)
 {
 	std::vector<Vec3f>::const_iterator it;
 	/// generate Bounding Box
@@ -39,7 +168,7 @@ void Octree::generateBoundingCube()
 	b.min = Vec3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
 	b.max = Vec3f(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
 	float dist = 0;
-	for (it=_inPoints->begin(); it!=_inPoints->end(); ++it)
+	for (it=points_.begin(); it!=points_.end(); ++it)
 	{
 		Vec3f v = *it;
 		float pd = v.squaredLength();
@@ -70,9 +199,9 @@ void Octree::generateBoundingCube()
 	//std::cout<<"dx/dy/dz: "<<dx<<"/"<<dy<<"/"<<dz<<"; bc: "<<maxDist<<std::endl;
 	//std::cout<<"\t BBox: "<<b.min<<"; "<<b.max<<std::endl;
 	float maxHalf = maxDist / 2.0f;
-	_minBC = Vec3f(lbc.center.x - maxHalf, lbc.center.y - maxHalf, lbc.center.z - maxHalf);
-	_maxBC = Vec3f(lbc.center.x + maxHalf, lbc.center.y + maxHalf, lbc.center.z + maxHalf);
-	std::cout<<"\tBC: "<<_minBC<<" ; "<<_maxBC<<std::endl;
+	minBC_ = Vec3f(lbc.center.x - maxHalf, lbc.center.y - maxHalf, lbc.center.z - maxHalf);
+	maxBC_ = Vec3f(lbc.center.x + maxHalf, lbc.center.y + maxHalf, lbc.center.z + maxHalf);
+	std::cout<<"\tBC: "<<minBC_<<" ; "<<maxBC_<<std::endl;
 }
 
 OctreeNode* Octree::getRootNode()
@@ -82,4 +211,367 @@ OctreeNode* Octree::getRootNode()
 		return _root;
 	}
 	return NULL;
-}
\ No newline at end of file
+}
+
+unsigned int Octree::balance()
+{
+	std::cout<<"Octree: Balancing ..."<<std::endl;
+	const unsigned int numSplits = _root->balance();
+	std::cout<<"\tsplit "<<numSplits<<" leafs"<<std::endl;
+	return numSplits;
+}
+
+void Octree::closestPointRecursive(const OctreeNode* node_, const Vec3f& point_, OctreeHit& hit_, float& bestSquaredDistance_) const
+{
+	if (!node_->hasChildren())
+	{
+		const std::vector<unsigned int>& triangles = node_->getTriangles();
+		for (unsigned int i=0; i<triangles.size(); ++i)
+		{
+			const Triangle& t = (*_inTris)[triangles[i]];
+			const Vec3f q = closestPointOnTriangle(point_, (*_inPoints)[t.index[0]], (*_inPoints)[t.index[1]], (*_inPoints)[t.index[2]]);
+			const float d = (q - point_).squaredLength();
+			if (d < bestSquaredDistance_ || (d == bestSquaredDistance_ && triangles[i] < hit_.triangle))
+			{
+				bestSquaredDistance_ = d;
+				hit_.point = q;
+				hit_.triangle = triangles[i];
+			}
+		}
+		return;
+	}
+	// visit the nearest children first, so the others can be pruned
+	float keys[8];
+	unsigned int order[8];
+	for (unsigned int i=0; i<8; ++i)
+	{
+		const OctreeNode* child = node_->getChildren()[i];
+		keys[i] = (child != NULL) ? squaredDistanceToBox(point_, child->getMinBC(), child->getMaxBC()) : 0.0f;
+	}
+	const unsigned int numChildren = sortChildren(node_, keys, order);
+	for (unsigned int i=0; i<numChildren; ++i)
+	{
+		if (keys[order[i]] > bestSquaredDistance_)
+			break;
+		closestPointRecursive(node_->getChildren()[order[i]], point_, hit_, bestSquaredDistance_);
+	}
+}
+
+bool Octree::closestPoint(const Vec3f& point_, OctreeHit& hit_, const float maxDistance_) const
+{
+	hit_ = OctreeHit();
+	float bestSquaredDistance = (maxDistance_ < std::sqrt(std::numeric_limits<float>::max())) ? maxDistance_ * maxDistance_ : std::numeric_limits<float>::max();
+	closestPointRecursive(_root, point_, hit_, bestSquaredDistance);
+	if (hit_.triangle == OctreeHit::NoTriangle)
+		return false;
+	hit_.distance = std::sqrt(bestSquaredDistance);
+	return true;
+}
+
+void Octree::closestPoints(const std::vector<Vec3f>& points_, std::vector<OctreeHit>& hits_, const float maxDistance_) const
+{
+	hits_.resize(points_.size());
+	TetraTools::ParallelFor(0, points_.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+			closestPoint(points_[i], hits_[i], maxDistance_);
+	}, 64);
+}
+
+void Octree::rayCastRecursive(const OctreeNode* node_, const Vec3f& origin_, const Vec3f& direction_, OctreeHit& hit_) const
+{
+	if (!node_->hasChildren())
+	{
+		const std::vector<unsigned int>& triangles = node_->getTriangles();
+		for (unsigned int i=0; i<triangles.size(); ++i)
+		{
+			const Triangle& t = (*_inTris)[triangles[i]];
+			float tHit;
+			if (rayTriangle(origin_, direction_, (*_inPoints)[t.index[0]], (*_inPoints)[t.index[1]], (*_inPoints)[t.index[2]], tHit)
+				&& tHit >= 0.0f && (tHit < hit_.distance || (tHit == hit_.distance && triangles[i] < hit_.triangle)))
+			{
+				hit_.distance = tHit;
+				hit_.triangle = triangles[i];
+			}
+		}
+		return;
+	}
+	// visit the children in the order the ray enters them
+	float keys[8];
+	unsigned int order[8];
+	bool entered[8];
+	for (unsigned int i=0; i<8; ++i)
+	{
+		const OctreeNode* child = node_->getChildren()[i];
+		float tExit;
+		entered[i] = (child != NULL) && rayBoxInterval(origin_, direction_, child->getMinBC(), child->getMaxBC(), keys[i], tExit);
+		if (!entered[i])
+			keys[i] = std::numeric_limits<float>::max();
+	}
+	const unsigned int numChildren = sortChildren(node_, keys, order);
+	for (unsigned int i=0; i<numChildren; ++i)
+	{
+		if (!entered[order[i]] || keys[order[i]] > hit_.distance)
+			break;
+		rayCastRecursive(node_->getChildren()[order[i]], origin_, direction_, hit_);
+	}
+}
+
+bool Octree::rayCast(const Vec3f& origin_, const Vec3f& direction_, OctreeHit& hit_, const float maxT_) const
+{
+	hit_ = OctreeHit();
+	hit_.distance = maxT_;
+	float tEnter, tExit;
+	if (rayBoxInterval(origin_, direction_, _minBC, _maxBC, tEnter, tExit) && tEnter <= maxT_)
+		rayCastRecursive(_root, origin_, direction_, hit_);
+	if (hit_.triangle == OctreeHit::NoTriangle)
+	{
+		hit_.distance = std::numeric_limits<float>::max();
+		return false;
+	}
+	hit_.point = origin_ + direction_ * hit_.distance;
+	return true;
+}
+
+void Octree::rayCasts(const std::vector<Vec3f>& origins_, const std::vector<Vec3f>& directions_, std::vector<OctreeHit>& hits_, const float maxT_) const
+{
+	hits_.resize(origins_.size());
+	TetraTools::ParallelFor(0, origins_.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+			rayCast(origins_[i], directions_[i], hits_[i], maxT_);
+	}, 64);
+}
+
+void Octree::rayHitsRecursive(const OctreeNode* node_, const Vec3f& origin_, const Vec3f& direction_, std::vector<unsigned int>& hits_) const
+{
+	float tEnter, tExit;
+	if (!rayBoxInterval(origin_, direction_, node_->getMinBC(), node_->getMaxBC(), tEnter, tExit))
+		return;
+	if (node_->hasChildren())
+	{
+		for (unsigned int i=0; i<8; ++i)
+		{
+			if (node_->getChildren()[i] != NULL)
+				rayHitsRecursive(node_->getChildren()[i], origin_, direction_, hits_);
+		}
+		return;
+	}
+	const std::vector<unsigned int>& triangles = node_->getTriangles();
+	for (unsigned int i=0; i<triangles.size(); ++i)
+	{
+		const Triangle& t = (*_inTris)[triangles[i]];
+		float tHit;
+		if (rayTriangle(origin_, direction_, (*_inPoints)[t.index[0]], (*_inPoints)[t.index[1]], (*_inPoints)[t.index[2]], tHit) && tHit > 0.0f)
+			hits_.push_back(triangles[i]);
+	}
+}
+
+bool Octree::isInside(const Vec3f& point_, std::vector<unsigned int>& hits_) const
+{
+	if (point_.x < _minBC.x || point_.y < _minBC.y || point_.z < _minBC.z
+		|| point_.x > _maxBC.x || point_.y > _maxBC.y || point_.z > _maxBC.z)
+	{
+		return false;
+	}
+	// skewed directions, so the rays are unlikely to run along edges or faces of the mesh
+	static const Vec3f directions[3] = {Vec3f(1.0f, 0.3710f, 0.1270f), Vec3f(-0.2130f, 1.0f, 0.4310f), Vec3f(0.3170f, -0.1930f, -1.0f)};
+	unsigned int votes = 0;
+	for (unsigned int r=0; r<3; ++r)
+	{
+		// a triangle lies in several leafs, count every crossing once
+		hits_.clear();
+		rayHitsRecursive(_root, point_, directions[r], hits_);
+		std::sort(hits_.begin(), hits_.end());
+		const size_t numCrossings = std::unique(hits_.begin(), hits_.end()) - hits_.begin();
+		votes += (unsigned int)(numCrossings & 1);
+	}
+	return votes >= 2;
+}
+
+bool Octree::isInside(const Vec3f& point_) const
+{
+	std::vector<unsigned int> hits;
+	return isInside(point_, hits);
+}
+
+void Octree::isInside(const std::vector<Vec3f>& points_, std::vector<unsigned char>& inside_) const
+{
+	inside_.resize(points_.size());
+	TetraTools::ParallelFor(0, points_.size(), [&](size_t b_, size_t e_)
+	{
+		std::vector<unsigned int> hits;
+		for (size_t i=b_; i<e_; ++i)
+			inside_[i] = isInside(points_[i], hits) ? 1 : 0;
+	}, 64);
+}
+
+
+void Octree::classifyCells()
+{
+	std::cout<<"Octree: Classifying cells ..."<<std::endl;
+	_root->completeChildren();
+	const std::vector<OctreeNode*> leafs = _root->getLeafs(true);
+	const size_t numLeafs = leafs.size();
+	std::vector<std::pair<const OctreeNode*, unsigned int> > leafIndices(numLeafs);
+	for (size_t i=0; i<numLeafs; ++i)
+	{
+		leafIndices[i] = std::make_pair(static_cast<const OctreeNode*>(leafs[i]), (unsigned int)i);
+	}
+	std::sort(leafIndices.begin(), leafIndices.end());
+	auto findLeaf = [&](const OctreeNode* leaf_)
+	{
+		return std::lower_bound(leafIndices.begin(), leafIndices.end(), std::make_pair(leaf_, 0u))->second;
+	};
+
+	// face adjacency between the empty leafs (CSR), counted in a first pass and filled in a second
+	std::vector<unsigned char> onBoundary(numLeafs, 0);
+	std::vector<unsigned int> neighbourOffsets(numLeafs + 1, 0);
+	std::vector<unsigned int> neighbours;
+	for (unsigned int pass=0; pass<2; ++pass)
+	{
+		TetraTools::ParallelFor(0, numLeafs, [&](size_t b_, size_t e_)
+		{
+			std::vector<const OctreeNode*> faceLeafs;
+			for (size_t i=b_; i<e_; ++i)
+			{
+				if (!leafs[i]->getTriangles().empty())
+					continue;
+				unsigned int count = 0;
+				for (unsigned int f=0; f<6; ++f)
+				{
+					const OctreeNode* neighbour = leafs[i]->getFaceNeighbour((OctreeFace)f);
+					if (neighbour == NULL)
+					{
+						onBoundary[i] = 1;
+						continue;
+					}
+					// the leafs of the neighbour on the face towards us
+					faceLeafs.clear();
+					neighbour->getFaceLeafs((OctreeFace)(f ^ 1), faceLeafs);
+					for (size_t k=0; k<faceLeafs.size(); ++k)
+					{
+						if (!faceLeafs[k]->getTriangles().empty())
+							continue;
+						if (pass == 1)
+							neighbours[neighbourOffsets[i] + count] = findLeaf(faceLeafs[k]);
+						++count;
+					}
+				}
+				if (pass == 0)
+					neighbourOffsets[i + 1] = count;
+			}
+		}, 256);
+		if (pass == 0)
+		{
+			for (size_t i=0; i<numLeafs; ++i)
+				neighbourOffsets[i + 1] += neighbourOffsets[i];
+			neighbours.resize(neighbourOffsets[numLeafs]);
+		}
+	}
+
+	// connected components of the empty leafs
+	const unsigned int noComponent = 0xFFFFFFFFu;
+	std::vector<unsigned int> components(numLeafs, noComponent);
+	std::vector<unsigned int> representatives;
+	std::vector<unsigned char> componentOutside;
+	std::vector<unsigned int> queue;
+	for (size_t seed=0; seed<numLeafs; ++seed)
+	{
+		if (components[seed] != noComponent || !leafs[seed]->getTriangles().empty())
+			continue;
+		const unsigned int component = (unsigned int)representatives.size();
+		representatives.push_back((unsigned int)seed);
+		componentOutside.push_back(0);
+		components[seed] = component;
+		queue.assign(1, (unsigned int)seed);
+		for (size_t q=0; q<queue.size(); ++q)
+		{
+			const unsigned int leaf = queue[q];
+			componentOutside[component] |= onBoundary[leaf];
+			for (unsigned int k=neighbourOffsets[leaf]; k<neighbourOffsets[leaf + 1]; ++k)
+			{
+				if (components[neighbours[k]] == noComponent)
+				{
+					components[neighbours[k]] = component;
+					queue.push_back(neighbours[k]);
+				}
+			}
+		}
+	}
+
+	// components that do not reach the boundary are inside or enclosed cavities,
+	// one parity test at the center of their first leaf decides
+	std::vector<unsigned int> ambiguous;
+	for (unsigned int c=0; c<representatives.size(); ++c)
+	{
+		if (!componentOutside[c])
+			ambiguous.push_back(c);
+	}
+	std::vector<unsigned char> componentInside(representatives.size(), 0);
+	TetraTools::ParallelFor(0, ambiguous.size(), [&](size_t b_, size_t e_)
+	{
+		std::vector<unsigned int> hits;
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const OctreeNode* leaf = leafs[representatives[ambiguous[i]]];
+			componentInside[ambiguous[i]] = isInside((leaf->getMinBC() + leaf->getMaxBC()) * 0.5f, hits) ? 1 : 0;
+		}
+	}, 1);
+
+	TetraTools::ParallelFor(0, numLeafs, [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			if (components[i] == noComponent)
+				leafs[i]->setCellLabel(OCTREE_CELL_SURFACE);
+			else
+				leafs[i]->setCellLabel(componentInside[components[i]] ? OCTREE_CELL_INSIDE : OCTREE_CELL_OUTSIDE);
+		}
+	});
+	aggregateCellLabels(_root);
+	std::cout<<"\t"<<numLeafs<<" leafs, "<<representatives.size()<<" empty components, "<<ambiguous.size()<<" parity tests"<<std::endl;
+}
+
+OctreeCellLabel Octree::aggregateCellLabels(OctreeNode* node_)
+{
+	if (!node_->hasChildren())
+		return node_->getCellLabel();
+	OctreeCellLabel label = OCTREE_CELL_UNKNOWN;
+	for (unsigned int k=0; k<8; ++k)
+	{
+		if (node_->getChildren()[k] != NULL)
+			label = std::max(label, aggregateCellLabels(node_->getChildren()[k]));
+	}
+	node_->setCellLabel(label);
+	return label;
+}
+
+void Octree::exportOccupancyGrid(const unsigned int level_, std::vector<unsigned char>& grid_) const
+{
+	const size_t resolution = (size_t)1 << level_;
+	grid_.assign(resolution * resolution * resolution, OCTREE_CELL_UNKNOWN);
+	TetraTools::ParallelFor(0, resolution * resolution, [&](size_t b_, size_t e_)
+	{
+		for (size_t row=b_; row<e_; ++row)
+		{
+			const size_t y = row % resolution;
+			const size_t z = row / resolution;
+			for (size_t x=0; x<resolution; ++x)
+			{
+				// descend along the bits of the cell coordinates until a leaf or the grid level is reached
+				const OctreeNode* node = _root;
+				for (unsigned int d=0; d<level_ && node->hasChildren(); ++d)
+				{
+					const unsigned int bit = level_ - 1 - d;
+					const unsigned int quadrant = (((y >> bit) & 1) ? 0 : 4) + (((z >> bit) & 1) ? 2 : 0) + (unsigned int)((x >> bit) & 1);
+					const OctreeNode* child = node->getChildren()[quadrant];
+					if (child == NULL)
+						break;
+					node = child;
+				}
+				grid_[row * resolution + x] = (unsigned char)node->getCellLabel();
+			}
+		}
+	}, 16);
+}
@@ -7,35 +7,45 @@
 
 #include "OctreeNode.h"
 #include <iostream>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
 #include "SATriangleBoxIntersection.h"
+#include "ParallelUtils.h"
 
-std::vector<Vec3f>* OctreeNode::_points = NULL;
-std::vector<Triangle>* OctreeNode::_tris = NULL;
-unsigned int OctreeNode::_maxDepth = 0;
-
-OctreeNode::OctreeNode(const unsigned int maxDepth_, std::vector<Vec3f>* inPoints_, const Vec3f& minBC_, const Vec3f& maxBC_, std::vector<Triangle>* inTris_) : _minBC(minBC_), _maxBC(maxBC_), _quadrant(-1)
+OctreeNode::OctreeNode(const OctreeContext* context_, const Vec3f& minBC_, const Vec3f& maxBC_) : _context(context_), _minBC(minBC_), _maxBC(maxBC_), _quadrant(-1), _cellLabel(OCTREE_CELL_UNKNOWN)
 {
 	_parent = NULL;
-	OctreeNode::_points = inPoints_;
-	OctreeNode::_tris = inTris_;
-	OctreeNode::_maxDepth = maxDepth_;
 	_depth = 0;
 	_nodes.resize(8);
 	for (unsigned int i=0; i<8; ++i)
 	{
 		_nodes[i] = NULL;
 	}
-	buildNode();
+	// the root cube encloses the whole surface, so every triangle overlaps it
+	_triangles.resize(_context->tris->size());
+	for (unsigned int i=0; i<_triangles.size(); ++i)
+	{
+		_triangles[i] = i;
+	}
+	// the subtrees at the task depth are built in parallel, with about two
+	// subtrees per worker thread to even out unbalanced subtrees
+	unsigned int taskDepth = 0;
+	for (size_t numTasks=1; numTasks < 2 * TetraTools::GetNumThreads(); numTasks*=8)
+	{
+		++taskDepth;
+	}
+	buildSubtree(taskDepth);
 }
 	
-OctreeNode::OctreeNode(const OctreeNode* parent_, const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int depth_, const int quadrant_) : _parent(parent_), _minBC(minBC_), _maxBC(maxBC_), _depth(depth_), _quadrant(quadrant_)
+OctreeNode::OctreeNode(const OctreeNode* parent_, const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int depth_, const int quadrant_, std::vector<unsigned int>& triangles_) : _parent(parent_), _context(parent_->_context), _minBC(minBC_), _maxBC(maxBC_), _depth(depth_), _quadrant(quadrant_), _cellLabel(OCTREE_CELL_UNKNOWN)
 {
+	_triangles.swap(triangles_);
 	_nodes.resize(8);
 	for (unsigned int i=0; i<8; ++i)
 	{
 		_nodes[i] = NULL;
 	}
-	buildNode();
 }
 
 OctreeNode::~OctreeNode()
@@ -76,9 +86,319 @@ const Vec3f& OctreeNode::getMaxBC() const
 	return _maxBC;
 }
 
-void OctreeNode::buildNode()
+const std::vector<unsigned int>& OctreeNode::getTriangles() const
+{
+	return _triangles;
+}
+
+bool OctreeNode::shouldSplit() const
+{
+	const OctreeBuildOptions& options = _context->options;
+	if (_triangles.empty())
+	{
+		return false;
+	}
+	if (options.maxTrianglesPerLeaf > 0 && _triangles.size() <= options.maxTrianglesPerLeaf)
+	{
+		return false;
+	}
+	if (options.minLeafSize > 0.0f && (_maxBC.x - _minBC.x) * 0.5f < options.minLeafSize)
+	{
+		return false;
+	}
+	if (options.maxNormalAngle > 0.0f)
+	{
+		// curvature criterion: the node is flat if all triangle normals are close to the
+		// area weighted mean normal
+		const std::vector<Vec3f>& points = *_context->points;
+		Vec3f meanNormal(0.0f, 0.0f, 0.0f);
+		for (unsigned int i=0; i<_triangles.size(); ++i)
+		{
+			const Triangle& t = (*_context->tris)[_triangles[i]];
+			meanNormal += (points[t.index[1]] - points[t.index[0]]).cross(points[t.index[2]] - points[t.index[0]]);
+		}
+		const float meanLength = meanNormal.length();
+		if (meanLength > 0.0f)
+		{
+			const float minCosine = std::cos(options.maxNormalAngle);
+			bool flat = true;
+			for (unsigned int i=0; i<_triangles.size() && flat; ++i)
+			{
+				const Triangle& t = (*_context->tris)[_triangles[i]];
+				const Vec3f normal = (points[t.index[1]] - points[t.index[0]]).cross(points[t.index[2]] - points[t.index[0]]);
+				const float length = normal.length();
+				// degenerate triangles do not count
+				flat = (length == 0.0f) || normal.dot(meanNormal) >= minCosine * length * meanLength;
+			}
+			if (flat)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void OctreeNode::split()
+{
+	std::vector<unsigned int> childTriangles[8];
+	const std::vector<Vec3f>& points = *_context->points;
+	for (unsigned int i=0; i<_triangles.size(); ++i)
+	{
+		const Triangle& t = (*_context->tris)[_triangles[i]];
+		const Vec3f triPoints[3] = {points[t.index[0]], points[t.index[1]], points[t.index[2]]};
+		const unsigned int overlapMask = getChildOverlapMask(_minBC, _maxBC, triPoints, _context->options.conservativeOverlap);
+		for (unsigned int k=0; k<8; ++k)
+		{
+			if (overlapMask & (1u << k))
+			{
+				childTriangles[k].push_back(_triangles[i]);
+			}
+		}
+	}
+	for (unsigned int k=0; k<8; ++k)
+	{
+		Vec3f childMin, childMax;
+		getChildBounds(_minBC, _maxBC, k, childMin, childMax);
+		_nodes[k] = new OctreeNode(this, childMin, childMax, _depth+1, k, childTriangles[k]);
+	}
+	std::vector<unsigned int>().swap(_triangles);
+}
+
+const OctreeNode* OctreeNode::getFaceNeighbour(const OctreeFace face_) const
+{
+	if (_parent == NULL)
+	{
+		return NULL;
+	}
+	// quadrant bit along the axis of the face: x is bit 0 (set: right), z is bit 1
+	// (set: front), y is bit 2 (cleared: top)
+	const unsigned int axis = face_ / 2;
+	const bool positive = (face_ & 1) != 0;
+	const unsigned int axisBit = (axis == 0) ? 1 : ((axis == 1) ? 4 : 2);
+	const bool onPositiveSide = (axis == 1) ? ((_quadrant & 4) == 0) : ((_quadrant & axisBit) != 0);
+	const unsigned int mirrored = _quadrant ^ axisBit;
+	if (onPositiveSide != positive)
+	{
+		// the neighbour is a sibling
+		return _parent->_nodes[mirrored];
+	}
+	const OctreeNode* parentNeighbour = _parent->getFaceNeighbour(face_);
+	if (parentNeighbour == NULL || !parentNeighbour->hasChildren())
+	{
+		return parentNeighbour;
+	}
+	return parentNeighbour->_nodes[mirrored];
+}
+
+bool OctreeNode::isInSubtreeOf(const OctreeNode* node_) const
+{
+	const OctreeNode* ancestor = this;
+	while (ancestor != NULL && ancestor->_depth > node_->_depth)
+	{
+		ancestor = ancestor->_parent;
+	}
+	return ancestor == node_;
+}
+
+OctreeNode* OctreeNode::getFaceNeighbour(const OctreeFace face_)
+{
+	return const_cast<OctreeNode*>(static_cast<const OctreeNode*>(this)->getFaceNeighbour(face_));
+}
+
+void OctreeNode::getFaceLeafs(const OctreeFace face_, std::vector<const OctreeNode*>& leafs_) const
+{
+	if (!hasChildren())
+	{
+		leafs_.push_back(this);
+		return;
+	}
+	const unsigned int axis = face_ / 2;
+	const bool positive = (face_ & 1) != 0;
+	for (unsigned int k=0; k<8; ++k)
+	{
+		const bool onPositiveSide = (axis == 0) ? ((k & 1) != 0) : ((axis == 1) ? (k < 4) : ((k & 2) != 0));
+		if (onPositiveSide == positive && _nodes[k] != NULL)
+		{
+			_nodes[k]->getFaceLeafs(face_, leafs_);
+		}
+	}
+}
+
+void OctreeNode::completeChildren()
+{
+	if (!hasChildren())
+	{
+		return;
+	}
+	for (unsigned int k=0; k<8; ++k)
+	{
+		if (_nodes[k] == NULL)
+		{
+			Vec3f childMin, childMax;
+			getChildBounds(_minBC, _maxBC, k, childMin, childMax);
+			std::vector<unsigned int> noTriangles;
+			_nodes[k] = new OctreeNode(this, childMin, childMax, _depth+1, k, noTriangles);
+		}
+		_nodes[k]->completeChildren();
+	}
+}
+
+unsigned int OctreeNode::balance()
+{
+	completeChildren();
+	// leafs by depth; the deepest leafs are processed first, a leaf that is
+	// split for them may in turn force coarser neighbours to split
+	std::vector<std::vector<OctreeNode*> > leafs;
+	std::vector<OctreeNode*> allLeafs;
+	collectLeafs(true, allLeafs);
+	for (unsigned int i=0; i<allLeafs.size(); ++i)
+	{
+		const unsigned int depth = allLeafs[i]->getDepth();
+		if (depth >= leafs.size())
+		{
+			leafs.resize(depth + 1);
+		}
+		leafs[depth].push_back(allLeafs[i]);
+	}
+	unsigned int numSplits = 0;
+	for (int depth=(int)leafs.size()-1; depth>(int)_depth+1; --depth)
+	{
+		for (size_t l=0; l<leafs[depth].size(); ++l)
+		{
+			OctreeNode* leaf = leafs[depth][l];
+			for (unsigned int f=0; f<6; ++f)
+			{
+				OctreeNode* neighbour = leaf->getFaceNeighbour((OctreeFace)f);
+				while (neighbour != NULL && !neighbour->hasChildren() && neighbour->getDepth() + 1 < (unsigned int)depth && neighbour->isInSubtreeOf(this))
+				{
+					neighbour->split();
+					++numSplits;
+					for (unsigned int k=0; k<8; ++k)
+					{
+						leafs[neighbour->getDepth() + 1].push_back(neighbour->_nodes[k]);
+					}
+					neighbour = leaf->getFaceNeighbour((OctreeFace)f);
+				}
+			}
+		}
+	}
+	return numSplits;
+}
+
+void OctreeNode::getChildBounds(const Vec3f& minBC_, const Vec3f& maxBC_, const unsigned int quadrant_, Vec3f& childMin_, Vec3f& childMax_)
+{
+	Vec3f center = minBC_ + maxBC_;
+	center /= 2.0f;
+	// quadrants 0-3 are the top (y) half, odd quadrants the right (x) half
+	// and 2, 3, 6, 7 the front (z) half
+	const bool right = (quadrant_ & 1) != 0;
+	const bool top = quadrant_ < 4;
+	const bool front = (quadrant_ & 2) != 0;
+	childMin_ = Vec3f(right ? center.x : minBC_.x, top ? center.y : minBC_.y, front ? center.z : minBC_.z);
+	childMax_ = Vec3f(right ? maxBC_.x : center.x, top ? maxBC_.y : center.y, front ? maxBC_.z : center.z);
+}
+
+unsigned int OctreeNode::getChildOverlapMask(const Vec3f& minBC_, const Vec3f& maxBC_, const Vec3f triPoints_[3], const bool conservative_)
+{
+	Vec3f center = minBC_ + maxBC_;
+	center /= 2.0f;
+	// as we are using a bounding cube, we only need to calculate the length once
+	const float bcQuarterLength = (maxBC_.x - minBC_.x) * 0.25f;
+	// in conservative mode the child boxes are enlarged slightly, so triangles lying
+	// in a shared face are not lost to rounding of the child centers
+	const float testLength = conservative_ ? bcQuarterLength * (1.0f + 1e-5f) : bcQuarterLength;
+	const Vec3f boxQuarterSize(testLength, testLength, testLength);
+	Vec3f childCenters[8];
+	for (unsigned int k=0; k<8; ++k)
+	{
+		childCenters[k] = Vec3f(center.x + ((k & 1) ? bcQuarterLength : -bcQuarterLength),
+								center.y + ((k < 4) ? bcQuarterLength : -bcQuarterLength),
+								center.z + ((k & 2) ? bcQuarterLength : -bcQuarterLength));
+	}
+	// all eight children in one batched SAT test, bit k of the result is quadrant k
+	unsigned int mask = triBoxOverlap8(childCenters, boxQuarterSize, triPoints_);
+	if (mask == 0 && conservative_)
+	{
+		// degenerate or face touching triangles can fail the SAT test for all children
+		// although they passed it for the parent; fall back to their bounding box so
+		// they stay in the tree
+		Vec3f triMin = triPoints_[0], triMax = triPoints_[0];
+		for (unsigned int i=1; i<3; ++i)
+		{
+			triMin.x = std::min(triMin.x, triPoints_[i].x);
+			triMin.y = std::min(triMin.y, triPoints_[i].y);
+			triMin.z = std::min(triMin.z, triPoints_[i].z);
+			triMax.x = std::max(triMax.x, triPoints_[i].x);
+			triMax.y = std::max(triMax.y, triPoints_[i].y);
+			triMax.z = std::max(triMax.z, triPoints_[i].z);
+		}
+		const float tolerance = testLength - bcQuarterLength;
+		for (unsigned int k=0; k<8; ++k)
+		{
+			Vec3f childMin, childMax;
+			getChildBounds(minBC_, maxBC_, k, childMin, childMax);
+			if (triMin.x <= childMax.x + tolerance && triMax.x >= childMin.x - tolerance
+				&& triMin.y <= childMax.y + tolerance && triMax.y >= childMin.y - tolerance
+				&& triMin.z <= childMax.z + tolerance && triMax.z >= childMin.z - tolerance)
+			{
+				mask |= 1u << k;
+			}
+		}
+	}
+	return mask;
+}
+
+void OctreeNode::buildSubtree(const unsigned int taskDepth_)
+{
+	// the nodes above taskDepth_ are split on this thread, only their triangle
+	// classification is spread across the worker threads
+	std::vector<OctreeNode*> subtrees(1, this);
+	while (!subtrees.empty() && subtrees[0]->_depth < taskDepth_)
+	{
+		std::vector<OctreeNode*> nextLevel;
+		for (unsigned int n=0; n<subtrees.size(); ++n)
+		{
+			subtrees[n]->buildNode(true);
+			for (unsigned int i=0; i<8; ++i)
+			{
+				if (subtrees[n]->_nodes[i] != NULL)
+				{
+					nextLevel.push_back(subtrees[n]->_nodes[i]);
+				}
+			}
+		}
+		subtrees.swap(nextLevel);
+	}
+	// the subtrees below are independent and are handed out one at a time to at most
+	// GetNumThreads() workers; the tree does not depend on the order they finish in
+	std::atomic<size_t> nextSubtree(0);
+	TetraTools::ParallelFor(0, std::min<size_t>(TetraTools::GetNumThreads(), subtrees.size()), [&](size_t, size_t)
+	{
+		for (size_t n=nextSubtree++; n<subtrees.size(); n=nextSubtree++)
+		{
+			subtrees[n]->buildSubtreeSerial();
+		}
+	}, 1);
+}
+
+void OctreeNode::buildSubtreeSerial()
+{
+	buildNode(false);
+	for (unsigned int i=0; i<8; ++i)
+	{
+		if (_nodes[i] != NULL)
+		{
+			_nodes[i]->buildSubtreeSerial();
+		}
+	}
+}
+
+void OctreeNode::buildNode(const bool classifyInParallel_)
 {
-	if (_depth < OctreeNode::_maxDepth)
+	// number of triangles classified per parallel work item
+	const size_t triangleChunkSize = 2048;
+	if (_depth < _context->options.maxDepth && shouldSplit())
 	{
 		Vec3f center = _minBC + _maxBC;
 		center /= 2.0f;
@@ -92,7 +412,7 @@ void OctreeNode::buildNode()
 		// Currently useless, but was a nice testing scenario for node generation.
 		// Will be kept as a reminder for myself.
 		/*
-		for (unsigned int i=0; i<_points->size(); ++i)
+		for (unsigned int i=0; i<_context->points->size(); ++i)
 		{
 			// dirty test to avoid iterating over all vertices when all nodes are occupied already...
 			int setCount = 0;
@@ -113,7 +433,7 @@ void OctreeNode::buildNode()
 			pq.back = -1;
 			pq.top = -1;
 			pq.result = -1;
-			Vec3f* p = &(_points->at(i));
+			const Vec3f* p = &(_context->points->at(i));
 			// left
 			if ((p->x <= center.x) && (p->x >=_minBC.x))
 			{
@@ -216,131 +536,77 @@ void OctreeNode::buildNode()
 		*/
 
 		// generate Octree nodes when they are occupied by a triangle
-		// using SAT (separating axis theorem)
-		for (unsigned int i=0; i<OctreeNode::_tris->size(); ++i)
+		// using SAT (separating axis theorem). Only the triangles overlapping this node
+		// can overlap a child, so each child receives the subset of our triangles
+		// that overlap it.
+		std::vector<unsigned int> childTriangles[8];
+		auto classify = [&](const size_t begin_, const size_t end_, std::vector<unsigned int>* lists_)
 		{
-			// dirty test to avoid iterating over all vertices when all nodes are occupied already...
-			int setCount = 0;
-			for (unsigned int k=0; k<8; ++k)
+			for (size_t i=begin_; i<end_; ++i)
 			{
-				if (usedQuadrants[k])
+				const Triangle& t = (*_context->tris)[_triangles[i]];
+				const std::vector<Vec3f>& points = *_context->points;
+				const Vec3f triPoints[3] = {points[t.index[0]], points[t.index[1]], points[t.index[2]]};
+				const unsigned int overlapMask = getChildOverlapMask(_minBC, _maxBC, triPoints, _context->options.conservativeOverlap);
+				for (unsigned int k=0; k<8; ++k)
 				{
-					++setCount;
+					if (overlapMask & (1u << k))
+					{
+						lists_[k].push_back(_triangles[i]);
+					}
 				}
 			}
-			if (setCount == 8)
-			{
-				break;
-			}
-			const Triangle& t = _tris->at(i);
-			const Vec3f& v0 = OctreeNode::_points->at(t.index[0]);
-			const Vec3f& v1 = OctreeNode::_points->at(t.index[1]);
-			const Vec3f& v2 = OctreeNode::_points->at(t.index[2]);
-			const Vec3f triPoints[3] = {v0, v1, v2};
-			// as we are using a bounding cube, we only need to calculate the length once
-			const float bcHalfLength = (_maxBC.x - _minBC.x) * 0.5f;
-			const float bcQuarterLength = bcHalfLength * 0.5f;
-			const Vec3f boxCenter(_minBC.x + bcHalfLength, _minBC.y + bcHalfLength, _minBC.z + bcHalfLength);
-			const Vec3f boxQuarterSize(bcQuarterLength, bcQuarterLength, bcQuarterLength);
-
-			// check for sub-cube #0 (top, left, back)
-			Vec3f currentBoxCenter(center.x - bcQuarterLength, center.y + bcQuarterLength, center.z - bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
-			{
-				usedQuadrants[0] = true;
-			}
-
-			// check for sub-cube #1 (top, right, back)
-			currentBoxCenter = Vec3f(center.x + bcQuarterLength, center.y + bcQuarterLength, center.z - bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
-			{
-				usedQuadrants[1] = true;
-			}
-
-			// check for sub-cube #2 (top, left, front)
-			currentBoxCenter = Vec3f(center.x - bcQuarterLength, center.y + bcQuarterLength, center.z + bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
-			{
-				usedQuadrants[2] = true;
-			}
-
-			// check for sub-cube #3 (top, right, front)
-			currentBoxCenter = Vec3f(center.x + bcQuarterLength, center.y + bcQuarterLength, center.z + bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
-			{
-				usedQuadrants[3] = true;
-			}
-
-			// check for sub-cube #4 (bottom, left, back)
-			currentBoxCenter = Vec3f(center.x - bcQuarterLength, center.y - bcQuarterLength, center.z - bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
-			{
-				usedQuadrants[4] = true;
-			}
-
-			// check for sub-cube #5 (bottom, right, back)
-			currentBoxCenter = Vec3f(center.x + bcQuarterLength, center.y - bcQuarterLength, center.z - bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
-			{
-				usedQuadrants[5] = true;
-			}
-
-			// check for sub-cube #6 (bottom, left, front)
-			currentBoxCenter = Vec3f(center.x - bcQuarterLength, center.y - bcQuarterLength, center.z + bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
+		};
+		if (classifyInParallel_ && _triangles.size() >= 2 * triangleChunkSize)
+		{
+			// classify fixed chunks of triangles in parallel and concatenate the chunk
+			// lists in order, so the child lists are the same as in the serial loop
+			const size_t numChunks = (_triangles.size() + triangleChunkSize - 1) / triangleChunkSize;
+			std::vector<std::vector<unsigned int> > chunkTriangles(numChunks * 8);
+			TetraTools::ParallelFor(0, numChunks, [&](size_t b_, size_t e_)
 			{
-				usedQuadrants[6] = true;
-			}
-
-			// check for sub-cube #7 (bottom, right, front)
-			currentBoxCenter = Vec3f(center.x + bcQuarterLength, center.y - bcQuarterLength, center.z + bcQuarterLength);
-			if (triBoxOverlap(currentBoxCenter, boxQuarterSize, triPoints) == 1)
+				for (size_t c=b_; c<e_; ++c)
+				{
+					classify(c * triangleChunkSize, std::min(_triangles.size(), (c + 1) * triangleChunkSize), &chunkTriangles[c * 8]);
+				}
+			}, 1);
+			for (unsigned int k=0; k<8; ++k)
 			{
-				usedQuadrants[7] = true;
+				size_t count = 0;
+				for (size_t c=0; c<numChunks; ++c)
+				{
+					count += chunkTriangles[c * 8 + k].size();
+				}
+				childTriangles[k].reserve(count);
+				for (size_t c=0; c<numChunks; ++c)
+				{
+					childTriangles[k].insert(childTriangles[k].end(), chunkTriangles[c * 8 + k].begin(), chunkTriangles[c * 8 + k].end());
+				}
 			}
 		}
-		// Add the 8 nodes to our child list.
-		// Ignore the qudrant if empty i.e. if it has no points
-		if (usedQuadrants[0])
-		{
-			OctreeNode* on0 = new OctreeNode(this, Vec3f(_minBC.x, center.y, _minBC.z), Vec3f(center.x, _maxBC.y, center.z), _depth+1, 0);
-			_nodes[0] = on0;
-		}
-		if (usedQuadrants[1])
-		{
-			OctreeNode* on1 = new OctreeNode(this, Vec3f(center.x, center.y, _minBC.z), Vec3f(_maxBC.x, _maxBC.y, center.z), _depth+1, 1);
-			_nodes[1] = on1;
-		}
-		if (usedQuadrants[2])
-		{
-			OctreeNode* on2 = new OctreeNode(this, Vec3f(_minBC.x, center.y, center.z), Vec3f(center.x, _maxBC.y, _maxBC.z), _depth+1, 2);
-			_nodes[2] = on2;
-		}
-		if (usedQuadrants[3])
+		else
 		{
-			OctreeNode* on3 = new OctreeNode(this, Vec3f(center.x, center.y, center.z), Vec3f(_maxBC.x, _maxBC.y, _maxBC.z), _depth+1, 3);
-			_nodes[3] = on3;
+			classify(0, _triangles.size(), childTriangles);
 		}
-		// lower quadrants
-		if (usedQuadrants[4])
+		for (unsigned int k=0; k<8; ++k)
 		{
-			OctreeNode* on4 = new OctreeNode(this, Vec3f(_minBC.x, _minBC.y, _minBC.z), Vec3f(center.x, center.y, center.z), _depth+1, 4);
-			_nodes[4] = on4;
+			usedQuadrants[k] = _context->options.completeChildren || !childTriangles[k].empty();
 		}
-		if (usedQuadrants[5])
-		{
-			OctreeNode* on5 = new OctreeNode(this, Vec3f(center.x, _minBC.y, _minBC.z), Vec3f(_maxBC.x, center.y, center.z), _depth+1, 5);
-			_nodes[5] = on5;
-		}
-		if (usedQuadrants[6])
+		// Add the 8 nodes to our child list.
+		// Ignore the qudrant if empty i.e. if it has no points
+		for (unsigned int k=0; k<8; ++k)
 		{
-			OctreeNode* on6 = new OctreeNode(this, Vec3f(_minBC.x, _minBC.y, center.z), Vec3f(center.x, center.y, _maxBC.z), _depth+1, 6);
-			_nodes[6] = on6;
+			if (usedQuadrants[k])
+			{
+				Vec3f childMin, childMax;
+				getChildBounds(_minBC, _maxBC, k, childMin, childMax);
+				_nodes[k] = new OctreeNode(this, childMin, childMax, _depth+1, k, childTriangles[k]);
+			}
 		}
-		if (usedQuadrants[7])
+		// only the leafs keep their triangle lists
+		if (hasChildren())
 		{
-			OctreeNode* on7 = new OctreeNode(this, Vec3f(center.x, _minBC.y, center.z), Vec3f(_maxBC.x, center.y, _maxBC.z), _depth+1, 7);
-			_nodes[7] = on7;
+			std::vector<unsigned int>().swap(_triangles);
 		}
 	}
 }
@@ -360,28 +626,28 @@ const bool OctreeNode::hasChildren() const
 const std::vector<OctreeNode*>& OctreeNode::getLeafs(const bool leafsOnly_)
 {
 	_tmpChildren.clear();
+	collectLeafs(leafsOnly_, _tmpChildren);
+	return _tmpChildren;
+}
+
+void OctreeNode::collectLeafs(const bool leafsOnly_, std::vector<OctreeNode*>& leafs_)
+{
 	if (this->hasChildren())
 	{
 		for (unsigned int i=0; i<_nodes.size(); ++i)
 		{
 			if (_nodes[i] != NULL)
 			{
-				const std::vector<OctreeNode*>& childLeafs = _nodes[i]->getLeafs(leafsOnly_);
-				if (!childLeafs.empty())
-				{
-					_tmpChildren.insert(_tmpChildren.end(), childLeafs.begin(), childLeafs.end());
-				}
+				_nodes[i]->collectLeafs(leafsOnly_, leafs_);
 			}
 		}
 		if (!leafsOnly_)
 		{
-			_tmpChildren.push_back(this);
+			leafs_.push_back(this);
 		}
-		return _tmpChildren;
 	}
 	else
 	{
-		_tmpChildren.push_back(this);
-		return _tmpChildren;
+		leafs_.push_back(this);
 	}
 }
@@ -0,0 +1,358 @@
+/*
+ * OutOfCoreTopology.cpp
+ *
+ * Streaming construction of topology arrays in memory-mapped files.
+ */
+
+#include "OutOfCoreTopology.h"
+#include "ExternalSort.h"
+#include "GeometryConversion.h"
+#include "ParallelUtils.h"
+#include <fstream>
+#include <algorithm>
+
+namespace
+{
+	/**
+	 * A tetrahedron face, rotated so that v[0] is the smallest index while keeping
+	 * the orientation it has in the tetrahedron.
+	 */
+	struct FaceRecord
+	{
+		unsigned int v[3];
+		unsigned int tetra;
+		unsigned int faceInTetra;
+	};
+
+	/// orders faces by their vertex set (orientation ignored), then by tetrahedron
+	struct FaceRecordLess
+	{
+		bool operator()(const FaceRecord& a_, const FaceRecord& b_) const
+		{
+			if (a_.v[0] != b_.v[0])
+				return a_.v[0] < b_.v[0];
+			const unsigned int a1 = std::min(a_.v[1], a_.v[2]);
+			const unsigned int b1 = std::min(b_.v[1], b_.v[2]);
+			if (a1 != b1)
+				return a1 < b1;
+			const unsigned int a2 = std::max(a_.v[1], a_.v[2]);
+			const unsigned int b2 = std::max(b_.v[1], b_.v[2]);
+			if (a2 != b2)
+				return a2 < b2;
+			if (a_.tetra != b_.tetra)
+				return a_.tetra < b_.tetra;
+			return a_.faceInTetra < b_.faceInTetra;
+		}
+	};
+
+	inline bool SameFace(const FaceRecord& a_, const FaceRecord& b_)
+	{
+		return a_.v[0] == b_.v[0] && std::min(a_.v[1], a_.v[2]) == std::min(b_.v[1], b_.v[2]) && std::max(a_.v[1], a_.v[2]) == std::max(b_.v[1], b_.v[2]);
+	}
+
+	/**
+	 * Same face orientation and rotation as TetrahedronTopology::GenerateTriangles.
+	 */
+	inline void MakeFaceRecord(const Tetrahedron& t_, const unsigned int tetra_, const unsigned int f_, FaceRecord& face_)
+	{
+		unsigned int* v = face_.v;
+		v[0] = t_.index[(f_+1)%4];
+		if (f_%2)
+		{
+			v[1] = t_.index[(f_+2)%4];
+			v[2] = t_.index[(f_+3)%4];
+		}
+		else
+		{
+			v[2] = t_.index[(f_+2)%4];
+			v[1] = t_.index[(f_+3)%4];
+		}
+		while ((v[0]>v[1]) || (v[0]>v[2]))
+		{
+			const unsigned int val = v[0];
+			v[0] = v[1];
+			v[1] = v[2];
+			v[2] = val;
+		}
+		face_.tetra = tetra_;
+		face_.faceInTetra = f_;
+	}
+
+	/**
+	 * Consumes the sorted faces: every group of equal faces becomes one triangle,
+	 * groups of one face are surface triangles.
+	 */
+	struct FaceGroupWriter
+	{
+		std::ofstream&								triangles;
+		std::ofstream&								surfaceTriangles;
+		TetraTools::MappedArray<TetraTools::TetrahedronTriangles>&	tetraTriangles;
+		std::vector<FaceRecord>						group;
+		unsigned int								numTriangles;
+		unsigned int								numSurfaceTriangles;
+
+		FaceGroupWriter(std::ofstream& triangles_, std::ofstream& surfaceTriangles_, TetraTools::MappedArray<TetraTools::TetrahedronTriangles>& tetraTriangles_)
+			: triangles(triangles_), surfaceTriangles(surfaceTriangles_), tetraTriangles(tetraTriangles_), numTriangles(0), numSurfaceTriangles(0)
+		{
+		}
+
+		void operator()(const FaceRecord& face_)
+		{
+			if (!group.empty() && !SameFace(group[0], face_))
+				Flush();
+			group.push_back(face_);
+		}
+
+		void Flush()
+		{
+			if (group.empty())
+				return;
+			const FaceRecord& first = group[0];
+			Triangle tr;
+			tr.index[0] = first.v[0];
+			tr.index[1] = first.v[2];
+			tr.index[2] = first.v[1];
+			triangles.write(reinterpret_cast<const char*>(&tr), sizeof(Triangle));
+			if (group.size() == 1)
+			{
+				surfaceTriangles.write(reinterpret_cast<const char*>(&tr), sizeof(Triangle));
+				++numSurfaceTriangles;
+			}
+			for (size_t i=0; i<group.size(); ++i)
+			{
+				tetraTriangles[group[i].tetra].index[group[i].faceInTetra] = numTriangles;
+			}
+			++numTriangles;
+			group.clear();
+		}
+	};
+
+	struct IncidenceRecord
+	{
+		unsigned int vertex;
+		unsigned int tetra;
+		unsigned int indexInTetra;
+	};
+
+	struct IncidenceRecordLess
+	{
+		bool operator()(const IncidenceRecord& a_, const IncidenceRecord& b_) const
+		{
+			if (a_.vertex != b_.vertex)
+				return a_.vertex < b_.vertex;
+			if (a_.tetra != b_.tetra)
+				return a_.tetra < b_.tetra;
+			return a_.indexInTetra < b_.indexInTetra;
+		}
+	};
+
+	/**
+	 * Consumes the sorted incidences and writes the tetrahedra-per-vertex list front to back.
+	 */
+	struct IncidenceWriter
+	{
+		TetraTools::MappedArray<TetraTools::TetrahedronVertex>&		tetraVertices;
+		TetraTools::MappedArray<TetraTools::PrimitivesPerVertex>&	lookup;
+		TetraTools::PrimitiveOffset									cursor;
+
+		IncidenceWriter(TetraTools::MappedArray<TetraTools::TetrahedronVertex>& tetraVertices_, TetraTools::MappedArray<TetraTools::PrimitivesPerVertex>& lookup_)
+			: tetraVertices(tetraVertices_), lookup(lookup_), cursor(0)
+		{
+		}
+
+		void operator()(const IncidenceRecord& incidence_)
+		{
+			TetraTools::TetrahedronVertex& tv = tetraVertices[cursor++];
+			tv.tetraIndex = incidence_.tetra;
+			tv.indexInTetra = incidence_.indexInTetra;
+			++lookup[incidence_.vertex].length;
+		}
+	};
+
+	bool FileExists(const std::string& fileName_)
+	{
+		std::ifstream file(fileName_.c_str());
+		return file.good();
+	}
+}
+
+TetraTools::OutOfCoreTopology::OutOfCoreTopology(const std::string& directory_, const size_t memoryBudget_)
+	: _directory(directory_), _memoryBudget(memoryBudget_)
+{
+}
+
+TetraTools::OutOfCoreTopology::~OutOfCoreTopology()
+{
+	Close();
+}
+
+std::string TetraTools::OutOfCoreTopology::GetFileName(const char* name_) const
+{
+	if (_directory.empty())
+		return std::string(name_);
+	const char last = _directory[_directory.size() - 1];
+	return (last == '/' || last == '\\') ? _directory + name_ : _directory + "/" + name_;
+}
+
+size_t TetraTools::OutOfCoreTopology::GetChunkSize(const size_t recordSize_) const
+{
+	/// ParallelSort merges through a buffer of the same size
+	return std::max((size_t)1024, _memoryBudget / (2 * recordSize_));
+}
+
+bool TetraTools::OutOfCoreTopology::Create(const size_t numVertices_, const size_t numTetras_)
+{
+	Close();
+	return _vertices.Create(GetFileName("vertices.bin"), numVertices_) && _tetrahedra.Create(GetFileName("tetrahedra.bin"), numTetras_);
+}
+
+bool TetraTools::OutOfCoreTopology::Create(TetrahedronTopology& topology_)
+{
+	const TetrahedronTopology& topology = topology_;
+	const std::vector<Vec3f>& vertices = topology.GetVertices();
+	const std::vector<Tetrahedron>& tetras = topology_.GetTetrahedra();
+	if (!Create(vertices.size(), tetras.size()))
+		return false;
+	if (!vertices.empty())
+		CopyPrimitives(&vertices[0], vertices.size(), _vertices.data());
+	if (!tetras.empty())
+		CopyPrimitives(&tetras[0], tetras.size(), _tetrahedra.data());
+	return true;
+}
+
+bool TetraTools::OutOfCoreTopology::Open()
+{
+	Close();
+	if (!_vertices.Open(GetFileName("vertices.bin"), true) || !_tetrahedra.Open(GetFileName("tetrahedra.bin"), true))
+		return false;
+	if (FileExists(GetFileName("triangles.bin")))
+	{
+		_triangles.Open(GetFileName("triangles.bin"), false);
+		_surfaceTriangles.Open(GetFileName("surface_triangles.bin"), false);
+		_tetraTriangles.Open(GetFileName("tetra_triangles.bin"), false);
+	}
+	if (FileExists(GetFileName("tetra_vertices.bin")))
+	{
+		_tetraVertices.Open(GetFileName("tetra_vertices.bin"), false);
+		_vertexTetrahedraLookup.Open(GetFileName("tetra_lookup.bin"), false);
+	}
+	return true;
+}
+
+void TetraTools::OutOfCoreTopology::Close()
+{
+	_vertices.Close();
+	_tetrahedra.Close();
+	_triangles.Close();
+	_surfaceTriangles.Close();
+	_tetraTriangles.Close();
+	_tetraVertices.Close();
+	_vertexTetrahedraLookup.Close();
+}
+
+bool TetraTools::OutOfCoreTopology::GenerateTriangles()
+{
+	std::cout<<"Generating Triangles from Tetrahedra (out of core)..."<<std::endl;
+	_triangles.Close();
+	_surfaceTriangles.Close();
+	_tetraTriangles.Close();
+	const size_t numTetras = _tetrahedra.size();
+	if (!_tetraTriangles.Create(GetFileName("tetra_triangles.bin"), numTetras))
+		return false;
+
+	/// sorted runs of the faces of chunkTetras tetrahedra each
+	ExternalSorter<FaceRecord, FaceRecordLess> sorter(GetFileName("faces.runs"), FaceRecordLess());
+	const size_t chunkTetras = std::max((size_t)1, GetChunkSize(sizeof(FaceRecord)) / 4);
+	std::vector<FaceRecord> chunk;
+	const Tetrahedron* tetras = _tetrahedra.data();
+	for (size_t first=0; first<numTetras; first+=chunkTetras)
+	{
+		const size_t last = std::min(numTetras, first + chunkTetras);
+		chunk.resize(4 * (last - first));
+		ParallelFor(first, last, [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				for (unsigned int f=0; f<4; ++f)
+					MakeFaceRecord(tetras[i], (unsigned int)i, f, chunk[4 * (i - first) + f]);
+			}
+		});
+		if (!sorter.AddRun(chunk))
+			return false;
+	}
+	std::vector<FaceRecord>().swap(chunk);
+	std::cout<<"\tSorted "<<sorter.GetNumRecords()<<" faces in "<<sorter.GetNumRuns()<<" runs"<<std::endl;
+
+	std::ofstream triangles(GetFileName("triangles.bin").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	std::ofstream surfaceTriangles(GetFileName("surface_triangles.bin").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!triangles.is_open() || !surfaceTriangles.is_open())
+	{
+		std::cerr<<"ERROR! Cannot write triangle files to "<<_directory<<"!"<<std::endl;
+		return false;
+	}
+	FaceGroupWriter writer(triangles, surfaceTriangles, _tetraTriangles);
+	if (!sorter.Merge(writer))
+		return false;
+	writer.Flush();
+	triangles.close();
+	surfaceTriangles.close();
+	std::cout<<"\tNum triangles: "<<writer.numTriangles<<", surface triangles: "<<writer.numSurfaceTriangles<<std::endl;
+	return _triangles.Open(GetFileName("triangles.bin"), false) && _surfaceTriangles.Open(GetFileName("surface_triangles.bin"), false);
+}
+
+bool TetraTools::OutOfCoreTopology::GenerateTetrahedronMap()
+{
+	std::cout<<"Generating TetraMap (out of core)..."<<std::endl;
+	_tetraVertices.Close();
+	_vertexTetrahedraLookup.Close();
+	const size_t numVerts = _vertices.size();
+	const size_t numTetras = _tetrahedra.size();
+	if (!_tetraVertices.Create(GetFileName("tetra_vertices.bin"), 4 * numTetras) || !_vertexTetrahedraLookup.Create(GetFileName("tetra_lookup.bin"), numVerts))
+		return false;
+
+	ExternalSorter<IncidenceRecord, IncidenceRecordLess> sorter(GetFileName("tetra_map.runs"), IncidenceRecordLess());
+	const size_t chunkTetras = std::max((size_t)1, GetChunkSize(sizeof(IncidenceRecord)) / 4);
+	std::vector<IncidenceRecord> chunk;
+	const Tetrahedron* tetras = _tetrahedra.data();
+	for (size_t first=0; first<numTetras; first+=chunkTetras)
+	{
+		const size_t last = std::min(numTetras, first + chunkTetras);
+		chunk.resize(4 * (last - first));
+		ParallelFor(first, last, [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				for (unsigned int j=0; j<4; ++j)
+				{
+					IncidenceRecord& r = chunk[4 * (i - first) + j];
+					r.vertex = tetras[i].index[j];
+					r.tetra = (unsigned int)i;
+					r.indexInTetra = j;
+				}
+			}
+		});
+		if (!sorter.AddRun(chunk))
+			return false;
+	}
+	std::vector<IncidenceRecord>().swap(chunk);
+
+	PrimitivesPerVertex* lookup = _vertexTetrahedraLookup.data();
+	for (size_t i=0; i<numVerts; ++i)
+	{
+		lookup[i].offset = 0;
+		lookup[i].length = 0;
+	}
+	IncidenceWriter writer(_tetraVertices, _vertexTetrahedraLookup);
+	if (!sorter.Merge(writer))
+		return false;
+	PrimitiveOffset offset = 0;
+	unsigned int maxTetras = 0;
+	for (size_t i=0; i<numVerts; ++i)
+	{
+		lookup[i].offset = offset;
+		offset += lookup[i].length;
+		maxTetras = std::max(maxTetras, lookup[i].length);
+	}
+	std::cout<<"\tMax number of tetrahedra connected to a vertex: "<<maxTetras<<std::endl;
+	return true;
+}
@@ -6,9 +6,7 @@
  */
 
 #include "SATriangleBoxIntersection.h"
-
-Vec3f v0, v1, v2, boxhalfsize;
-float min, max, p0, p1, p2, rad, fex, fey, fez;
+#include "SimdFloat4.h"
 
 void findMinMax(float x0, float x1, float x2, float& min_, float& max_)
 {
@@ -43,10 +41,11 @@ int planeBoxOverlap(const Vec3f& normal, const Vec3f& vert, const Vec3f& maxbox)
 	return 0;
 }
 
-int axisTest_x01(const float a, const float b, const float fa, const float fb)
+int axisTest_x01(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v2_, const Vec3f& boxhalfsize_)
 {
-	float p0 = a * v0[1] - b * v0[2];
-	float p2 = a * v2[1] - b * v2[2];
+	float p0 = a * v0_[1] - b * v0_[2];
+	float p2 = a * v2_[1] - b * v2_[2];
+	float min, max;
 	if(p0 < p2) 
 	{
 		min = p0; 
@@ -57,17 +56,18 @@ int axisTest_x01(const float a, const float b, const float fa, const float fb)
 		min = p2; 
 		max = p0;
 	}
-	float rad = fa * boxhalfsize[1] + fb * boxhalfsize[2];
+	float rad = fa * boxhalfsize_[1] + fb * boxhalfsize_[2];
 	if(min > rad || max < -rad) 
 		return 0;
 	else
 		return -1;
 }
 
-int axisTest_x2(const float a, const float b, const float fa, const float fb)
+int axisTest_x2(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v1_, const Vec3f& boxhalfsize_)
 {
-	float p0 = a * v0[1] - b * v0[2];
-	float p1 = a * v1[1] - b * v1[2];
+	float p0 = a * v0_[1] - b * v0_[2];
+	float p1 = a * v1_[1] - b * v1_[2];
+	float min, max;
 	if(p0 < p1) 
 	{
 		min = p0; 
@@ -78,17 +78,18 @@ int axisTest_x2(const float a, const float b, const float fa, const float fb)
 		min = p1; 
 		max=p0;
 	}
-	float rad = fa * boxhalfsize[1] + fb * boxhalfsize[2];
+	float rad = fa * boxhalfsize_[1] + fb * boxhalfsize_[2];
 	if(min > rad || max < -rad) 
 		return 0;
 	else
 		return -1;
 }
 
-int axisTest_y02(const float a, const float b, const float fa, const float fb)
+int axisTest_y02(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v2_, const Vec3f& boxhalfsize_)
 {
-	float p0 = -a * v0[0] + b * v0[2];
-	float p2 = -a * v2[0] + b * v2[2];
+	float p0 = -a * v0_[0] + b * v0_[2];
+	float p2 = -a * v2_[0] + b * v2_[2];
+	float min, max;
 	if(p0 < p2) 
 	{
 		min = p0; 
@@ -99,17 +100,18 @@ int axisTest_y02(const float a, const float b, const float fa, const float fb)
 		min = p2; 
 		max = p0;
 	}
-	float rad = fa * boxhalfsize[0] + fb * boxhalfsize[2];
+	float rad = fa * boxhalfsize_[0] + fb * boxhalfsize_[2];
 	if(min > rad || max < -rad) 
 		return 0;
 	else
 		return -1;
 }
 
-int axisTest_y1(const float a, const float b, const float fa, const float fb)
+int axisTest_y1(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v1_, const Vec3f& boxhalfsize_)
 {
-	float p0 = -a * v0[0] + b * v0[2];
-	float p1 = -a * v1[0] + b * v1[2];
+	float p0 = -a * v0_[0] + b * v0_[2];
+	float p1 = -a * v1_[0] + b * v1_[2];
+	float min, max;
 	if(p0 < p1) 
 	{
 		min = p0; 
@@ -120,17 +122,18 @@ int axisTest_y1(const float a, const float b, const float fa, const float fb)
 		min = p1; 
 		max = p0;
 	}
-	float rad = fa * boxhalfsize[0] + fb * boxhalfsize[2];
+	float rad = fa * boxhalfsize_[0] + fb * boxhalfsize_[2];
 	if(min > rad || max < -rad) 
 		return 0;
 	else
 		return -1;
 }
 
-int axisTest_z12(const float a, const float b, const float fa, const float fb)
+int axisTest_z12(const float a, const float b, const float fa, const float fb, const Vec3f& v1_, const Vec3f& v2_, const Vec3f& boxhalfsize_)
 {
-	float p1 = a * v1[0] - b * v1[1];
-	float p2 = a * v2[0] - b * v2[1];
+	float p1 = a * v1_[0] - b * v1_[1];
+	float p2 = a * v2_[0] - b * v2_[1];
+	float min, max;
 	if(p2 < p1) 
 	{
 		min = p2; 
@@ -141,7 +144,7 @@ int axisTest_z12(const float a, const float b, const float fa, const float fb)
 		min = p1; 
 		max = p2;
 	}
-	float rad = fa * boxhalfsize[0] + fb * boxhalfsize[1];
+	float rad = fa * boxhalfsize_[0] + fb * boxhalfsize_[1];
 	if(min > rad || max < -rad) 
 	{
 		return 0;
@@ -150,10 +153,11 @@ int axisTest_z12(const float a, const float b, const float fa, const float fb)
 		return -1;
 }
 
-int axisTest_z0(const float a, const float b, const float fa, const float fb)
+int axisTest_z0(const float a, const float b, const float fa, const float fb, const Vec3f& v0_, const Vec3f& v1_, const Vec3f& boxhalfsize_)
 {
-	float p0 = a * v0[0] - b * v0[1];
-	float p1 = a * v1[0] - b * v1[1];
+	float p0 = a * v0_[0] - b * v0_[1];
+	float p1 = a * v1_[0] - b * v1_[1];
+	float min, max;
 	if(p0 < p1) 
 	{
 		min = p0; 
@@ -164,7 +168,7 @@ int axisTest_z0(const float a, const float b, const float fa, const float fb)
 		min = p1; 
 		max = p0;
 	}
-	float rad = fa * boxhalfsize[0] + fb * boxhalfsize[1];
+	float rad = fa * boxhalfsize_[0] + fb * boxhalfsize_[1];
 	if(min > rad || max < -rad) 
 		return 0;
 	else
@@ -173,8 +177,9 @@ int axisTest_z0(const float a, const float b, const float fa, const float fb)
 
 int triBoxOverlap(const Vec3f& boxcenter, const Vec3f& boxhalfsize_, const Vec3f triverts[3])
 {
-	boxhalfsize = boxhalfsize_;
-	Vec3f normal, e0, e1 , e2;
+	// all state is local, so the test can run concurrently on several threads
+	Vec3f v0, v1, v2, normal, e0, e1 , e2;
+	float min, max, fex, fey, fez;
 	/* This is the fastest branch on Sun */
 	/* move everything so that the boxcenter is in (0,0,0) */
 	v0 = triverts[0] - boxcenter;
@@ -195,19 +200,19 @@ int triBoxOverlap(const Vec3f& boxcenter, const Vec3f& boxhalfsize_, const Vec3f
 	fez = fabsf(e0[2]);
 
 	int result = -1;
-	result = axisTest_x01(e0[2], e0[1], fez, fey);
+	result = axisTest_x01(e0[2], e0[1], fez, fey, v0, v2, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
 	}
 
-	result = axisTest_y02(e0[2], e0[0], fez, fex);
+	result = axisTest_y02(e0[2], e0[0], fez, fex, v0, v2, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
 	}
 
-	result = axisTest_z12(e0[1], e0[0], fey, fex);
+	result = axisTest_z12(e0[1], e0[0], fey, fex, v1, v2, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
@@ -217,19 +222,19 @@ int triBoxOverlap(const Vec3f& boxcenter, const Vec3f& boxhalfsize_, const Vec3f
 	fey = fabsf(e1[1]);
 	fez = fabsf(e1[2]);
 
-	result = axisTest_x01(e1[2], e1[1], fez, fey);
+	result = axisTest_x01(e1[2], e1[1], fez, fey, v0, v2, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
 	}
 
-	result = axisTest_y02(e1[2], e1[0], fez, fex);
+	result = axisTest_y02(e1[2], e1[0], fez, fex, v0, v2, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
 	}
 
-	result = axisTest_z0(e1[1], e1[0], fey, fex);
+	result = axisTest_z0(e1[1], e1[0], fey, fex, v0, v1, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
@@ -239,19 +244,19 @@ int triBoxOverlap(const Vec3f& boxcenter, const Vec3f& boxhalfsize_, const Vec3f
 	fey = fabsf(e2[1]);
 	fez = fabsf(e2[2]);
 
-	result = axisTest_x2(e2[2], e2[1], fez, fey);
+	result = axisTest_x2(e2[2], e2[1], fez, fey, v0, v1, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
 	}
 
-	result = axisTest_y1(e2[2], e2[0], fez, fex);
+	result = axisTest_y1(e2[2], e2[0], fez, fex, v0, v1, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
 	}
 
-	result = axisTest_z12(e2[1], e2[0], fey, fex);
+	result = axisTest_z12(e2[1], e2[0], fey, fex, v1, v2, boxhalfsize_);
 	if (result == 0)
 	{
 		return 0;
@@ -289,3 +294,196 @@ int triBoxOverlap(const Vec3f& boxcenter, const Vec3f& boxhalfsize_, const Vec3f
 	return 1;   /* box and triangle overlaps */
 
 }
+
+namespace
+{
+	using namespace TetraTools;
+
+	// lane mask of the boxes for which the projection interval [min(pa_, pb_), max(pa_, pb_)]
+	// lies outside [-rad_, rad_], same comparisons as the axisTest_* functions
+	inline Float4 axisSeparated(const Float4& pa_, const Float4& pb_, const Float4& rad_, const Float4& negRad_)
+	{
+		return Or(CmpGt(Min(pa_, pb_), rad_), CmpLt(Max(pa_, pb_), negRad_));
+	}
+
+	inline Float4 aabbSeparated(const Float4& a_, const Float4& b_, const Float4& c_, const Float4& half_, const Float4& negHalf_)
+	{
+		return Or(CmpGt(Min(Min(a_, b_), c_), half_), CmpLt(Max(Max(a_, b_), c_), negHalf_));
+	}
+
+	// four triangle-box tests at once, the vertices are given relative to the box centers;
+	// the operations match triBoxOverlap, so both return the same result for every lane
+	unsigned int triBoxOverlap4(const Vec3f4& v0, const Vec3f4& v1, const Vec3f4& v2, const Vec3f4& boxhalfsize_)
+	{
+		const Float4 zero = Float4::Splat(0.0f);
+		const Float4& hx = boxhalfsize_.x;
+		const Float4& hy = boxhalfsize_.y;
+		const Float4& hz = boxhalfsize_.z;
+		const Float4 nhx = zero - hx;
+		const Float4 nhy = zero - hy;
+		const Float4 nhz = zero - hz;
+
+		// bullet 1 first: the bounding box test is cheap and rejects most boxes
+		Float4 separated = aabbSeparated(v0.x, v1.x, v2.x, hx, nhx);
+		separated = Or(separated, aabbSeparated(v0.y, v1.y, v2.y, hy, nhy));
+		separated = Or(separated, aabbSeparated(v0.z, v1.z, v2.z, hz, nhz));
+		if (MoveMask(separated) == 0xF)
+		{
+			return 0;
+		}
+
+		const Vec3f4 e0 = v1 - v0;
+		const Vec3f4 e1 = v2 - v1;
+		const Vec3f4 e2 = v0 - v2;
+
+		// bullet 3
+		Float4 fex = Abs(e0.x);
+		Float4 fey = Abs(e0.y);
+		Float4 fez = Abs(e0.z);
+		Float4 rad = fez * hy + fey * hz;
+		separated = Or(separated, axisSeparated(e0.z * v0.y - e0.y * v0.z, e0.z * v2.y - e0.y * v2.z, rad, zero - rad));
+		rad = fez * hx + fex * hz;
+		separated = Or(separated, axisSeparated(e0.x * v0.z - e0.z * v0.x, e0.x * v2.z - e0.z * v2.x, rad, zero - rad));
+		rad = fey * hx + fex * hy;
+		separated = Or(separated, axisSeparated(e0.y * v1.x - e0.x * v1.y, e0.y * v2.x - e0.x * v2.y, rad, zero - rad));
+
+		fex = Abs(e1.x);
+		fey = Abs(e1.y);
+		fez = Abs(e1.z);
+		rad = fez * hy + fey * hz;
+		separated = Or(separated, axisSeparated(e1.z * v0.y - e1.y * v0.z, e1.z * v2.y - e1.y * v2.z, rad, zero - rad));
+		rad = fez * hx + fex * hz;
+		separated = Or(separated, axisSeparated(e1.x * v0.z - e1.z * v0.x, e1.x * v2.z - e1.z * v2.x, rad, zero - rad));
+		rad = fey * hx + fex * hy;
+		separated = Or(separated, axisSeparated(e1.y * v0.x - e1.x * v0.y, e1.y * v1.x - e1.x * v1.y, rad, zero - rad));
+
+		fex = Abs(e2.x);
+		fey = Abs(e2.y);
+		fez = Abs(e2.z);
+		rad = fez * hy + fey * hz;
+		separated = Or(separated, axisSeparated(e2.z * v0.y - e2.y * v0.z, e2.z * v1.y - e2.y * v1.z, rad, zero - rad));
+		rad = fez * hx + fex * hz;
+		separated = Or(separated, axisSeparated(e2.x * v0.z - e2.z * v0.x, e2.x * v1.z - e2.z * v1.x, rad, zero - rad));
+		rad = fey * hx + fex * hy;
+		separated = Or(separated, axisSeparated(e2.y * v1.x - e2.x * v1.y, e2.y * v2.x - e2.x * v2.y, rad, zero - rad));
+
+		const unsigned int separatedMask = MoveMask(separated);
+		if (separatedMask == 0xF)
+		{
+			return 0;
+		}
+
+		// bullet 2, planeBoxOverlap for all lanes
+		const Vec3f4 normal = Cross(e0, e1);
+		const Float4 px = CmpGt(normal.x, zero);
+		const Float4 py = CmpGt(normal.y, zero);
+		const Float4 pz = CmpGt(normal.z, zero);
+		Vec3f4 vmin, vmax;
+		vmin.x = Select(px, nhx - v0.x, hx - v0.x);
+		vmin.y = Select(py, nhy - v0.y, hy - v0.y);
+		vmin.z = Select(pz, nhz - v0.z, hz - v0.z);
+		vmax.x = Select(px, hx - v0.x, nhx - v0.x);
+		vmax.y = Select(py, hy - v0.y, nhy - v0.y);
+		vmax.z = Select(pz, hz - v0.z, nhz - v0.z);
+		const unsigned int planeMask = MoveMask(CmpGe(Dot(normal, vmax), zero)) & ~MoveMask(CmpGt(Dot(normal, vmin), zero));
+		return planeMask & ~separatedMask & 0xF;
+	}
+
+	inline Vec3f4 relativeToBoxes(const Vec3f& vert_, const Vec3f4& centers_)
+	{
+		Vec3f4 r;
+		r.x = Float4::Splat(vert_.x) - centers_.x;
+		r.y = Float4::Splat(vert_.y) - centers_.y;
+		r.z = Float4::Splat(vert_.z) - centers_.z;
+		return r;
+	}
+
+	inline Vec3f4 gatherRelative(const Vec3f* triverts_, const unsigned int (&tris_)[4], const unsigned int vertex_, const Vec3f& boxcenter_)
+	{
+		const Vec3f& a = triverts_[3*tris_[0]+vertex_];
+		const Vec3f& b = triverts_[3*tris_[1]+vertex_];
+		const Vec3f& c = triverts_[3*tris_[2]+vertex_];
+		const Vec3f& d = triverts_[3*tris_[3]+vertex_];
+		Vec3f4 r;
+		r.x = Float4::Set(a.x, b.x, c.x, d.x) - Float4::Splat(boxcenter_.x);
+		r.y = Float4::Set(a.y, b.y, c.y, d.y) - Float4::Splat(boxcenter_.y);
+		r.z = Float4::Set(a.z, b.z, c.z, d.z) - Float4::Splat(boxcenter_.z);
+		return r;
+	}
+}
+
+unsigned int triBoxOverlap8(const Vec3f boxcenters[8], const Vec3f& boxhalfsize, const Vec3f triverts[3])
+{
+	Vec3f4 halfsize;
+	halfsize.x = Float4::Splat(boxhalfsize.x);
+	halfsize.y = Float4::Splat(boxhalfsize.y);
+	halfsize.z = Float4::Splat(boxhalfsize.z);
+	unsigned int mask = 0;
+	for (unsigned int b=0; b<8; b+=4)
+	{
+		const Vec3f* c = boxcenters + b;
+		Vec3f4 centers;
+		centers.x = Float4::Set(c[0].x, c[1].x, c[2].x, c[3].x);
+		centers.y = Float4::Set(c[0].y, c[1].y, c[2].y, c[3].y);
+		centers.z = Float4::Set(c[0].z, c[1].z, c[2].z, c[3].z);
+		mask |= triBoxOverlap4(relativeToBoxes(triverts[0], centers), relativeToBoxes(triverts[1], centers),
+							   relativeToBoxes(triverts[2], centers), halfsize) << b;
+	}
+	return mask;
+}
+
+unsigned int triBoxOverlapN(const Vec3f& boxcenter, const Vec3f& boxhalfsize, const Vec3f* triverts, const unsigned int numTris, unsigned char* overlaps)
+{
+	Vec3f4 halfsize;
+	halfsize.x = Float4::Splat(boxhalfsize.x);
+	halfsize.y = Float4::Splat(boxhalfsize.y);
+	halfsize.z = Float4::Splat(boxhalfsize.z);
+	unsigned int count = 0;
+	unsigned int pending[4];
+	unsigned int numPending = 0;
+	for (unsigned int i=0; i<=numTris; ++i)
+	{
+		if (i < numTris)
+		{
+			overlaps[i] = 0;
+			// most triangles miss a small box, reject them by bullet 1 before gathering them
+			// into SIMD lanes (subtracting the center from the extrema gives the same values
+			// as taking the extrema of the moved vertices)
+			const Vec3f* v = triverts + 3*i;
+			bool separated = false;
+			for (unsigned int a=0; a<3 && !separated; ++a)
+			{
+				float min, max;
+				findMinMax(v[0][a], v[1][a], v[2][a], min, max);
+				separated = (min - boxcenter[a] > boxhalfsize[a]) || (max - boxcenter[a] < -boxhalfsize[a]);
+			}
+			if (separated)
+			{
+				continue;
+			}
+			pending[numPending++] = i;
+			if (numPending < 4)
+			{
+				continue;
+			}
+		}
+		if (numPending == 0)
+		{
+			break;
+		}
+		// the last group repeats its final triangle in the unused lanes
+		for (unsigned int l=numPending; l<4; ++l)
+		{
+			pending[l] = pending[numPending-1];
+		}
+		const unsigned int mask = triBoxOverlap4(gatherRelative(triverts, pending, 0, boxcenter), gatherRelative(triverts, pending, 1, boxcenter),
+												 gatherRelative(triverts, pending, 2, boxcenter), halfsize);
+		for (unsigned int l=0; l<numPending; ++l)
+		{
+			overlaps[pending[l]] = (mask >> l) & 1;
+			count += overlaps[pending[l]];
+		}
+		numPending = 0;
+	}
+	return count;
+}
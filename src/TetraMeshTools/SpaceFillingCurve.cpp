@@ -0,0 +1,127 @@
+/*
+ * SpaceFillingCurve.cpp
+ *
+ * Morton and Hilbert keys and curve orderings for point sets.
+ */
+
+#include "SpaceFillingCurve.h"
+#include "ParallelUtils.h"
+#include <algorithm>
+#include <utility>
+#include <functional>
+
+namespace
+{
+	/// spreads the lower 21 bits of v_ so that there are two zero bits between each of them
+	inline uint64_t SpreadBits(const uint32_t v_)
+	{
+		uint64_t x = v_ & 0x1FFFFF;
+		x = (x | (x << 32)) & 0x001F00000000FFFFull;
+		x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+		x = (x | (x << 8))  & 0x100F00F00F00F00Full;
+		x = (x | (x << 4))  & 0x10C30C30C30C30C3ull;
+		x = (x | (x << 2))  & 0x1249249249249249ull;
+		return x;
+	}
+
+	/**
+	 * Converts cell coordinates into the transposed Hilbert index
+	 * (J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707, 2004).
+	 */
+	inline void AxesToTranspose(uint32_t (&x_)[3], const unsigned int bits_)
+	{
+		const uint32_t m = 1u << (bits_ - 1);
+		/// inverse undo
+		for (uint32_t q=m; q>1; q>>=1)
+		{
+			const uint32_t p = q - 1;
+			for (unsigned int i=0; i<3; ++i)
+			{
+				if (x_[i] & q)
+				{
+					x_[0] ^= p;
+				}
+				else
+				{
+					const uint32_t t = (x_[0] ^ x_[i]) & p;
+					x_[0] ^= t;
+					x_[i] ^= t;
+				}
+			}
+		}
+		/// gray encode
+		x_[1] ^= x_[0];
+		x_[2] ^= x_[1];
+		uint32_t t = 0;
+		for (uint32_t q=m; q>1; q>>=1)
+		{
+			if (x_[2] & q)
+				t ^= q - 1;
+		}
+		x_[0] ^= t;
+		x_[1] ^= t;
+		x_[2] ^= t;
+	}
+}
+
+uint64_t TetraTools::MortonKey(const uint32_t x_, const uint32_t y_, const uint32_t z_)
+{
+	return (SpreadBits(x_) << 2) | (SpreadBits(y_) << 1) | SpreadBits(z_);
+}
+
+uint64_t TetraTools::HilbertKey(const uint32_t x_, const uint32_t y_, const uint32_t z_)
+{
+	const uint32_t mask = (1u << CurveBitsPerAxis) - 1;
+	uint32_t x[3] = { x_ & mask, y_ & mask, z_ & mask };
+	AxesToTranspose(x, CurveBitsPerAxis);
+	/// the transposed index is read bit-plane by bit-plane, i.e. Morton interleaved
+	return MortonKey(x[0], x[1], x[2]);
+}
+
+void TetraTools::ComputeCurveKeys(const std::vector<Vec3f>& points_, const BoundingBox& box_, const SpaceFillingCurve curve_, std::vector<uint64_t>& keys_)
+{
+	keys_.resize(points_.size());
+	const Vec3f extent = box_.max - box_.min;
+	const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+	const double maxCell = (double)((1u << CurveBitsPerAxis) - 1);
+	/// uniform scaling keeps the curve's locality isotropic for flat boxes
+	const double scale = (maxExtent > 0.0f) ? maxCell / maxExtent : 0.0;
+	ParallelFor(0, points_.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const Vec3f& p = points_[i];
+			uint32_t cell[3];
+			for (unsigned int a=0; a<3; ++a)
+			{
+				const double c = (p[a] - box_.min[a]) * scale;
+				cell[a] = (uint32_t)std::min(std::max(c, 0.0), maxCell);
+			}
+			keys_[i] = (curve_ == CURVE_HILBERT) ? HilbertKey(cell[0], cell[1], cell[2]) : MortonKey(cell[0], cell[1], cell[2]);
+		}
+	});
+}
+
+void TetraTools::ComputeCurvePermutation(const std::vector<Vec3f>& points_, const BoundingBox& box_, const SpaceFillingCurve curve_, std::vector<unsigned int>& permutation_)
+{
+	std::vector<uint64_t> keys;
+	ComputeCurveKeys(points_, box_, curve_, keys);
+	std::vector<std::pair<uint64_t, unsigned int> > order(points_.size());
+	ParallelFor(0, order.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			order[i] = std::make_pair(keys[i], (unsigned int)i);
+		}
+	});
+	/// pairs compare by key first and original index second, so the order is deterministic
+	ParallelSort(order.begin(), order.end(), std::less<std::pair<uint64_t, unsigned int> >());
+	permutation_.resize(order.size());
+	ParallelFor(0, order.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			permutation_[order[i].second] = (unsigned int)i;
+		}
+	});
+}
@@ -0,0 +1,468 @@
+/*
+ * SurfaceVoxelizer.cpp
+ *
+ * Brick binning, batched SAT voxelization and row parity filling.
+ */
+
+#include "SurfaceVoxelizer.h"
+#include "SATriangleBoxIntersection.h"
+#include "ParallelUtils.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <mutex>
+
+namespace
+{
+	const unsigned int MaxResolution = 8192;
+
+	/// enlargement of the voxel test boxes, so triangles lying in a shared face are not lost to rounding
+	const float BoxTolerance = 1e-5f;
+
+	/// slack (in voxels) of the conservative index ranges, the exact tests decide
+	const float RangeSlack = 0.01f;
+
+	inline unsigned int PopCount(uint64_t x_)
+	{
+		x_ = x_ - ((x_ >> 1) & 0x5555555555555555ull);
+		x_ = (x_ & 0x3333333333333333ull) + ((x_ >> 2) & 0x3333333333333333ull);
+		x_ = (x_ + (x_ >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+		return (unsigned int)((x_ * 0x0101010101010101ull) >> 56);
+	}
+
+	/**
+	 * Conservative range [first_, last_] of the voxels along one axis that can overlap [min_, max_].
+	 * Returns false if the range lies outside the grid.
+	 */
+	inline bool VoxelRange(const float min_, const float max_, const float origin_, const float voxelSize_, const unsigned int resolution_, unsigned int& first_, unsigned int& last_)
+	{
+		const float lo = floorf((min_ - origin_) / voxelSize_ - RangeSlack);
+		const float hi = floorf((max_ - origin_) / voxelSize_ + RangeSlack);
+		if (hi < 0.0f || lo >= (float)resolution_)
+			return false;
+		first_ = (unsigned int)std::max(lo, 0.0f);
+		last_ = (unsigned int)std::min(hi, (float)(resolution_ - 1));
+		return true;
+	}
+
+	/**
+	 * Range [first_, last_] of the voxels along one axis whose centers can lie in [min_, max_].
+	 */
+	inline bool CenterRange(const float min_, const float max_, const float origin_, const float voxelSize_, const unsigned int resolution_, unsigned int& first_, unsigned int& last_)
+	{
+		return VoxelRange(min_ - 0.5f * voxelSize_, max_ - 0.5f * voxelSize_, origin_, voxelSize_, resolution_, first_, last_);
+	}
+
+	inline void TriangleBounds(const Vec3f tv_[3], Vec3f& min_, Vec3f& max_)
+	{
+		min_ = tv_[0];
+		max_ = tv_[0];
+		for (unsigned int i=1; i<3; ++i)
+		{
+			min_.x = std::min(min_.x, tv_[i].x);
+			min_.y = std::min(min_.y, tv_[i].y);
+			min_.z = std::min(min_.z, tv_[i].z);
+			max_.x = std::max(max_.x, tv_[i].x);
+			max_.y = std::max(max_.y, tv_[i].y);
+			max_.z = std::max(max_.z, tv_[i].z);
+		}
+	}
+
+	/**
+	 * Collects the keys (cell << 32 | triangle) emitted by emit_(triangle, keys) for all
+	 * triangles in parallel and sorts them, so the triangles of a cell are contiguous.
+	 */
+	template <typename Emit>
+	void BinTriangles(const size_t numTriangles_, const Emit& emit_, std::vector<uint64_t>& keys_)
+	{
+		keys_.clear();
+		std::mutex mutex;
+		TetraTools::ParallelFor(0, numTriangles_, [&](size_t b_, size_t e_)
+		{
+			std::vector<uint64_t> local;
+			for (size_t t=b_; t<e_; ++t)
+			{
+				emit_((unsigned int)t, local);
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			keys_.insert(keys_.end(), local.begin(), local.end());
+		}, 4096);
+		TetraTools::ParallelSort(keys_.begin(), keys_.end(), std::less<uint64_t>());
+	}
+
+	/**
+	 * Splits the sorted keys into cells: the triangles of cells_[c] are keys_[offsets_[c] .. offsets_[c+1]).
+	 */
+	void GroupKeys(const std::vector<uint64_t>& keys_, std::vector<unsigned int>& cells_, std::vector<size_t>& offsets_)
+	{
+		cells_.clear();
+		offsets_.clear();
+		for (size_t i=0; i<keys_.size(); ++i)
+		{
+			const unsigned int cell = (unsigned int)(keys_[i] >> 32);
+			if (cells_.empty() || cells_.back() != cell)
+			{
+				cells_.push_back(cell);
+				offsets_.push_back(i);
+			}
+		}
+		offsets_.push_back(keys_.size());
+	}
+
+	/**
+	 * Calls function_(c) for all cells in [0, numCells_) on all threads. The cells are
+	 * handed out in small batches, since their costs differ a lot.
+	 */
+	template <typename Function>
+	void ForEachCell(const size_t numCells_, const Function& function_)
+	{
+		const size_t batchSize = 16;
+		std::atomic<size_t> next(0);
+		TetraTools::ParallelFor(0, std::min<size_t>(TetraTools::GetNumThreads(), (numCells_ + batchSize - 1) / batchSize), [&](size_t, size_t)
+		{
+			for (size_t b=next.fetch_add(batchSize); b<numCells_; b=next.fetch_add(batchSize))
+			{
+				const size_t e = std::min(numCells_, b + batchSize);
+				for (size_t c=b; c<e; ++c)
+				{
+					function_(c);
+				}
+			}
+		}, 1);
+	}
+
+	/**
+	 * Signed area of (a_, b_, p_) in the yz plane. It is computed from the lexicographically
+	 * smaller end point, so the two triangles sharing an edge get exactly opposite values.
+	 */
+	inline double EdgeFunction(const Vec3f& a_, const Vec3f& b_, const double py_, const double pz_)
+	{
+		const bool swap = (b_.y < a_.y) || (b_.y == a_.y && b_.z < a_.z);
+		const Vec3f& s = swap ? b_ : a_;
+		const Vec3f& e = swap ? a_ : b_;
+		const double w = ((double)e.y - s.y) * (pz_ - s.z) - ((double)e.z - s.z) * (py_ - s.y);
+		return swap ? -w : w;
+	}
+
+	/**
+	 * Inside test of one edge for a positively oriented triangle (orientation_ = 1 or -1).
+	 * Points on the edge belong to it if the oriented edge points along +y, or along +z
+	 * for edges parallel to z (top-left rule).
+	 */
+	inline bool InsideEdge(const Vec3f& a_, const Vec3f& b_, const double orientation_, const double py_, const double pz_)
+	{
+		const double w = EdgeFunction(a_, b_, py_, pz_) * orientation_;
+		if (w != 0.0)
+			return w > 0.0;
+		const double dy = ((double)b_.y - a_.y) * orientation_;
+		const double dz = ((double)b_.z - a_.z) * orientation_;
+		return dy > 0.0 || (dy == 0.0 && dz > 0.0);
+	}
+}
+
+TetraTools::SurfaceVoxelizer::SurfaceVoxelizer()
+	: _resolution(0), _numBricksPerAxis(0), _origin(0.0f, 0.0f, 0.0f), _voxelSize(1.0f), _fillInside(false),
+	  _numSurfaceVoxels(0), _numInsideVoxels(0), _numSurfaceBricks(0)
+{
+}
+
+void TetraTools::SurfaceVoxelizer::Clear()
+{
+	std::vector<uint64_t>().swap(_bricks);
+	_resolution = 0;
+	_numBricksPerAxis = 0;
+	_numSurfaceVoxels = 0;
+	_numInsideVoxels = 0;
+	_numSurfaceBricks = 0;
+}
+
+bool TetraTools::SurfaceVoxelizer::Voxelize(const TriangleTopology& topology_, const unsigned int resolution_)
+{
+	const std::vector<Vec3f>& vertices = topology_.GetVertices();
+	if (vertices.empty() || resolution_ == 0)
+	{
+		std::cerr<<"ERROR! SurfaceVoxelizer: empty mesh or zero resolution!"<<std::endl;
+		return false;
+	}
+	Vec3f minBB = vertices[0], maxBB = vertices[0];
+	for (size_t i=1; i<vertices.size(); ++i)
+	{
+		minBB.x = std::min(minBB.x, vertices[i].x);
+		minBB.y = std::min(minBB.y, vertices[i].y);
+		minBB.z = std::min(minBB.z, vertices[i].z);
+		maxBB.x = std::max(maxBB.x, vertices[i].x);
+		maxBB.y = std::max(maxBB.y, vertices[i].y);
+		maxBB.z = std::max(maxBB.z, vertices[i].z);
+	}
+	const unsigned int resolution = std::max(8u, (resolution_ + 7) & ~7u);
+	const float extent = std::max(maxBB.x - minBB.x, std::max(maxBB.y - minBB.y, maxBB.z - minBB.z));
+	/// one empty voxel on every side
+	const float voxelSize = (extent > 0.0f) ? extent / (resolution - 2) : 1.0f;
+	Vec3f center = minBB + maxBB;
+	center /= 2.0f;
+	const float halfLength = 0.5f * resolution * voxelSize;
+	return Voxelize(vertices, topology_.GetTriangles(), resolution, center - Vec3f(halfLength, halfLength, halfLength), voxelSize);
+}
+
+bool TetraTools::SurfaceVoxelizer::Voxelize(const TriangleTopology& topology_, const unsigned int resolution_, const Vec3f& origin_, const float voxelSize_)
+{
+	return Voxelize(topology_.GetVertices(), topology_.GetTriangles(), resolution_, origin_, voxelSize_);
+}
+
+bool TetraTools::SurfaceVoxelizer::Voxelize(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_, const unsigned int resolution_, const Vec3f& origin_, const float voxelSize_)
+{
+	const unsigned int resolution = (resolution_ + 7) & ~7u;
+	if (resolution == 0 || resolution > MaxResolution || !(voxelSize_ > 0.0f))
+	{
+		std::cerr<<"ERROR! SurfaceVoxelizer: invalid grid (resolution "<<resolution_<<", at most "<<MaxResolution<<", voxel size "<<voxelSize_<<")!"<<std::endl;
+		return false;
+	}
+	std::cout<<"Voxelizing "<<triangles_.size()<<" triangles into a "<<resolution<<"^3 grid..."<<std::endl;
+	_resolution = resolution;
+	_numBricksPerAxis = resolution / 8;
+	_origin = origin_;
+	_voxelSize = voxelSize_;
+	const size_t numBricks = (size_t)_numBricksPerAxis * _numBricksPerAxis * _numBricksPerAxis;
+	_bricks.assign(numBricks * 8, 0);
+
+	VoxelizeSurface(vertices_, triangles_);
+	_numSurfaceVoxels = CountVoxels();
+	_numInsideVoxels = 0;
+	if (_fillInside)
+	{
+		FillInside(vertices_, triangles_);
+		_numInsideVoxels = CountVoxels() - _numSurfaceVoxels;
+	}
+	std::cout<<"\t"<<_numSurfaceVoxels<<" surface voxels in "<<_numSurfaceBricks<<" bricks, "<<_numInsideVoxels<<" inside voxels"<<std::endl;
+	return true;
+}
+
+void TetraTools::SurfaceVoxelizer::VoxelizeSurface(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_)
+{
+	const unsigned int res = _resolution;
+	const unsigned int nb = _numBricksPerAxis;
+	const float vs = _voxelSize;
+	const Vec3f origin = _origin;
+	const float brickHalf = 4.0f * vs * (1.0f + 1e-3f);
+	const Vec3f brickHalfSize(brickHalf, brickHalf, brickHalf);
+
+	/// bin the triangles into the bricks they overlap, eight bricks along x per batched test
+	std::vector<uint64_t> keys;
+	BinTriangles(triangles_.size(), [&](const unsigned int t_, std::vector<uint64_t>& keys_)
+	{
+		const Triangle& tri = triangles_[t_];
+		const Vec3f tv[3] = {vertices_[tri.index[0]], vertices_[tri.index[1]], vertices_[tri.index[2]]};
+		Vec3f triMin, triMax;
+		TriangleBounds(tv, triMin, triMax);
+		unsigned int first[3], last[3];
+		if (!VoxelRange(triMin.x, triMax.x, origin.x, vs, res, first[0], last[0])
+			|| !VoxelRange(triMin.y, triMax.y, origin.y, vs, res, first[1], last[1])
+			|| !VoxelRange(triMin.z, triMax.z, origin.z, vs, res, first[2], last[2]))
+			return;
+		for (unsigned int a=0; a<3; ++a)
+		{
+			first[a] >>= 3;
+			last[a] >>= 3;
+		}
+		const bool single = (first[0] == last[0] && first[1] == last[1] && first[2] == last[2]);
+		for (unsigned int bz=first[2]; bz<=last[2]; ++bz)
+		{
+			for (unsigned int by=first[1]; by<=last[1]; ++by)
+			{
+				for (unsigned int bx=first[0]; bx<=last[0]; bx+=8)
+				{
+					unsigned int mask = 1;
+					if (!single)
+					{
+						Vec3f centers[8];
+						for (unsigned int l=0; l<8; ++l)
+						{
+							const unsigned int x = std::min(bx + l, last[0]);
+							centers[l] = Vec3f(origin.x + (x * 8 + 4) * vs, origin.y + (by * 8 + 4) * vs, origin.z + (bz * 8 + 4) * vs);
+						}
+						mask = triBoxOverlap8(centers, brickHalfSize, tv);
+					}
+					for (unsigned int l=0; l<8 && bx+l<=last[0]; ++l)
+					{
+						if (mask & (1u << l))
+						{
+							const uint64_t brick = ((uint64_t)bz * nb + by) * nb + bx + l;
+							keys_.push_back((brick << 32) | t_);
+						}
+					}
+				}
+			}
+		}
+	}, keys);
+	std::vector<unsigned int> bricks;
+	std::vector<size_t> offsets;
+	GroupKeys(keys, bricks, offsets);
+	_numSurfaceBricks = bricks.size();
+
+	/// every brick is voxelized by one thread, one batched test classifies a row of 8 voxels
+	const float voxelHalf = 0.5f * vs * (1.0f + BoxTolerance);
+	const Vec3f voxelHalfSize(voxelHalf, voxelHalf, voxelHalf);
+	ForEachCell(bricks.size(), [&](const size_t c_)
+	{
+		const unsigned int brick = bricks[c_];
+		const unsigned int bx = brick % nb;
+		const unsigned int by = (brick / nb) % nb;
+		const unsigned int bz = brick / nb / nb;
+		uint64_t words[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+		Vec3f rowCenters[8];
+		for (unsigned int l=0; l<8; ++l)
+		{
+			rowCenters[l].x = origin.x + (bx * 8 + l + 0.5f) * vs;
+		}
+		for (size_t i=offsets[c_]; i<offsets[c_+1]; ++i)
+		{
+			const Triangle& tri = triangles_[(unsigned int)keys[i]];
+			const Vec3f tv[3] = {vertices_[tri.index[0]], vertices_[tri.index[1]], vertices_[tri.index[2]]};
+			Vec3f triMin, triMax;
+			TriangleBounds(tv, triMin, triMax);
+			unsigned int firstY, lastY, firstZ, lastZ;
+			if (!VoxelRange(triMin.y, triMax.y, origin.y, vs, res, firstY, lastY) || !VoxelRange(triMin.z, triMax.z, origin.z, vs, res, firstZ, lastZ))
+				continue;
+			firstY = std::max(firstY, by * 8);
+			lastY = std::min(lastY, by * 8 + 7);
+			firstZ = std::max(firstZ, bz * 8);
+			lastZ = std::min(lastZ, bz * 8 + 7);
+			for (unsigned int z=firstZ; z<=lastZ; ++z)
+			{
+				const float cz = origin.z + (z + 0.5f) * vs;
+				for (unsigned int y=firstY; y<=lastY; ++y)
+				{
+					const unsigned int shift = (y & 7) * 8;
+					if (((words[z & 7] >> shift) & 0xFF) == 0xFF)
+						continue;
+					const float cy = origin.y + (y + 0.5f) * vs;
+					for (unsigned int l=0; l<8; ++l)
+					{
+						rowCenters[l].y = cy;
+						rowCenters[l].z = cz;
+					}
+					words[z & 7] |= (uint64_t)triBoxOverlap8(rowCenters, voxelHalfSize, tv) << shift;
+				}
+			}
+		}
+		std::copy(words, words + 8, &_bricks[(size_t)brick * 8]);
+	});
+}
+
+void TetraTools::SurfaceVoxelizer::FillInside(const std::vector<Vec3f>& vertices_, const std::vector<Triangle>& triangles_)
+{
+	const unsigned int res = _resolution;
+	const unsigned int nb = _numBricksPerAxis;
+	const float vs = _voxelSize;
+	const Vec3f origin = _origin;
+
+	/// bin the triangles into the columns of 8x8 rows (brick columns along x) their yz projection covers
+	std::vector<uint64_t> keys;
+	BinTriangles(triangles_.size(), [&](const unsigned int t_, std::vector<uint64_t>& keys_)
+	{
+		const Triangle& tri = triangles_[t_];
+		const Vec3f tv[3] = {vertices_[tri.index[0]], vertices_[tri.index[1]], vertices_[tri.index[2]]};
+		Vec3f triMin, triMax;
+		TriangleBounds(tv, triMin, triMax);
+		unsigned int firstY, lastY, firstZ, lastZ;
+		if (!CenterRange(triMin.y, triMax.y, origin.y, vs, res, firstY, lastY) || !CenterRange(triMin.z, triMax.z, origin.z, vs, res, firstZ, lastZ))
+			return;
+		for (unsigned int bz=firstZ>>3; bz<=lastZ>>3; ++bz)
+		{
+			for (unsigned int by=firstY>>3; by<=lastY>>3; ++by)
+			{
+				keys_.push_back(((uint64_t)(bz * nb + by) << 32) | t_);
+			}
+		}
+	}, keys);
+	std::vector<unsigned int> columns;
+	std::vector<size_t> offsets;
+	GroupKeys(keys, columns, offsets);
+
+	/// the rows of a column only touch the bricks of that column, so the columns can be filled concurrently
+	ForEachCell(columns.size(), [&](const size_t c_)
+	{
+		const unsigned int by = columns[c_] % nb;
+		const unsigned int bz = columns[c_] / nb;
+		std::vector<double> crossings[64];
+		for (size_t i=offsets[c_]; i<offsets[c_+1]; ++i)
+		{
+			const Triangle& tri = triangles_[(unsigned int)keys[i]];
+			const Vec3f tv[3] = {vertices_[tri.index[0]], vertices_[tri.index[1]], vertices_[tri.index[2]]};
+			const double e1[3] = {(double)tv[1].x - tv[0].x, (double)tv[1].y - tv[0].y, (double)tv[1].z - tv[0].z};
+			const double e2[3] = {(double)tv[2].x - tv[0].x, (double)tv[2].y - tv[0].y, (double)tv[2].z - tv[0].z};
+			/// plane normal, its x component is twice the signed area of the yz projection
+			const double nx = e1[1] * e2[2] - e1[2] * e2[1];
+			const double ny = e1[2] * e2[0] - e1[0] * e2[2];
+			const double nz = e1[0] * e2[1] - e1[1] * e2[0];
+			if (nx == 0.0)
+				continue;
+			const double orientation = (nx > 0.0) ? 1.0 : -1.0;
+			Vec3f triMin, triMax;
+			TriangleBounds(tv, triMin, triMax);
+			unsigned int firstY, lastY, firstZ, lastZ;
+			if (!CenterRange(triMin.y, triMax.y, origin.y, vs, res, firstY, lastY) || !CenterRange(triMin.z, triMax.z, origin.z, vs, res, firstZ, lastZ))
+				continue;
+			firstY = std::max(firstY, by * 8);
+			lastY = std::min(lastY, by * 8 + 7);
+			firstZ = std::max(firstZ, bz * 8);
+			lastZ = std::min(lastZ, bz * 8 + 7);
+			for (unsigned int z=firstZ; z<=lastZ; ++z)
+			{
+				const double pz = (double)origin.z + (z + 0.5) * vs;
+				for (unsigned int y=firstY; y<=lastY; ++y)
+				{
+					const double py = (double)origin.y + (y + 0.5) * vs;
+					if (InsideEdge(tv[0], tv[1], orientation, py, pz) && InsideEdge(tv[1], tv[2], orientation, py, pz) && InsideEdge(tv[2], tv[0], orientation, py, pz))
+					{
+						crossings[(z & 7) * 8 + (y & 7)].push_back(tv[0].x - (ny * (py - tv[0].y) + nz * (pz - tv[0].z)) / nx);
+					}
+				}
+			}
+		}
+		for (unsigned int r=0; r<64; ++r)
+		{
+			std::vector<double>& xs = crossings[r];
+			std::sort(xs.begin(), xs.end());
+			for (size_t i=0; i+1<xs.size(); i+=2)
+			{
+				/// voxels with their centers in [xs[i], xs[i+1]]
+				const double first = ceil((xs[i] - origin.x) / vs - 0.5);
+				const double last = floor((xs[i+1] - origin.x) / vs - 0.5);
+				if (last < 0.0 || first > res - 1.0 || first > last)
+					continue;
+				SetRow(by * 8 + (r & 7), bz * 8 + (r >> 3), (unsigned int)std::max(first, 0.0), (unsigned int)std::min(last, res - 1.0));
+			}
+		}
+	});
+}
+
+void TetraTools::SurfaceVoxelizer::SetRow(const unsigned int y_, const unsigned int z_, const unsigned int begin_, const unsigned int end_)
+{
+	const unsigned int shift = (y_ & 7) * 8;
+	for (unsigned int bx=begin_>>3; bx<=end_>>3; ++bx)
+	{
+		const unsigned int lo = std::max(begin_, bx * 8) - bx * 8;
+		const unsigned int hi = std::min(end_, bx * 8 + 7) - bx * 8;
+		const uint64_t rowMask = (0xFFu >> (7 - hi)) & (0xFFu << lo);
+		const size_t brick = ((size_t)(z_ >> 3) * _numBricksPerAxis + (y_ >> 3)) * _numBricksPerAxis + bx;
+		_bricks[brick * 8 + (z_ & 7)] |= rowMask << shift;
+	}
+}
+
+size_t TetraTools::SurfaceVoxelizer::CountVoxels() const
+{
+	std::atomic<size_t> count(0);
+	ParallelFor(0, _bricks.size(), [&](size_t b_, size_t e_)
+	{
+		size_t c = 0;
+		for (size_t i=b_; i<e_; ++i)
+		{
+			c += PopCount(_bricks[i]);
+		}
+		count += c;
+	}, 1 << 16);
+	return count;
+}
@@ -63,4 +63,10 @@ bool TetraTools::TetgenWriter::SaveToFile(const std::string& fileName_, const st
 		return false;
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+bool TetraTools::TetgenWriter::SaveToFile(const std::string& fileName_, TetrahedronTopology& topology_)
+{
+	const TetrahedronTopology& topology = topology_;
+	return SaveToFile(fileName_, topology.GetVertices(), topology_.GetTetrahedra());
+}
@@ -0,0 +1,337 @@
+/*
+ * TetraQuality.cpp
+ *
+ * Batched quality metrics for tetrahedral meshes.
+ */
+
+#include "TetraQuality.h"
+#include "ParallelUtils.h"
+#include "SimdFloat4.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#ifndef WIN32
+#include <cfloat>
+#include <math.h>
+#else
+#include <float.h>
+#endif
+
+namespace
+{
+	using TetraTools::Float4;
+
+	const float RadToDeg = 57.29577951308232f;
+	const float TwoSqrt6 = 4.898979485566356f;
+
+	inline float AngleFromCosine(const float cosine_)
+	{
+		return acosf(std::max(-1.0f, std::min(1.0f, cosine_))) * RadToDeg;
+	}
+
+	inline Float4 DihedralCosine(const TetraTools::Vec3f4& ni_, const Float4& li_, const TetraTools::Vec3f4& nj_, const Float4& lj_)
+	{
+		/// the dihedral angle is pi minus the angle between the outward face normals
+		return (Float4::Splat(0.0f) - TetraTools::Dot(ni_, nj_)) / (li_ * lj_);
+	}
+
+	/**
+	 * Evaluates all metrics for the tetrahedra [first_, first_ + count_), count_ <= 4.
+	 * Missing lanes repeat the last tetrahedron and are not stored.
+	 */
+	void ComputeBatch(	const std::vector<Vec3f>& vertices_,
+						const std::vector<Tetrahedron>& tetras_,
+						const size_t first_,
+						const size_t count_,
+						std::vector<float>* values_,
+						std::vector<unsigned char>& flags_,
+						const float sliverAngle_,
+						size_t& numInverted_,
+						size_t& numSlivers_)
+	{
+		using namespace TetraTools;
+		float coords[4][3][4];
+		for (size_t l=0; l<4; ++l)
+		{
+			const Tetrahedron& t = tetras_[first_ + std::min(l, count_ - 1)];
+			for (unsigned int c=0; c<4; ++c)
+			{
+				const Vec3f& p = vertices_[t.index[c]];
+				coords[c][0][l] = p.x;
+				coords[c][1][l] = p.y;
+				coords[c][2][l] = p.z;
+			}
+		}
+		Vec3f4 p[4];
+		for (unsigned int c=0; c<4; ++c)
+		{
+			p[c].x = Float4::Load(coords[c][0]);
+			p[c].y = Float4::Load(coords[c][1]);
+			p[c].z = Float4::Load(coords[c][2]);
+		}
+		const Vec3f4 e01 = p[1] - p[0];
+		const Vec3f4 e02 = p[2] - p[0];
+		const Vec3f4 e03 = p[3] - p[0];
+		const Vec3f4 e12 = p[2] - p[1];
+		const Vec3f4 e13 = p[3] - p[1];
+		const Vec3f4 e23 = p[3] - p[2];
+
+		const Vec3f4 c23 = Cross(e02, e03);
+		const Float4 det = Dot(e01, c23);
+		const Float4 absDet = Abs(det);
+
+		/// outward (area weighted) normals of the faces opposite to vertex 0..3
+		const Vec3f4 n0 = Cross(e12, e13);
+		const Vec3f4 n1 = Cross(e03, e02);
+		const Vec3f4 n2 = Cross(e01, e03);
+		const Vec3f4 n3 = Cross(e02, e01);
+		const Float4 l0 = Sqrt(Dot(n0, n0));
+		const Float4 l1 = Sqrt(Dot(n1, n1));
+		const Float4 l2 = Sqrt(Dot(n2, n2));
+		const Float4 l3 = Sqrt(Dot(n3, n3));
+
+		const Float4 c01 = DihedralCosine(n0, l0, n1, l1);
+		const Float4 c02 = DihedralCosine(n0, l0, n2, l2);
+		const Float4 c03 = DihedralCosine(n0, l0, n3, l3);
+		const Float4 c12 = DihedralCosine(n1, l1, n2, l2);
+		const Float4 c13 = DihedralCosine(n1, l1, n3, l3);
+		const Float4 c23d = DihedralCosine(n2, l2, n3, l3);
+		const Float4 minCos = Min(Min(Min(c01, c02), Min(c03, c12)), Min(c13, c23d));
+		const Float4 maxCos = Max(Max(Max(c01, c02), Max(c03, c12)), Max(c13, c23d));
+
+		const Float4 s01 = Dot(e01, e01);
+		const Float4 s02 = Dot(e02, e02);
+		const Float4 s03 = Dot(e03, e03);
+		const Float4 s12 = Dot(e12, e12);
+		const Float4 s13 = Dot(e13, e13);
+		const Float4 s23 = Dot(e23, e23);
+		const Float4 minEdge = Sqrt(Min(Min(Min(s01, s02), Min(s03, s12)), Min(s13, s23)));
+		const Float4 maxEdge = Sqrt(Max(Max(Max(s01, s02), Max(s03, s12)), Max(s13, s23)));
+
+		/// circumcenter relative to p0 is this vector divided by 2 det
+		const Vec3f4 cc = c23 * s01 + Cross(e03, e01) * s02 + Cross(e01, e02) * s03;
+		const Float4 twoAbsDet = absDet + absDet;
+		const Float4 radiusEdge = Sqrt(Dot(cc, cc)) / (twoAbsDet * minEdge);
+		/// inradius = 3 V / area sum = |det| / (l0 + l1 + l2 + l3)
+		const Float4 aspect = maxEdge * (l0 + l1 + l2 + l3) / (Float4::Splat(TwoSqrt6) * absDet);
+
+		float detL[4], minCosL[4], maxCosL[4], radiusEdgeL[4], aspectL[4];
+		det.Store(detL);
+		minCos.Store(minCosL);
+		maxCos.Store(maxCosL);
+		radiusEdge.Store(radiusEdgeL);
+		aspect.Store(aspectL);
+		for (size_t l=0; l<count_; ++l)
+		{
+			const size_t i = first_ + l;
+			float minDihedral = 0.0f;
+			float maxDihedral = 180.0f;
+			float radiusEdgeRatio = FLT_MAX;
+			float aspectRatio = FLT_MAX;
+			if (detL[l] != 0.0f)
+			{
+				minDihedral = AngleFromCosine(maxCosL[l]);
+				maxDihedral = AngleFromCosine(minCosL[l]);
+				if (radiusEdgeL[l] < FLT_MAX)
+					radiusEdgeRatio = radiusEdgeL[l];
+				if (aspectL[l] < FLT_MAX)
+					aspectRatio = aspectL[l];
+			}
+			values_[QUALITY_VOLUME][i] = detL[l] / 6.0f;
+			values_[QUALITY_MIN_DIHEDRAL][i] = minDihedral;
+			values_[QUALITY_MAX_DIHEDRAL][i] = maxDihedral;
+			values_[QUALITY_RADIUS_EDGE_RATIO][i] = radiusEdgeRatio;
+			values_[QUALITY_ASPECT_RATIO][i] = aspectRatio;
+			unsigned char flags = 0;
+			if (detL[l] <= 0.0f)
+			{
+				flags |= QUALITY_FLAG_INVERTED;
+				++numInverted_;
+			}
+			else if (minDihedral < sliverAngle_)
+			{
+				flags |= QUALITY_FLAG_SLIVER;
+				++numSlivers_;
+			}
+			flags_[i] = flags;
+		}
+	}
+}
+
+TetraTools::TetraQuality::TetraQuality() : _numInverted(0), _numSlivers(0), _sliverAngle(5.0f)
+{
+
+}
+
+void TetraTools::TetraQuality::Clear()
+{
+	for (unsigned int m=0; m<QUALITY_NUM_METRICS; ++m)
+	{
+		_values[m].clear();
+	}
+	_flags.clear();
+	_numInverted = 0;
+	_numSlivers = 0;
+}
+
+void TetraTools::TetraQuality::Compute(TetrahedronTopology& topology_)
+{
+	const TetrahedronTopology& topology = topology_;
+	Compute(topology.GetVertices(), topology_.GetTetrahedra());
+}
+
+void TetraTools::TetraQuality::Compute(const std::vector<Vec3f>& vertices_, const std::vector<Tetrahedron>& tetras_)
+{
+	std::cout<<"Computing tetrahedron quality..."<<std::endl;
+	const size_t numTetras = tetras_.size();
+	for (unsigned int m=0; m<QUALITY_NUM_METRICS; ++m)
+	{
+		_values[m].resize(numTetras);
+	}
+	_flags.resize(numTetras);
+	std::atomic<size_t> numInverted(0);
+	std::atomic<size_t> numSlivers(0);
+	const size_t numBatches = (numTetras + 3) / 4;
+	ParallelFor(0, numBatches, [&](size_t b_, size_t e_)
+	{
+		size_t inverted = 0;
+		size_t slivers = 0;
+		for (size_t b=b_; b<e_; ++b)
+		{
+			const size_t first = b * 4;
+			ComputeBatch(vertices_, tetras_, first, std::min<size_t>(4, numTetras - first), _values, _flags, _sliverAngle, inverted, slivers);
+		}
+		numInverted += inverted;
+		numSlivers += slivers;
+	}, 256);
+	_numInverted = numInverted;
+	_numSlivers = numSlivers;
+}
+
+TetraTools::QualityStatistics TetraTools::TetraQuality::GetStatistics(const QualityMetric metric_) const
+{
+	QualityStatistics stats;
+	stats.min = 0.0f;
+	stats.max = 0.0f;
+	stats.mean = 0.0f;
+	const std::vector<float>& values = _values[metric_];
+	if (values.empty())
+		return stats;
+	stats.min = FLT_MAX;
+	stats.max = -FLT_MAX;
+	double sum = 0.0;
+	std::mutex mutex;
+	ParallelFor(0, values.size(), [&](size_t b_, size_t e_)
+	{
+		float mn = FLT_MAX;
+		float mx = -FLT_MAX;
+		double s = 0.0;
+		for (size_t i=b_; i<e_; ++i)
+		{
+			mn = std::min(mn, values[i]);
+			mx = std::max(mx, values[i]);
+			s += values[i];
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.min = std::min(stats.min, mn);
+		stats.max = std::max(stats.max, mx);
+		sum += s;
+	});
+	stats.mean = (float)(sum / values.size());
+	return stats;
+}
+
+bool TetraTools::TetraQuality::IsLowerWorse(const QualityMetric metric_)
+{
+	return (metric_ == QUALITY_VOLUME || metric_ == QUALITY_MIN_DIHEDRAL);
+}
+
+const char* TetraTools::TetraQuality::GetMetricName(const QualityMetric metric_)
+{
+	switch (metric_)
+	{
+	case QUALITY_VOLUME:
+		return "Volume";
+	case QUALITY_MIN_DIHEDRAL:
+		return "Min dihedral angle";
+	case QUALITY_MAX_DIHEDRAL:
+		return "Max dihedral angle";
+	case QUALITY_RADIUS_EDGE_RATIO:
+		return "Radius-edge ratio";
+	case QUALITY_ASPECT_RATIO:
+		return "Aspect ratio";
+	default:
+		break;
+	}
+	return "Unknown";
+}
+
+void TetraTools::TetraQuality::ComputeHistogram(const QualityMetric metric_, const unsigned int numBins_, const float min_, const float max_, std::vector<unsigned int>& bins_) const
+{
+	bins_.assign(numBins_, 0);
+	const std::vector<float>& values = _values[metric_];
+	if (numBins_ == 0 || values.empty())
+		return;
+	const float scale = (max_ > min_) ? numBins_ / (max_ - min_) : 0.0f;
+	std::mutex mutex;
+	ParallelFor(0, values.size(), [&](size_t b_, size_t e_)
+	{
+		std::vector<unsigned int> bins(numBins_, 0);
+		for (size_t i=b_; i<e_; ++i)
+		{
+			/// NaN and infinite values have no bin, converting them to an index is undefined
+			if (!(fabsf(values[i]) <= FLT_MAX))
+				continue;
+			const float bin = (values[i] - min_) * scale;
+			const unsigned int b = (bin <= 0.0f) ? 0 : std::min(numBins_ - 1, (unsigned int)std::min(bin, (float)numBins_));
+			++bins[b];
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (unsigned int b=0; b<numBins_; ++b)
+		{
+			bins_[b] += bins[b];
+		}
+	});
+}
+
+void TetraTools::TetraQuality::GetWorst(const QualityMetric metric_, const size_t count_, std::vector<unsigned int>& indices_) const
+{
+	const std::vector<float>& values = _values[metric_];
+	const size_t count = std::min(count_, values.size());
+	indices_.resize(values.size());
+	for (size_t i=0; i<values.size(); ++i)
+	{
+		indices_[i] = (unsigned int)i;
+	}
+	const bool lowerWorse = IsLowerWorse(metric_);
+	std::partial_sort(indices_.begin(), indices_.begin() + count, indices_.end(), [&](const unsigned int a_, const unsigned int b_)
+	{
+		if (values[a_] != values[b_])
+			return lowerWorse ? (values[a_] < values[b_]) : (values[a_] > values[b_]);
+		return a_ < b_;
+	});
+	indices_.resize(count);
+}
+
+void TetraTools::TetraQuality::PrintReport(std::ostream& out_) const
+{
+	out_<<"Tetrahedron quality for "<<GetNumTetras()<<" tetrahedra:"<<std::endl;
+	for (unsigned int m=0; m<QUALITY_NUM_METRICS; ++m)
+	{
+		const QualityStatistics stats = GetStatistics((QualityMetric)m);
+		out_<<"\t"<<GetMetricName((QualityMetric)m)<<": min "<<stats.min<<" max "<<stats.max<<" mean "<<stats.mean<<std::endl;
+	}
+	out_<<"\tInverted: "<<_numInverted<<", slivers (min dihedral < "<<_sliverAngle<<"): "<<_numSlivers<<std::endl;
+	const QualityMetric angles[2] = { QUALITY_MIN_DIHEDRAL, QUALITY_MAX_DIHEDRAL };
+	for (unsigned int a=0; a<2; ++a)
+	{
+		std::vector<unsigned int> bins;
+		ComputeHistogram(angles[a], 18, 0.0f, 180.0f, bins);
+		out_<<"\t"<<GetMetricName(angles[a])<<" histogram:"<<std::endl;
+		for (unsigned int b=0; b<bins.size(); ++b)
+		{
+			if (bins[b] > 0)
+				out_<<"\t\t["<<(b * 10)<<", "<<((b + 1) * 10)<<"): "<<bins[b]<<std::endl;
+		}
+	}
+}
@@ -0,0 +1,186 @@
+/*
+ * TetraSmoothing.cpp
+ *
+ * Colour-parallel Laplacian and ODT smoothing of interior vertices.
+ */
+
+#include "TetraSmoothing.h"
+#include "ParallelUtils.h"
+#include <algorithm>
+#include <mutex>
+#ifndef WIN32
+#include <cfloat>
+#include <math.h>
+#else
+#include <float.h>
+#endif
+
+namespace
+{
+	/// six times the signed volume, positive for positively oriented tetrahedra
+	inline float SignedVolume6(const Vec3f& p0_, const Vec3f& p1_, const Vec3f& p2_, const Vec3f& p3_)
+	{
+		return (p1_ - p0_).dot((p2_ - p0_).cross(p3_ - p0_));
+	}
+
+	/**
+	 * Vertex v_ of tet_ replaced by position_.
+	 */
+	inline float SignedVolume6(const std::vector<Vec3f>& positions_, const Tetrahedron& tet_, const unsigned int v_, const Vec3f& position_)
+	{
+		const Vec3f& p0 = (tet_.index[0] == v_) ? position_ : positions_[tet_.index[0]];
+		const Vec3f& p1 = (tet_.index[1] == v_) ? position_ : positions_[tet_.index[1]];
+		const Vec3f& p2 = (tet_.index[2] == v_) ? position_ : positions_[tet_.index[2]];
+		const Vec3f& p3 = (tet_.index[3] == v_) ? position_ : positions_[tet_.index[3]];
+		return SignedVolume6(p0, p1, p2, p3);
+	}
+
+	/**
+	 * Adds the circumcentre of the tetrahedron, weighted by its volume, to sum_.
+	 * Returns the weight (0 for degenerate or inverted tetrahedra).
+	 */
+	inline float AccumulateCircumcentre(const Vec3f& p0_, const Vec3f& p1_, const Vec3f& p2_, const Vec3f& p3_, Vec3f& sum_)
+	{
+		const Vec3f a = p1_ - p0_;
+		const Vec3f b = p2_ - p0_;
+		const Vec3f c = p3_ - p0_;
+		const Vec3f bc = b.cross(c);
+		const float det = a.dot(bc);
+		if (det <= FLT_MIN)
+			return 0.0f;
+		/// p0 + (|a|^2 (b x c) + |b|^2 (c x a) + |c|^2 (a x b)) / (2 det), weighted by det / 6
+		const Vec3f offset = (bc * a.dot(a) + c.cross(a) * b.dot(b) + a.cross(b) * c.dot(c)) * 0.5f;
+		sum_ += p0_ * det + offset;
+		return det;
+	}
+}
+
+TetraTools::TetraSmoother::TetraSmoother()
+	: _method(SMOOTHING_ODT), _numIterations(5), _relaxation(1.0f), _numBacktracks(3)
+{
+}
+
+TetraTools::SmoothingStatistics TetraTools::TetraSmoother::Smooth(TetrahedronTopology& topology_)
+{
+	SmoothingStatistics stats;
+	stats.numInteriorVertices = 0;
+	stats.numMoved = 0;
+	stats.numRejected = 0;
+	stats.maxDisplacement = 0.0f;
+
+	const TetrahedronTopology& topology = topology_;
+	std::vector<Vec3f> positions(topology.GetVertices());
+	const size_t numVerts = positions.size();
+	if (numVerts == 0 || topology_.GetNumTetras() == 0 || _numIterations == 0)
+		return stats;
+	std::cout<<"Smoothing interior vertices ("<<((_method == SMOOTHING_ODT) ? "ODT" : "Laplacian")<<", "<<_numIterations<<" iterations)..."<<std::endl;
+
+	const std::vector<Tetrahedron>& tetras = topology_.GetTetrahedra();
+	const std::vector<TetrahedronVertex>& tetrasPerVertex = topology_.GetTetrasPerVertices();
+	const std::vector<PrimitivesPerVertex>& tetraLookup = topology_.GetTetrasPerVertexLookupTable();
+	const std::vector<unsigned int>& neighbourOffsets = topology_.GetVertexNeighboursOffsets();
+	const std::vector<unsigned int>& neighbours = topology_.GetVertexNeighbours();
+	const std::vector<unsigned int>& colourOffsets = topology_.GetVertexColourOffsets();
+	const std::vector<unsigned int>& colourOrder = topology_.GetVertexColourOrder();
+
+	/// vertices on the surface and vertices without tetrahedra stay fixed
+	std::vector<unsigned char> movable(numVerts, 0);
+	for (size_t i=0; i<numVerts; ++i)
+	{
+		movable[i] = (tetraLookup[i].length > 0) ? 1 : 0;
+	}
+	const std::vector<Triangle>& surface = topology_.GetSurfaceTriangles();
+	for (size_t i=0; i<surface.size(); ++i)
+	{
+		for (unsigned int j=0; j<3; ++j)
+			movable[surface[i].index[j]] = 0;
+	}
+	for (size_t i=0; i<numVerts; ++i)
+	{
+		stats.numInteriorVertices += movable[i];
+	}
+
+	std::mutex mutex;
+	const unsigned int numColours = colourOffsets.size() - 1;
+	for (unsigned int iteration=0; iteration<_numIterations; ++iteration)
+	{
+		float maxDisplacement = 0.0f;
+		for (unsigned int colour=0; colour<numColours; ++colour)
+		{
+			/// no two vertices of this colour share a tetrahedron, so every move only touches its own entry
+			ParallelFor(colourOffsets[colour], colourOffsets[colour+1], [&](size_t b_, size_t e_)
+			{
+				size_t numMoved = 0;
+				size_t numRejected = 0;
+				float maxSqDisplacement = 0.0f;
+				for (size_t k=b_; k<e_; ++k)
+				{
+					const unsigned int v = colourOrder[k];
+					if (!movable[v])
+						continue;
+					const Vec3f& current = positions[v];
+					const PrimitivesPerVertex& range = tetraLookup[v];
+
+					Vec3f target(0.0f, 0.0f, 0.0f);
+					if (_method == SMOOTHING_ODT)
+					{
+						float weight = 0.0f;
+						for (PrimitiveOffset t=range.offset; t<range.offset+range.length; ++t)
+						{
+							const Tetrahedron& tet = tetras[tetrasPerVertex[t].tetraIndex];
+							weight += AccumulateCircumcentre(positions[tet.index[0]], positions[tet.index[1]], positions[tet.index[2]], positions[tet.index[3]], target);
+						}
+						if (weight <= 0.0f)
+							continue;
+						target /= weight;
+					}
+					else
+					{
+						const unsigned int first = neighbourOffsets[v];
+						const unsigned int last = neighbourOffsets[v+1];
+						if (first == last)
+							continue;
+						for (unsigned int n=first; n<last; ++n)
+							target += positions[neighbours[n]];
+						target /= (float)(last - first);
+					}
+
+					/// try the full step first and halve it while it inverts a tetrahedron
+					const Vec3f step = (target - current) * _relaxation;
+					float scale = 1.0f;
+					bool accepted = false;
+					Vec3f candidate;
+					for (unsigned int attempt=0; attempt<=_numBacktracks && !accepted; ++attempt, scale *= 0.5f)
+					{
+						candidate = current + step * scale;
+						accepted = true;
+						for (PrimitiveOffset t=range.offset; t<range.offset+range.length && accepted; ++t)
+						{
+							const Tetrahedron& tet = tetras[tetrasPerVertex[t].tetraIndex];
+							const float after = SignedVolume6(positions, tet, v, candidate);
+							if (after <= 0.0f && after < SignedVolume6(positions, tet, v, current))
+								accepted = false;
+						}
+					}
+					if (!accepted)
+					{
+						++numRejected;
+						continue;
+					}
+					maxSqDisplacement = std::max(maxSqDisplacement, (candidate - current).squaredLength());
+					positions[v] = candidate;
+					++numMoved;
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				stats.numMoved += numMoved;
+				stats.numRejected += numRejected;
+				maxDisplacement = std::max(maxDisplacement, maxSqDisplacement);
+			}, 256);
+		}
+		stats.maxDisplacement = sqrtf(maxDisplacement);
+	}
+	std::cout<<"\tInterior vertices: "<<stats.numInteriorVertices<<", moves: "<<stats.numMoved<<", rejected: "<<stats.numRejected<<std::endl;
+
+	topology_.UpdateVertices(positions);
+	return stats;
+}
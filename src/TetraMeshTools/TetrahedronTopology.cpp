@@ -6,8 +6,11 @@
  */
 
 #include "TetrahedronTopology.h"
+#include "ParallelUtils.h"
 #include <map>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #ifndef WIN32
 #include <cfloat>
 #include <math.h>
@@ -28,6 +31,14 @@ TetraTools::TetrahedronTopology::TetrahedronTopology(	const std::vector<Vec3f>&
 	Init(vertices_, tetras_, complete_);
 }
 
+TetraTools::TetrahedronTopology::TetrahedronTopology(	std::vector<Vec3f>&& vertices_,
+														std::vector<Tetrahedron>&& tetras_,
+														const bool complete_)
+{
+	Clear();
+	Init(std::move(vertices_), std::move(tetras_), complete_);
+}
+
 TetraTools::TetrahedronTopology::~TetrahedronTopology()
 {
 	Clear();
@@ -37,21 +48,26 @@ void TetraTools::TetrahedronTopology::Init(	const std::vector<Vec3f>& vertices_,
 											const std::vector<Tetrahedron>& tetras_,
 											const bool complete_)
 {
-	/// generate Bounding Box
+	std::vector<Vec3f> vertices(vertices_);
+	std::vector<Tetrahedron> tetras(tetras_);
+	Init(std::move(vertices), std::move(tetras), complete_);
+}
+
+void TetraTools::TetrahedronTopology::Init(	std::vector<Vec3f>&& vertices_,
+											std::vector<Tetrahedron>&& tetras_,
+											const bool complete_)
+{
 	Clear();
-	//GenerateBoundingBox(vertices_);
-	for (unsigned int i=0; i<vertices_.size(); ++i)
-	{
-		_vertices.push_back(vertices_[i]);
-	}
+	/// take over the buffers, the caller's vectors are left empty
+	_vertices.swap(vertices_);
+	_tetrahedra.swap(tetras_);
+	vertices_.clear();
+	tetras_.clear();
+	/// generate Bounding Box
 	GenerateBoundingBox();
-	std::cout<<"Num Tetras: "<<tetras_.size()<<std::endl;
-	for (unsigned int i=0; i<tetras_.size(); ++i)
-	{
-		_tetrahedra.push_back(tetras_[i]);
-	}
+	std::cout<<"Num Tetras: "<<_tetrahedra.size()<<std::endl;
 	GenerateTriangles();
-	GenerateEdges();
+	EnsureEdges();
 	if (complete_)
 	{
 		//GenerateEdgeMap();
@@ -80,6 +96,431 @@ void TetraTools::TetrahedronTopology::Clear()
 	_vertexTetrahedraLookup.clear();
 	_surfaceTriangles.clear();
 	_tetraTriangles.clear();
+	_vertexNeighboursOffsets.clear();
+	_vertexNeighbours.clear();
+	_tetraCentroids.clear();
+	_vertexColourOffsets.clear();
+	_vertexColourOrder.clear();
+	_tetraColourOffsets.clear();
+	_tetraColourOrder.clear();
+	_edgeIndexTable.clear();
+	_normals.clear();
+	_dirtyVertices.clear();
+	_numDirtyVertices = 0;
+	_vertexSoA.Clear();
+	InvalidateAll();
+}
+
+void TetraTools::TetrahedronTopology::SetEdges(const std::vector<Edge>& edges_)
+{
+	TriangleTopology::SetEdges(edges_);
+	_tetraEdges.clear();
+	_vertexNeighboursOffsets.clear();
+	_vertexNeighbours.clear();
+	_vertexColourOffsets.clear();
+	_vertexColourOrder.clear();
+}
+
+void TetraTools::TetrahedronTopology::InvalidateEdgeData()
+{
+	TriangleTopology::InvalidateEdgeData();
+	_tetraEdgesFlag.Invalidate();
+	_vertexNeighboursFlag.Invalidate();
+	_vertexColoursFlag.Invalidate();
+}
+
+void TetraTools::TetrahedronTopology::InvalidateAll()
+{
+	TriangleTopology::InvalidateAll();
+	_tetraMapFlag.Invalidate();
+	_surfaceTrianglesFlag.Invalidate();
+	_tetraTrianglesFlag.Invalidate();
+	_tetraCentroidsFlag.Invalidate();
+	_tetraColoursFlag.Invalidate();
+}
+
+void TetraTools::TetrahedronTopology::CollectGenerators(const unsigned int structures_, std::vector<std::function<void()> >& tasks_)
+{
+	TriangleTopology::CollectGenerators(structures_, tasks_);
+	if (structures_ & TOPOLOGY_TETRA_EDGES)
+		tasks_.push_back([this]() { GetTetraEdges(); });
+	if (structures_ & TOPOLOGY_TETRA_MAP)
+		tasks_.push_back([this]() { GetTetrasPerVertices(); });
+	if (structures_ & TOPOLOGY_SURFACE_TRIANGLES)
+		tasks_.push_back([this]() { GetSurfaceTriangles(); });
+	if (structures_ & TOPOLOGY_TETRA_TRIANGLES)
+		tasks_.push_back([this]() { GetTetraTriangles(); });
+	if (structures_ & TOPOLOGY_VERTEX_NEIGHBOURS)
+		tasks_.push_back([this]() { GetVertexNeighbours(); });
+	if (structures_ & TOPOLOGY_TETRA_CENTROIDS)
+		tasks_.push_back([this]() { GetTetraCentroids(); });
+	if (structures_ & TOPOLOGY_VERTEX_COLOURS)
+		tasks_.push_back([this]() { GetVertexColourOrder(); });
+	if (structures_ & TOPOLOGY_TETRA_COLOURS)
+		tasks_.push_back([this]() { GetTetraColourOrder(); });
+}
+
+unsigned int TetraTools::TetrahedronTopology::GetGeneratedStructures() const
+{
+	unsigned int structures = TriangleTopology::GetGeneratedStructures();
+	if (_tetraEdgesFlag.IsValid())
+		structures |= TOPOLOGY_TETRA_EDGES;
+	if (_tetraMapFlag.IsValid())
+		structures |= TOPOLOGY_TETRA_MAP;
+	if (_surfaceTrianglesFlag.IsValid())
+		structures |= TOPOLOGY_SURFACE_TRIANGLES;
+	if (_tetraTrianglesFlag.IsValid())
+		structures |= TOPOLOGY_TETRA_TRIANGLES;
+	if (_vertexNeighboursFlag.IsValid())
+		structures |= TOPOLOGY_VERTEX_NEIGHBOURS;
+	if (_tetraCentroidsFlag.IsValid())
+		structures |= TOPOLOGY_TETRA_CENTROIDS;
+	if (_vertexColoursFlag.IsValid())
+		structures |= TOPOLOGY_VERTEX_COLOURS;
+	if (_tetraColoursFlag.IsValid())
+		structures |= TOPOLOGY_TETRA_COLOURS;
+	return structures;
+}
+
+namespace
+{
+	/// checks that permutation_ is empty (identity) or a bijection on [0, size_)
+	bool IsValidPermutation(const std::vector<unsigned int>& permutation_, const size_t size_)
+	{
+		if (permutation_.empty())
+			return true;
+		if (permutation_.size() != size_)
+			return false;
+		std::vector<unsigned char> used(size_, 0);
+		for (size_t i=0; i<size_; ++i)
+		{
+			const unsigned int p = permutation_[i];
+			if (p >= size_ || used[p])
+				return false;
+			used[p] = 1;
+		}
+		return true;
+	}
+
+	/**
+	 * Sorted vertex indices of a tetrahedron face and the face (4 * tetrahedron + face) it was taken from.
+	 */
+	struct TetraFaceKey
+	{
+		unsigned int v[3];
+		unsigned int tetFace;
+
+		bool operator<(const TetraFaceKey& f_) const
+		{
+			if (v[0] != f_.v[0])
+				return v[0] < f_.v[0];
+			if (v[1] != f_.v[1])
+				return v[1] < f_.v[1];
+			if (v[2] != f_.v[2])
+				return v[2] < f_.v[2];
+			return tetFace < f_.tetFace;
+		}
+
+		bool SameFace(const TetraFaceKey& f_) const
+		{
+			return v[0] == f_.v[0] && v[1] == f_.v[1] && v[2] == f_.v[2];
+		}
+	};
+
+	/**
+	 * Face f_ of t_ as GenerateTriangles stores it: same orientation, smallest index first.
+	 */
+	Triangle TetraFaceTriangle(const Tetrahedron& t_, const unsigned int f_)
+	{
+		unsigned int v[3], val;
+		v[0] = t_.index[(f_+1)%4];
+		if (f_%2)
+		{
+			v[1] = t_.index[(f_+2)%4];
+			v[2] = t_.index[(f_+3)%4];
+		}
+		else
+		{
+			v[2] = t_.index[(f_+2)%4];
+			v[1] = t_.index[(f_+3)%4];
+		}
+		while ((v[0]>v[1]) || (v[0]>v[2]))
+		{
+			val = v[0];
+			v[0] = v[1];
+			v[1] = v[2];
+			v[2] = val;
+		}
+		return Triangle(v[0], v[2], v[1]);
+	}
+
+	/**
+	 * Parallel counterpart of GenerateTriangles, GenerateTetraTriangles and GenerateSurfaceTriangles
+	 * with the same results. The faces of all tetrahedra are sorted by their vertices, every distinct
+	 * face becomes one triangle in the orientation of the first tetrahedron that has it, and the faces
+	 * of only one tetrahedron are the surface triangles. tetraTriangles_ and surfaceTriangles_ may be NULL.
+	 */
+	void GenerateTetraFaces(const std::vector<Tetrahedron>& tetras_,
+							std::vector<Triangle>& triangles_,
+							std::vector<TetraTools::TetrahedronTriangles>* tetraTriangles_,
+							std::vector<Triangle>* surfaceTriangles_)
+	{
+		using namespace TetraTools;
+		const size_t numTetras = tetras_.size();
+		std::vector<TetraFaceKey> faces(4 * numTetras);
+		ParallelFor(0, numTetras, [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				const Tetrahedron& t = tetras_[i];
+				for (unsigned int j=0; j<4; ++j)
+				{
+					TetraFaceKey& f = faces[4 * i + j];
+					f.v[0] = t.index[(j+1)%4];
+					f.v[1] = t.index[(j+2)%4];
+					f.v[2] = t.index[(j+3)%4];
+					std::sort(f.v, f.v + 3);
+					f.tetFace = (unsigned int)(4 * i + j);
+				}
+			}
+		});
+		ParallelSort(faces.begin(), faces.end(), [](const TetraFaceKey& a_, const TetraFaceKey& b_) { return a_ < b_; });
+
+		/// first entry of every distinct face, counted and written per chunk of the sorted faces
+		const size_t chunkSize = 65536;
+		const size_t numChunks = (faces.size() + chunkSize - 1) / chunkSize;
+		std::vector<size_t> chunkOffsets(numChunks + 1, 0);
+		ParallelFor(0, numChunks, [&](size_t b_, size_t e_)
+		{
+			for (size_t c=b_; c<e_; ++c)
+			{
+				for (size_t i=c * chunkSize; i<std::min(faces.size(), (c + 1) * chunkSize); ++i)
+				{
+					if (i == 0 || !faces[i].SameFace(faces[i-1]))
+						++chunkOffsets[c + 1];
+				}
+			}
+		}, 1);
+		for (size_t c=0; c<numChunks; ++c)
+		{
+			chunkOffsets[c + 1] += chunkOffsets[c];
+		}
+		const size_t numTriangles = chunkOffsets[numChunks];
+		std::vector<unsigned int> firstFaces(numTriangles + 1, (unsigned int)faces.size());
+		ParallelFor(0, numChunks, [&](size_t b_, size_t e_)
+		{
+			for (size_t c=b_; c<e_; ++c)
+			{
+				size_t g = chunkOffsets[c];
+				for (size_t i=c * chunkSize; i<std::min(faces.size(), (c + 1) * chunkSize); ++i)
+				{
+					if (i == 0 || !faces[i].SameFace(faces[i-1]))
+						firstFaces[g++] = (unsigned int)i;
+				}
+			}
+		}, 1);
+
+		/// the triangles are kept sorted, as GenerateTriangles does
+		std::vector<std::pair<Triangle, unsigned int> > ordered(numTriangles);
+		ParallelFor(0, numTriangles, [&](size_t b_, size_t e_)
+		{
+			for (size_t g=b_; g<e_; ++g)
+			{
+				const unsigned int tetFace = faces[firstFaces[g]].tetFace;
+				ordered[g] = std::make_pair(TetraFaceTriangle(tetras_[tetFace / 4], tetFace % 4), (unsigned int)g);
+			}
+		});
+		ParallelSort(ordered.begin(), ordered.end(), std::less<std::pair<Triangle, unsigned int> >());
+		triangles_.resize(numTriangles);
+		std::vector<unsigned int> triangleIndices(numTriangles);
+		ParallelFor(0, numTriangles, [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				triangles_[i] = ordered[i].first;
+				triangleIndices[ordered[i].second] = (unsigned int)i;
+			}
+		});
+		if (tetraTriangles_ != NULL)
+		{
+			tetraTriangles_->resize(numTetras);
+			ParallelFor(0, numTriangles, [&](size_t b_, size_t e_)
+			{
+				for (size_t g=b_; g<e_; ++g)
+				{
+					for (unsigned int i=firstFaces[g]; i<firstFaces[g + 1]; ++i)
+					{
+						(*tetraTriangles_)[faces[i].tetFace / 4].index[faces[i].tetFace % 4] = triangleIndices[g];
+					}
+				}
+			});
+		}
+		if (surfaceTriangles_ != NULL)
+		{
+			surfaceTriangles_->clear();
+			for (size_t i=0; i<numTriangles; ++i)
+			{
+				const unsigned int g = ordered[i].second;
+				if (firstFaces[g + 1] - firstFaces[g] == 1)
+					surfaceTriangles_->push_back(ordered[i].first);
+			}
+		}
+	}
+}
+
+bool TetraTools::TetrahedronTopology::ApplyPermutation(	const std::vector<unsigned int>& vertexPermutation_,
+														const std::vector<unsigned int>& tetraPermutation_)
+{
+	if (!IsValidPermutation(vertexPermutation_, _vertices.size()))
+	{
+		std::cerr<<"ERROR! Cannot apply vertex permutation. Expected a permutation of "<<_vertices.size()<<" vertices!"<<std::endl;
+		return false;
+	}
+	if (!IsValidPermutation(tetraPermutation_, _tetrahedra.size()))
+	{
+		std::cerr<<"ERROR! Cannot apply tetrahedron permutation. Expected a permutation of "<<_tetrahedra.size()<<" tetrahedra!"<<std::endl;
+		return false;
+	}
+	std::cout<<"Renumbering "<<_vertices.size()<<" vertices and "<<_tetrahedra.size()<<" tetrahedra..."<<std::endl;
+	/// remember what the caller had generated so far, everything else stays lazy
+	const unsigned int generated = GetGeneratedStructures();
+	const bool hasVertexPermutation = !vertexPermutation_.empty();
+	const bool hasTetraPermutation = !tetraPermutation_.empty();
+
+	std::vector<Vec3f> vertices(_vertices.size());
+	ParallelFor(0, _vertices.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			vertices[hasVertexPermutation ? vertexPermutation_[i] : i] = _vertices[i];
+		}
+	});
+	std::vector<Tetrahedron> tetras(_tetrahedra.size());
+	ParallelFor(0, _tetrahedra.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			Tetrahedron t = _tetrahedra[i];
+			if (hasVertexPermutation)
+			{
+				for (unsigned int j=0; j<4; ++j)
+				{
+					t.index[j] = vertexPermutation_[t.index[j]];
+				}
+			}
+			tetras[hasTetraPermutation ? tetraPermutation_[i] : i] = t;
+		}
+	});
+
+	/// the triangles (and the per tetrahedron and surface triangles, if they were generated) have to be
+	/// re-derived, as their orientation and order depend on the numbering of the tetrahedra
+	std::vector<Triangle> triangles;
+	std::vector<TetrahedronTriangles> tetraTriangles;
+	std::vector<Triangle> surfaceTriangles;
+	GenerateTetraFaces(	tetras, triangles,
+						(generated & TOPOLOGY_TETRA_TRIANGLES) ? &tetraTriangles : NULL,
+						(generated & TOPOLOGY_SURFACE_TRIANGLES) ? &surfaceTriangles : NULL);
+	/// the edges are relabelled, ordered and sorted again, which gives the list GenerateEdges would build
+	std::vector<Edge> edges;
+	if (generated & TOPOLOGY_EDGES)
+	{
+		edges.resize(_edges.size());
+		ParallelFor(0, _edges.size(), [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				Edge e = _edges[i];
+				if (hasVertexPermutation)
+				{
+					e = Edge(vertexPermutation_[e.index[0]], vertexPermutation_[e.index[1]]);
+					OrderEdge(e);
+				}
+				edges[i] = e;
+			}
+		});
+		if (hasVertexPermutation)
+			ParallelSort(edges.begin(), edges.end(), std::less<Edge>());
+	}
+	std::vector<Vec3f> centroids;
+	if (generated & TOPOLOGY_TETRA_CENTROIDS)
+	{
+		centroids.resize(_tetraCentroids.size());
+		ParallelFor(0, _tetraCentroids.size(), [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				centroids[hasTetraPermutation ? tetraPermutation_[i] : i] = _tetraCentroids[i];
+			}
+		});
+	}
+
+	/// the vertex positions do not change, so the bounding volumes are kept
+	Clear();
+	_vertices.swap(vertices);
+	_tetrahedra.swap(tetras);
+	_triangles.swap(triangles);
+	if (generated & TOPOLOGY_EDGES)
+	{
+		_edges.swap(edges);
+		_edgesFlag.SetValid();
+	}
+	if (generated & TOPOLOGY_TETRA_TRIANGLES)
+	{
+		_tetraTriangles.swap(tetraTriangles);
+		_tetraTrianglesFlag.SetValid();
+	}
+	if (generated & TOPOLOGY_SURFACE_TRIANGLES)
+	{
+		_surfaceTriangles.swap(surfaceTriangles);
+		_surfaceTrianglesFlag.SetValid();
+	}
+	if (generated & TOPOLOGY_TETRA_CENTROIDS)
+	{
+		_tetraCentroids.swap(centroids);
+		_tetraCentroidsFlag.SetValid();
+	}
+	/// everything else is rebuilt from the renumbered lists with the linear (counting sort, hash
+	/// and CSR) generators
+	EnsureAll(generated, true);
+	return true;
+}
+
+void TetraTools::TetrahedronTopology::ReorderAlongCurve(const SpaceFillingCurve curve_,
+														std::vector<unsigned int>& vertexPermutation_,
+														std::vector<unsigned int>& tetraPermutation_)
+{
+	std::cout<<"Generating "<<((curve_ == CURVE_HILBERT) ? "Hilbert" : "Morton")<<" curve ordering..."<<std::endl;
+	ComputeCurvePermutation(_vertices, bb, curve_, vertexPermutation_);
+	/// local centroids, so that the cached ones are not generated just for the reordering
+	std::vector<Vec3f> centroids(_tetrahedra.size());
+	ParallelFor(0, _tetrahedra.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const Tetrahedron& t = _tetrahedra[i];
+			centroids[i] = Tetrahedron::Centroid(_vertices[t.index[0]], _vertices[t.index[1]], _vertices[t.index[2]], _vertices[t.index[3]]);
+		}
+	});
+	ComputeCurvePermutation(centroids, bb, curve_, tetraPermutation_);
+	ApplyPermutation(vertexPermutation_, tetraPermutation_);
+}
+
+TetraTools::BandwidthInfo TetraTools::TetrahedronTopology::GetBandwidthInfo()
+{
+	return ComputeBandwidth(GetVertexNeighboursOffsets(), GetVertexNeighbours(), std::vector<unsigned int>());
+}
+
+void TetraTools::TetrahedronTopology::ReorderReverseCuthillMcKee(std::vector<unsigned int>& vertexPermutation_)
+{
+	std::cout<<"Generating Reverse Cuthill-McKee ordering..."<<std::endl;
+	const std::vector<unsigned int>& offsets = GetVertexNeighboursOffsets();
+	const std::vector<unsigned int>& neighbours = GetVertexNeighbours();
+	const BandwidthInfo before = ComputeBandwidth(offsets, neighbours, std::vector<unsigned int>());
+	ComputeReverseCuthillMcKee(offsets, neighbours, vertexPermutation_);
+	const BandwidthInfo after = ComputeBandwidth(offsets, neighbours, vertexPermutation_);
+	std::cout<<"\tBandwidth: "<<before.bandwidth<<" -> "<<after.bandwidth<<std::endl;
+	std::cout<<"\tProfile: "<<before.profile<<" -> "<<after.profile<<std::endl;
+	ApplyPermutation(vertexPermutation_, std::vector<unsigned int>());
 }
 
 void TetraTools::TetrahedronTopology::GenerateTriangles()
@@ -149,123 +590,77 @@ void TetraTools::TetrahedronTopology::GenerateTetraEdges()
 	std::cout<<"Generating TetraEdges..."<<std::endl;
 	if (_tetraEdges.size() != 0)
 		_tetraEdges.clear();
-	/// generate Edge map for faster lookup
-	std::map<Edge, unsigned int> edgeMap;
-	std::map<Edge, unsigned int>::iterator itt;
-	for (unsigned int i=0; i<_edges.size(); ++i)
+	EnsureEdges();
+	EnsureEdgeIndex();
+	_tetraEdges.resize(_tetrahedra.size());
+	ParallelFor(0, _tetrahedra.size(), [this](size_t b_, size_t e_)
 	{
-		const Edge& e = _edges[i];
-		edgeMap[e] = i;
-	}
-	Edge tmpEdge;
-	for (unsigned int i=0; i<_tetrahedra.size(); ++i)
-	{
-		const Tetrahedron& t = _tetrahedra[i];
-		TetrahedronEdges te;
-
-		/// find the six edges in the edge map
-		/// swap edge indices so that the smaller index is in the first position
-		tmpEdge.index[0] = t.index[0];
-		tmpEdge.index[1] = t.index[1];
-		OrderEdge(tmpEdge);
-		itt = edgeMap.find(tmpEdge);
-		te.index[0] = itt->second;
-
-		tmpEdge.index[0] = t.index[0];
-		tmpEdge.index[1] = t.index[2];
-		OrderEdge(tmpEdge);
-		itt = edgeMap.find(tmpEdge);
-		te.index[1] = itt->second;
-
-		tmpEdge.index[0] = t.index[0];
-		tmpEdge.index[1] = t.index[3];
-		OrderEdge(tmpEdge);
-		itt = edgeMap.find(tmpEdge);
-		te.index[2] = itt->second;
-
-		tmpEdge.index[0] = t.index[1];
-		tmpEdge.index[1] = t.index[2];
-		OrderEdge(tmpEdge);
-		itt = edgeMap.find(tmpEdge);
-		te.index[3] = itt->second;
-
-		tmpEdge.index[0] = t.index[1];
-		tmpEdge.index[1] = t.index[3];
-		OrderEdge(tmpEdge);
-		itt = edgeMap.find(tmpEdge);
-		te.index[4] = itt->second;
-
-		tmpEdge.index[0] = t.index[2];
-		tmpEdge.index[1] = t.index[3];
-		OrderEdge(tmpEdge);
-		itt = edgeMap.find(tmpEdge);
-		te.index[5] = itt->second;
-
-		_tetraEdges.push_back(te);
-	}
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const Tetrahedron& t = _tetrahedra[i];
+			TetrahedronEdges& te = _tetraEdges[i];
+			/// same edge order as before: 01, 02, 03, 12, 13, 23
+			te.index[0] = LookupEdge(t.index[0], t.index[1]);
+			te.index[1] = LookupEdge(t.index[0], t.index[2]);
+			te.index[2] = LookupEdge(t.index[0], t.index[3]);
+			te.index[3] = LookupEdge(t.index[1], t.index[2]);
+			te.index[4] = LookupEdge(t.index[1], t.index[3]);
+			te.index[5] = LookupEdge(t.index[2], t.index[3]);
+		}
+	});
 }
 
 void TetraTools::TetrahedronTopology::GenerateTetrahedronMap()
 {
 	std::cout<<"Generating TetraMap..."<<std::endl;
-	unsigned int numVerts = _vertices.size();
-	unsigned int numTetras = _tetrahedra.size();
-	unsigned int offset = 0;
+	_tetraVertices.clear();
+	_vertexTetrahedraLookup.clear();
+	const unsigned int numVerts = _vertices.size();
+	const unsigned int numTetras = _tetrahedra.size();
+	/// counting sort by vertex index: entries per vertex stay ordered by tetrahedron index
+	_vertexTetrahedraLookup.resize(numVerts);
+	for (unsigned int i=0; i<numVerts; ++i) {
+		_vertexTetrahedraLookup[i].offset = 0;
+		_vertexTetrahedraLookup[i].length = 0;
+	}
+	for (unsigned int j=0; j<numTetras; ++j) {
+		const Tetrahedron& t = _tetrahedra[j];
+		++_vertexTetrahedraLookup[t.index[0]].length;
+		++_vertexTetrahedraLookup[t.index[1]].length;
+		++_vertexTetrahedraLookup[t.index[2]].length;
+		++_vertexTetrahedraLookup[t.index[3]].length;
+	}
+	PrimitiveOffset offset = 0;
 	unsigned int maxTetras = 0;
 	unsigned int tetrasMax = 0;
 	for (unsigned int i=0; i<numVerts; ++i) {
-		PrimitivesPerVertex vtMap;
-		unsigned int counter = 0;
-		vtMap.offset = offset;
-		for (unsigned int j=0; j<numTetras; ++j) {
-			const Tetrahedron& t = _tetrahedra[j];
-			unsigned int vertInTetra = 0;
-			TetrahedronVertex tetraVertex;
-			if (t.index[0] == i) {
-				tetraVertex.tetraIndex = j;
-				tetraVertex.indexInTetra = vertInTetra;
-				++counter;
-				++offset;
-				_tetraVertices.push_back(tetraVertex);
-			}
-			++vertInTetra;
-			if (t.index[1] == i) {
-				tetraVertex.tetraIndex = j;
-				tetraVertex.indexInTetra = vertInTetra;
-				++counter;
-				++offset;
-				_tetraVertices.push_back(tetraVertex);
-			}
-			++vertInTetra;
-			if (t.index[2] == i) {
-				tetraVertex.tetraIndex = j;
-				tetraVertex.indexInTetra = vertInTetra;
-				++counter;
-				++offset;
-				_tetraVertices.push_back(tetraVertex);
-			}
-			++vertInTetra;
-			if (t.index[3] == i) {
-				tetraVertex.tetraIndex = j;
-				tetraVertex.indexInTetra = vertInTetra;
-				++counter;
-				++offset;
-				_tetraVertices.push_back(tetraVertex);
-			}
-		}
-		vtMap.length = counter;
-		_vertexTetrahedraLookup.push_back(vtMap);
-		if (counter >= maxTetras) {
-			maxTetras = counter;
+		_vertexTetrahedraLookup[i].offset = offset;
+		offset += _vertexTetrahedraLookup[i].length;
+		if (_vertexTetrahedraLookup[i].length >= maxTetras) {
+			maxTetras = _vertexTetrahedraLookup[i].length;
 			tetrasMax = i;
 		}
 	}
+	_tetraVertices.resize(offset);
+	std::vector<PrimitiveOffset> cursor(numVerts);
+	for (unsigned int i=0; i<numVerts; ++i) {
+		cursor[i] = _vertexTetrahedraLookup[i].offset;
+	}
+	for (unsigned int j=0; j<numTetras; ++j) {
+		const Tetrahedron& t = _tetrahedra[j];
+		for (unsigned int vertInTetra=0; vertInTetra<4; ++vertInTetra) {
+			TetrahedronVertex& tetraVertex = _tetraVertices[cursor[t.index[vertInTetra]]++];
+			tetraVertex.tetraIndex = j;
+			tetraVertex.indexInTetra = vertInTetra;
+		}
+	}
 	std::cout<<"\tMax number of tetrahedra connected to a vertex: "<<maxTetras<<" at Vertex: "<<tetrasMax<<std::endl;
 }
 
 void TetraTools::TetrahedronTopology::GenerateSurfaceTriangles()
 {
 	std::cout<<"Generating SurfaceTriangles from tetrahedra..."<<std::endl;
+	_surfaceTriangles.clear();
 	/// generate Triangle-To-Indices map for faster lookup
 	std::map<Triangle, unsigned int> triangleMap;
 	std::map<Triangle, unsigned int>::iterator itm;
@@ -418,3 +813,181 @@ void TetraTools::TetrahedronTopology::GenerateTetraTriangles()
 	}
 }
 
+
+void TetraTools::TetrahedronTopology::GenerateVertexNeighbours()
+{
+	std::cout<<"Generating VertexNeighbours..."<<std::endl;
+	_vertexNeighboursOffsets.clear();
+	_vertexNeighbours.clear();
+	const std::vector<Edge>& edges = GetEdges();
+	const size_t numVerts = _vertices.size();
+	const size_t numEdges = edges.size();
+	_vertexNeighboursOffsets.resize(numVerts + 1, 0);
+	if (numEdges == 0)
+		return;
+
+	/// count both directions of every edge per vertex
+	std::unique_ptr<std::atomic<unsigned int>[]> counts(new std::atomic<unsigned int>[numVerts]);
+	ParallelFor(0, numVerts, [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+			counts[i].store(0, std::memory_order_relaxed);
+	});
+	ParallelFor(0, numEdges, [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			counts[edges[i].index[0]].fetch_add(1, std::memory_order_relaxed);
+			counts[edges[i].index[1]].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+	std::vector<unsigned int> rawOffsets(numVerts + 1, 0);
+	for (size_t i=0; i<numVerts; ++i)
+	{
+		rawOffsets[i+1] = rawOffsets[i] + counts[i].load(std::memory_order_relaxed);
+		/// re-use the counters as fill cursors
+		counts[i].store(rawOffsets[i], std::memory_order_relaxed);
+	}
+
+	std::vector<unsigned int> raw(rawOffsets[numVerts]);
+	ParallelFor(0, numEdges, [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const Edge& e = edges[i];
+			raw[counts[e.index[0]].fetch_add(1, std::memory_order_relaxed)] = e.index[1];
+			raw[counts[e.index[1]].fetch_add(1, std::memory_order_relaxed)] = e.index[0];
+		}
+	});
+	counts.reset();
+
+	/// sort each row and drop duplicates (e.g. from edges set via SetEdges)
+	std::vector<unsigned int> uniqueCounts(numVerts);
+	ParallelFor(0, numVerts, [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			std::vector<unsigned int>::iterator first = raw.begin() + rawOffsets[i];
+			std::vector<unsigned int>::iterator last = raw.begin() + rawOffsets[i+1];
+			std::sort(first, last);
+			uniqueCounts[i] = std::unique(first, last) - first;
+		}
+	});
+	for (size_t i=0; i<numVerts; ++i)
+	{
+		_vertexNeighboursOffsets[i+1] = _vertexNeighboursOffsets[i] + uniqueCounts[i];
+	}
+	if (_vertexNeighboursOffsets[numVerts] == rawOffsets[numVerts])
+	{
+		_vertexNeighbours.swap(raw);
+	}
+	else
+	{
+		_vertexNeighbours.resize(_vertexNeighboursOffsets[numVerts]);
+		ParallelFor(0, numVerts, [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				std::copy(raw.begin() + rawOffsets[i], raw.begin() + rawOffsets[i] + uniqueCounts[i], _vertexNeighbours.begin() + _vertexNeighboursOffsets[i]);
+			}
+		});
+	}
+	std::cout<<"\tNum vertex neighbour entries: "<<_vertexNeighbours.size()<<std::endl;
+}
+
+void TetraTools::TetrahedronTopology::GenerateVertexColours()
+{
+	std::cout<<"Generating VertexColours..."<<std::endl;
+	std::vector<unsigned int> colours;
+	const unsigned int numColours = ComputeGraphColouring(GetVertexNeighboursOffsets(), GetVertexNeighbours(), colours);
+	GroupByColour(colours, numColours, _vertexColourOffsets, _vertexColourOrder);
+	std::cout<<"\tColours: "<<numColours<<std::endl;
+}
+
+namespace
+{
+	/**
+	 * Tetrahedra sharing a vertex with a given tetrahedron, for the colouring template.
+	 */
+	struct TetraVertexNeighbours
+	{
+		const std::vector<Tetrahedron>& tetras;
+		const std::vector<TetraTools::TetrahedronVertex>& tetrasPerVertex;
+		const std::vector<TetraTools::PrimitivesPerVertex>& lookup;
+
+		TetraVertexNeighbours(	const std::vector<Tetrahedron>& tetras_,
+								const std::vector<TetraTools::TetrahedronVertex>& tetrasPerVertex_,
+								const std::vector<TetraTools::PrimitivesPerVertex>& lookup_)
+			: tetras(tetras_), tetrasPerVertex(tetrasPerVertex_), lookup(lookup_)
+		{
+		}
+
+		template <typename Visitor>
+		void operator()(const unsigned int tetra_, const Visitor& visitor_) const
+		{
+			const Tetrahedron& t = tetras[tetra_];
+			for (unsigned int j=0; j<4; ++j)
+			{
+				const TetraTools::PrimitivesPerVertex& range = lookup[t.index[j]];
+				for (TetraTools::PrimitiveOffset k=range.offset; k<range.offset+range.length; ++k)
+					visitor_(tetrasPerVertex[k].tetraIndex);
+			}
+		}
+	};
+}
+
+void TetraTools::TetrahedronTopology::GenerateTetraColours()
+{
+	std::cout<<"Generating TetraColours..."<<std::endl;
+	const TetraVertexNeighbours neighbours(_tetrahedra, GetTetrasPerVertices(), GetTetrasPerVertexLookupTable());
+	std::vector<unsigned int> colours;
+	const unsigned int numColours = ComputeGraphColouring(_tetrahedra.size(), neighbours, colours);
+	GroupByColour(colours, numColours, _tetraColourOffsets, _tetraColourOrder);
+	std::cout<<"\tColours: "<<numColours<<std::endl;
+}
+
+void TetraTools::TetrahedronTopology::GenerateTetraCentroids(const bool onlyDirty_)
+{
+	const bool dirtyOnly = onlyDirty_ && _dirtyVertices.size() == _vertices.size();
+	_tetraCentroids.resize(_tetrahedra.size());
+	if (_vertexLayout == VERTEX_LAYOUT_SOA)
+	{
+		const VertexArraySoA& soa = GetVertexSoA();
+		const float* x = soa.X();
+		const float* y = soa.Y();
+		const float* z = soa.Z();
+		ParallelFor(0, _tetrahedra.size(), [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				const unsigned int* t = _tetrahedra[i].index;
+				if (dirtyOnly && !(_dirtyVertices[t[0]] || _dirtyVertices[t[1]] || _dirtyVertices[t[2]] || _dirtyVertices[t[3]]))
+					continue;
+				Vec3f& c = _tetraCentroids[i];
+				c.x = (x[t[0]] + x[t[1]] + x[t[2]] + x[t[3]]) * 0.25f;
+				c.y = (y[t[0]] + y[t[1]] + y[t[2]] + y[t[3]]) * 0.25f;
+				c.z = (z[t[0]] + z[t[1]] + z[t[2]] + z[t[3]]) * 0.25f;
+			}
+		});
+	}
+	else
+	{
+		ParallelFor(0, _tetrahedra.size(), [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				const Tetrahedron& t = _tetrahedra[i];
+				if (dirtyOnly && !(_dirtyVertices[t.index[0]] || _dirtyVertices[t.index[1]] || _dirtyVertices[t.index[2]] || _dirtyVertices[t.index[3]]))
+					continue;
+				_tetraCentroids[i] = Tetrahedron::Centroid(_vertices[t.index[0]], _vertices[t.index[1]], _vertices[t.index[2]], _vertices[t.index[3]]);
+			}
+		});
+	}
+}
+
+void TetraTools::TetrahedronTopology::UpdatePositionDependentData()
+{
+	TriangleTopology::UpdatePositionDependentData();
+	if (_tetraCentroidsFlag.IsValid())
+		GenerateTetraCentroids(true);
+}
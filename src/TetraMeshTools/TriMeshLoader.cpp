@@ -8,6 +8,7 @@
 #include <fstream>
 #include "TriMeshLoader.h"
 #include "TriMesh.h"
+#include "GeometryConversion.h"
 
 TetraTools::TriMeshLoader::TriMeshLoader()
 {
@@ -39,21 +40,17 @@ bool TetraTools::TriMeshLoader::loadFile(const std::string& path_and_filename)
 	{
 		std::cout<<"Successfully loaded surface mesh with "<<tm->vertices.size()<<" vertices and "<<tm->faces.size()<<" faces."<<std::endl;
 	}
-	for (unsigned int i=0; i<tm->vertices.size(); ++i)
-	{
-		const point& p = tm->vertices[i];
-		Vec3f v(p[0], p[1], p[2]);
-		_vertices.push_back(v);
-	}
-	for (unsigned int i=0; i<tm->faces.size(); ++i)
-	{
-		const TriMesh::Face& f = tm->faces[i];
-		Triangle t;
-		t.index[0] = f[0];
-		t.index[1] = f[1];
-		t.index[2] = f[2];
-		_triangles.push_back(t);
-	}
+	/// point and Face share the layout of Vec3f and Triangle
+	CopyPrimitives(tm->vertices, _vertices);
+	CopyPrimitives(tm->faces, _triangles);
 	delete tm;
 	return true;
 }
+
+void TetraTools::TriMeshLoader::release(std::vector<Vec3f>& vertices_, std::vector<Triangle>& triangles_)
+{
+	vertices_.clear();
+	triangles_.clear();
+	vertices_.swap(_vertices);
+	triangles_.swap(_triangles);
+}
@@ -6,10 +6,13 @@
  */
 
 #include "TriangleTopology.h"
+#include "ParallelUtils.h"
 #include <map>
 #include <iostream>
 #include <algorithm>
 #include <limits>
+#include <thread>
+#include <atomic>
 #ifndef WIN32
 #include <cfloat>
 #include <math.h>
@@ -18,46 +21,95 @@
 #endif
 
 /// Constructors
-TetraTools::TriangleTopology::TriangleTopology() : radius(0)
+TetraTools::TriangleTopology::TriangleTopology() : _numDirtyVertices(0), _vertexLayout(VERTEX_LAYOUT_AOS), radius(0)
 {
 	Clear();
 }
 
 TetraTools::TriangleTopology::TriangleTopology(	const std::vector<Vec3f>& vertices_,
 												const std::vector<Triangle>& triangles_,
-												const bool complete_) : radius(0)
+												const bool complete_) : _numDirtyVertices(0), _vertexLayout(VERTEX_LAYOUT_AOS), radius(0)
 {
 	Init(vertices_, triangles_, complete_);
 }
 
+TetraTools::TriangleTopology::TriangleTopology(	std::vector<Vec3f>&& vertices_,
+												std::vector<Triangle>&& triangles_,
+												const bool complete_) : _numDirtyVertices(0), _vertexLayout(VERTEX_LAYOUT_AOS), radius(0)
+{
+	Init(std::move(vertices_), std::move(triangles_), complete_);
+}
+
 TetraTools::TriangleTopology::~TriangleTopology()
 {
 	Clear();
 }
 
-void TetraTools::TriangleTopology::GenerateNormals()
+Vec3f TetraTools::TriangleTopology::ComputeVertexNormal(const unsigned int vertexIndex_) const
 {
-	_normals.clear();
-	if (_vertexTrianglesLookup.size() != _vertices.size())
+	Vec3f normal;
+	const PrimitivesPerVertex& ppv = _vertexTrianglesLookup[vertexIndex_];
+	for (PrimitiveOffset j=ppv.offset; j<ppv.length+ppv.offset; ++j)
 	{
-		GenerateTriangleMap();
+		const Triangle& t = _triangles[_triangleVertices[j].triangleIndex];
+		normal += Triangle::GetNormal(_vertices[t.index[0]], _vertices[t.index[1]], _vertices[t.index[2]]);
 	}
+	normal.normalize();
+	return normal;
+}
+
+void TetraTools::TriangleTopology::GenerateNormals()
+{
+	GetTrianglesPerVertexLookupTable();
 	std::cout<<"Generating Surface Normals..."<<std::endl;
-	float dist = 0;
-	for (unsigned int i=0; i<_vertices.size(); ++i)
+	/// face normals are computed once per triangle and then averaged per vertex
+	std::vector<Vec3f> faceNormals(_triangles.size());
+	if (_vertexLayout == VERTEX_LAYOUT_SOA)
 	{
-		Vec3f normal;
-		PrimitivesPerVertex ppv = _vertexTrianglesLookup[i];
-		for (unsigned int j=ppv.offset; j<ppv.length+ppv.offset; ++j)
+		const VertexArraySoA& soa = GetVertexSoA();
+		const float* x = soa.X();
+		const float* y = soa.Y();
+		const float* z = soa.Z();
+		ParallelFor(0, _triangles.size(), [&](size_t b_, size_t e_)
 		{
-			TriangleVertex tv = _triangleVertices[j];
-			Triangle t = _triangles[tv.triangleIndex];
-			normal += t.GetNormal(_vertices[t.index[0]], _vertices[t.index[1]], _vertices[t.index[2]]);
-		}
-		normal.normalize();
-		_normals.push_back(normal);
+			for (size_t i=b_; i<e_; ++i)
+			{
+				const unsigned int* t = _triangles[i].index;
+				const float d0x = x[t[1]] - x[t[0]], d0y = y[t[1]] - y[t[0]], d0z = z[t[1]] - z[t[0]];
+				const float d1x = x[t[2]] - x[t[0]], d1y = y[t[2]] - y[t[0]], d1z = z[t[2]] - z[t[0]];
+				Vec3f n(d0y * d1z - d0z * d1y, d0z * d1x - d0x * d1z, d0x * d1y - d0y * d1x);
+				n.normalize();
+				faceNormals[i] = n;
+			}
+		});
 	}
-	radius = sqrt(dist);
+	else
+	{
+		ParallelFor(0, _triangles.size(), [&](size_t b_, size_t e_)
+		{
+			for (size_t i=b_; i<e_; ++i)
+			{
+				const Triangle& t = _triangles[i];
+				faceNormals[i] = Triangle::GetNormal(_vertices[t.index[0]], _vertices[t.index[1]], _vertices[t.index[2]]);
+			}
+		});
+	}
+	_normals.resize(_vertices.size());
+	ParallelFor(0, _vertices.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			Vec3f normal;
+			const PrimitivesPerVertex& ppv = _vertexTrianglesLookup[i];
+			for (PrimitiveOffset j=ppv.offset; j<ppv.length+ppv.offset; ++j)
+			{
+				normal += faceNormals[_triangleVertices[j].triangleIndex];
+			}
+			normal.normalize();
+			_normals[i] = normal;
+		}
+	});
+	_normalsFlag.SetValid();
 }
 
 void TetraTools::TriangleTopology::GenerateEdges()
@@ -70,6 +122,7 @@ void TetraTools::TriangleTopology::GenerateEdges()
 	}
 	if (_edges.size() != 0)
 		_edges.clear();
+	InvalidateEdgeData();
 	// create a temporary map to find redundant edges
 	std::map<Edge,unsigned int> edgeMap;
 	std::map<Edge,unsigned int>::iterator itt;
@@ -114,84 +167,62 @@ void TetraTools::TriangleTopology::GenerateTriangleEdges()
 	}
 	if (_triangleEdges.size() != 0)
 		_triangleEdges.clear();
-	/// generate Edge-To-Indices map for faster lookup
-	std::map<Edge, unsigned int> m;
-	for (unsigned int i=0; i<_edges.size(); ++i)
-	{
-		const Edge& e = _edges[i];
-		m[e] = i;
-	}
-	std::map<Edge, unsigned int>::iterator it;
-	Edge e[3];
-	for (unsigned int i=0; i<_triangles.size(); ++i)
+	EnsureEdges();
+	EnsureEdgeIndex();
+	_triangleEdges.resize(_triangles.size());
+	ParallelFor(0, _triangles.size(), [this](size_t b_, size_t e_)
 	{
-		const Triangle& t = _triangles[i];
-		TriangleEdges te;
-		for (unsigned int ti=0; ti<3; ++ti)
+		for (size_t i=b_; i<e_; ++i)
 		{
-			/// eventually swap edge-indices
-			if (ti<2) {
-				if (t.index[ti+1] > t.index[ti])
-					e[ti].Set(t.index[ti], t.index[ti+1]);
-				else
-					e[ti].Set(t.index[ti+1], t.index[ti]);
-			}
-			else
-			{
-				if (t.index[0] > t.index[2])
-					e[ti].Set(t.index[2], t.index[0]);
-				else
-					e[ti].Set(t.index[0], t.index[2]);
-			}
-			it = m.find(e[ti]);
-			te.index[ti] = it->second;
+			const Triangle& t = _triangles[i];
+			TriangleEdges& te = _triangleEdges[i];
+			te.index[0] = LookupEdge(t.index[0], t.index[1]);
+			te.index[1] = LookupEdge(t.index[1], t.index[2]);
+			te.index[2] = LookupEdge(t.index[2], t.index[0]);
 		}
-		_triangleEdges.push_back(te);
-	}
+	});
 }
 
 void TetraTools::TriangleTopology::GenerateEdgeMap()
 {
 	std::cout<<"Generating EdgeMap..."<<std::endl;
+	EnsureEdges();
+	_edgeVertices.clear();
+	_vertexEdgesLookup.clear();
 	if (_edges.size() == 0)
 	{
 		std::cerr<<"ERROR! Cannot generate EdgeMap. No Edges present!"<<std::endl;
 		return;
 	}
-	unsigned int numVerts = _vertices.size();
-	unsigned int numEdges = _edges.size();
-	unsigned int offset = 0;
-	unsigned int maxEdges = 0;
-	unsigned int edgeMax = 0;
+	const unsigned int numVerts = _vertices.size();
+	const unsigned int numEdges = _edges.size();
+	/// counting sort by vertex index: entries per vertex stay ordered by edge index
+	_vertexEdgesLookup.resize(numVerts);
 	for (unsigned int i=0; i<numVerts; ++i) {
-		PrimitivesPerVertex veMap;
-		unsigned int counter = 0;
-		veMap.offset = offset;
-		for (unsigned int j=0; j<numEdges; ++j) {
-			const Edge& e = _edges[j];
-			unsigned int vertInEdge = 0;
-			EdgeVertex edgeVertex;
-			if (e.index[0] == i) {
-				edgeVertex.edgeIndex = j;
-				edgeVertex.indexInEdge = vertInEdge;
-				++counter;
-				++offset;
-				_edgeVertices.push_back(edgeVertex);
-			}
-			++vertInEdge;
-			if (e.index[1] == i) {
-				edgeVertex.edgeIndex = j;
-				edgeVertex.indexInEdge = vertInEdge;
-				++counter;
-				++offset;
-				_edgeVertices.push_back(edgeVertex);
-			}
-		}
-		veMap.length = counter;
-		_vertexEdgesLookup.push_back(veMap);
-		if (counter >= maxEdges) {
-			maxEdges = counter;
-			edgeMax = i;
+		_vertexEdgesLookup[i].offset = 0;
+		_vertexEdgesLookup[i].length = 0;
+	}
+	for (unsigned int j=0; j<numEdges; ++j) {
+		const Edge& e = _edges[j];
+		++_vertexEdgesLookup[e.index[0]].length;
+		++_vertexEdgesLookup[e.index[1]].length;
+	}
+	PrimitiveOffset offset = 0;
+	for (unsigned int i=0; i<numVerts; ++i) {
+		_vertexEdgesLookup[i].offset = offset;
+		offset += _vertexEdgesLookup[i].length;
+	}
+	_edgeVertices.resize(offset);
+	std::vector<PrimitiveOffset> cursor(numVerts);
+	for (unsigned int i=0; i<numVerts; ++i) {
+		cursor[i] = _vertexEdgesLookup[i].offset;
+	}
+	for (unsigned int j=0; j<numEdges; ++j) {
+		const Edge& e = _edges[j];
+		for (unsigned int vertInEdge=0; vertInEdge<2; ++vertInEdge) {
+			EdgeVertex& edgeVertex = _edgeVertices[cursor[e.index[vertInEdge]]++];
+			edgeVertex.edgeIndex = j;
+			edgeVertex.indexInEdge = vertInEdge;
 		}
 	}
 }
@@ -199,50 +230,46 @@ void TetraTools::TriangleTopology::GenerateEdgeMap()
 void TetraTools::TriangleTopology::GenerateTriangleMap()
 {
 	std::cout<<"Generating TriangleMap..."<<std::endl;
-	unsigned int numVerts = _vertices.size();
-	unsigned int numTriangles = _triangles.size();
-	unsigned int offset = 0;
+	_triangleVertices.clear();
+	_vertexTrianglesLookup.clear();
+	const unsigned int numVerts = _vertices.size();
+	const unsigned int numTriangles = _triangles.size();
+	/// counting sort by vertex index: entries per vertex stay ordered by triangle index
+	_vertexTrianglesLookup.resize(numVerts);
+	for (unsigned int i=0; i<numVerts; ++i) {
+		_vertexTrianglesLookup[i].offset = 0;
+		_vertexTrianglesLookup[i].length = 0;
+	}
+	for (unsigned int j=0; j<numTriangles; ++j) {
+		const Triangle& t = _triangles[j];
+		++_vertexTrianglesLookup[t.index[0]].length;
+		++_vertexTrianglesLookup[t.index[1]].length;
+		++_vertexTrianglesLookup[t.index[2]].length;
+	}
+	PrimitiveOffset offset = 0;
 	unsigned int maxTriangles = 0;
 	unsigned int trianglesMax = 0;
 	for (unsigned int i=0; i<numVerts; ++i) {
-		PrimitivesPerVertex vtMap;
-		unsigned int counter = 0;
-		vtMap.offset = offset;
-		for (unsigned int j=0; j<numTriangles; ++j) {
-			const Triangle& t = _triangles[j];
-			unsigned int vertInTri = 0;
-			TriangleVertex triangleVertex;
-			if (t.index[0] == i) {
-				triangleVertex.triangleIndex = j;
-				triangleVertex.indexInTriangle = vertInTri;
-				++counter;
-				++offset;
-				_triangleVertices.push_back(triangleVertex);
-			}
-			++vertInTri;
-			if (t.index[1] == i) {
-				triangleVertex.triangleIndex = j;
-				triangleVertex.indexInTriangle = vertInTri;
-				++counter;
-				++offset;
-				_triangleVertices.push_back(triangleVertex);
-			}
-			++vertInTri;
-			if (t.index[2] == i) {
-				triangleVertex.triangleIndex = j;
-				triangleVertex.indexInTriangle = vertInTri;
-				++counter;
-				++offset;
-				_triangleVertices.push_back(triangleVertex);
-			}
-		}
-		vtMap.length = counter;
-		_vertexTrianglesLookup.push_back(vtMap);
-		if (counter >= maxTriangles) {
-			maxTriangles = counter;
+		_vertexTrianglesLookup[i].offset = offset;
+		offset += _vertexTrianglesLookup[i].length;
+		if (_vertexTrianglesLookup[i].length >= maxTriangles) {
+			maxTriangles = _vertexTrianglesLookup[i].length;
 			trianglesMax = i;
 		}
 	}
+	_triangleVertices.resize(offset);
+	std::vector<PrimitiveOffset> cursor(numVerts);
+	for (unsigned int i=0; i<numVerts; ++i) {
+		cursor[i] = _vertexTrianglesLookup[i].offset;
+	}
+	for (unsigned int j=0; j<numTriangles; ++j) {
+		const Triangle& t = _triangles[j];
+		for (unsigned int vertInTri=0; vertInTri<3; ++vertInTri) {
+			TriangleVertex& triangleVertex = _triangleVertices[cursor[t.index[vertInTri]]++];
+			triangleVertex.triangleIndex = j;
+			triangleVertex.indexInTriangle = vertInTri;
+		}
+	}
 	std::cout<<"\tMax number of triangles connected to a vertex: "<<maxTriangles<<" at Vertex: "<<trianglesMax<<std::endl;
 }
 
@@ -253,32 +280,75 @@ void TetraTools::TriangleTopology::GenerateBoundingBox()
 
 void TetraTools::TriangleTopology::GenerateBoundingBox(const std::vector<Vec3f>& vertices_)
 {
-	std::vector<Vec3f>::const_iterator it;
 	/// generate Bounding Box
 	std::cout<<"Generating BoundingBox ..."<<std::endl;
+	UpdateBoundingBox(vertices_);
+	std::cout<<"\t BBox: "<<bb.min<<"; "<<bb.max<<std::endl;
+}
+
+void TetraTools::TriangleTopology::ComputeBoundingBoxAoS(const std::vector<Vec3f>& vertices_, BoundingBox& box_, float& maxSquaredLength_)
+{
+	/// per-chunk min/max reduction, merged afterwards
+	const size_t numChunks = std::max<size_t>(1, std::min<size_t>(GetNumThreads(), vertices_.size() / 4096));
+	const size_t chunkSize = (vertices_.size() + numChunks - 1) / numChunks;
+	std::vector<BoundingBox> boxes(numChunks);
+	std::vector<float> dists(numChunks, 0.0f);
+	ParallelFor(0, numChunks, [&](size_t b_, size_t e_)
+	{
+		for (size_t c=b_; c<e_; ++c)
+		{
+			BoundingBox b;
+			b.min = Vec3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+			b.max = Vec3f(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+			float dist = 0;
+			const size_t end = std::min(vertices_.size(), (c + 1) * chunkSize);
+			for (size_t i=c*chunkSize; i<end; ++i)
+			{
+				const Vec3f& v = vertices_[i];
+				dist = std::max<float>(dist, v.squaredLength());
+				b.min.x = std::min<float>(b.min.x, v.x);
+				b.max.x = std::max<float>(b.max.x, v.x);
+				b.min.y = std::min<float>(b.min.y, v.y);
+				b.max.y = std::max<float>(b.max.y, v.y);
+				b.min.z = std::min<float>(b.min.z, v.z);
+				b.max.z = std::max<float>(b.max.z, v.z);
+			}
+			boxes[c] = b;
+			dists[c] = dist;
+		}
+	}, 1);
+	box_ = boxes[0];
+	maxSquaredLength_ = dists[0];
+	for (size_t c=1; c<numChunks; ++c)
+	{
+		box_.min.x = std::min<float>(box_.min.x, boxes[c].min.x);
+		box_.max.x = std::max<float>(box_.max.x, boxes[c].max.x);
+		box_.min.y = std::min<float>(box_.min.y, boxes[c].min.y);
+		box_.max.y = std::max<float>(box_.max.y, boxes[c].max.y);
+		box_.min.z = std::min<float>(box_.min.z, boxes[c].min.z);
+		box_.max.z = std::max<float>(box_.max.z, boxes[c].max.z);
+		maxSquaredLength_ = std::max<float>(maxSquaredLength_, dists[c]);
+	}
+}
+
+void TetraTools::TriangleTopology::UpdateBoundingBox(const std::vector<Vec3f>& vertices_)
+{
 	BoundingBox b;
-	//b.min = Vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
-	b.min = Vec3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-	//b.max = Vec3f(FLT_MIN, FLT_MIN, FLT_MIN);
-	b.max = Vec3f(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
 	float dist = 0;
-	for (it=vertices_.begin(); it!=vertices_.end(); ++it)
+	if (_vertexLayout == VERTEX_LAYOUT_SOA && &vertices_ == &_vertices)
 	{
-		Vec3f v = *it;
-		float pd = v.squaredLength();
-		if (pd > dist)
+		if (!GetVertexSoA().ComputeBounds(b.min, b.max, dist))
 		{
-			dist = pd;
+			b.min = Vec3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+			b.max = Vec3f(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
 		}
-		//_vertices.push_back(v);
-		b.min.x = std::min<float>(b.min.x, v.x);
-		b.max.x = std::max<float>(b.max.x, v.x);
-		b.min.y = std::min<float>(b.min.y, v.y);
-		b.max.y = std::max<float>(b.max.y, v.y);
-		b.min.z = std::min<float>(b.min.z, v.z);
-		b.max.z = std::max<float>(b.max.z, v.z);
+	}
+	else
+	{
+		ComputeBoundingBoxAoS(vertices_, b, dist);
 	}
 	bb = b;
+	radius = sqrt(dist);
 	float dx = b.max.x - b.min.x;
 	float dy = b.max.y - b.min.y;
 	float dz = b.max.z - b.min.z;
@@ -289,39 +359,128 @@ void TetraTools::TriangleTopology::GenerateBoundingBox(const std::vector<Vec3f>&
 	const float lbcModifier = maxDist * 0.1f; /// add 10% volume for the larger bounding cube
 	lbc.size = maxDist + lbcModifier;
 	lbc.center = Vec3f(b.min.x + dx/2, b.min.y + dy/2, b.min.z + dz / 2);
-	//std::cout<<"dx/dy/dz: "<<dx<<"/"<<dy<<"/"<<dz<<"; bc: "<<maxDist<<std::endl;
-	std::cout<<"\t BBox: "<<bb.min<<"; "<<bb.max<<std::endl;
+}
+
+bool TetraTools::TriangleTopology::UpdateVertices(const std::vector<Vec3f>& vertices_)
+{
+	return UpdateVertices(vertices_.empty() ? NULL : &vertices_[0], vertices_.size());
+}
+
+bool TetraTools::TriangleTopology::UpdateVertices(const Vec3f* vertices_, const size_t numVertices_)
+{
+	if (numVertices_ != _vertices.size())
+	{
+		std::cerr<<"ERROR! Cannot update vertices. Expected "<<_vertices.size()<<" vertices, got "<<numVertices_<<"!"<<std::endl;
+		return false;
+	}
+	if (numVertices_ > 0 && vertices_ == &_vertices[0])
+	{
+		/// the positions were edited in place, so moved vertices cannot be detected
+		MarkVerticesChanged();
+		return true;
+	}
+	/// copy positions and remember which vertices actually moved
+	_dirtyVertices.resize(numVertices_);
+	std::atomic<size_t> numDirty(0);
+	const bool soaValid = _vertexSoAFlag.IsValid();
+	ParallelFor(0, numVertices_, [&](size_t b_, size_t e_)
+	{
+		size_t count = 0;
+		for (size_t i=b_; i<e_; ++i)
+		{
+			const bool moved = (_vertices[i] != vertices_[i]) != 0;
+			_dirtyVertices[i] = moved ? 1 : 0;
+			if (moved)
+			{
+				_vertices[i] = vertices_[i];
+				if (soaValid)
+					_vertexSoA.Set(i, vertices_[i]);
+				++count;
+			}
+		}
+		numDirty.fetch_add(count, std::memory_order_relaxed);
+	});
+	_numDirtyVertices = numDirty.load();
+	if (_numDirtyVertices > 0)
+	{
+		UpdatePositionDependentData();
+	}
+	return true;
+}
+
+void TetraTools::TriangleTopology::MarkVerticesChanged()
+{
+	_dirtyVertices.assign(_vertices.size(), 1);
+	_numDirtyVertices = _vertices.size();
+	_vertexSoAFlag.Invalidate();
+	if (_numDirtyVertices > 0)
+	{
+		UpdatePositionDependentData();
+	}
+}
+
+void TetraTools::TriangleTopology::UpdatePositionDependentData()
+{
+	UpdateBoundingBox(_vertices);
+	if (!_normalsFlag.IsValid())
+		return;
+	/// only vertices that share a triangle with a moved vertex get a new normal
+	const std::vector<PrimitivesPerVertex>& lookup = GetTrianglesPerVertexLookupTable();
+	ParallelFor(0, _vertices.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			bool affected = _dirtyVertices[i] != 0;
+			for (PrimitiveOffset j=lookup[i].offset; !affected && j<lookup[i].offset+lookup[i].length; ++j)
+			{
+				const Triangle& t = _triangles[_triangleVertices[j].triangleIndex];
+				affected = _dirtyVertices[t.index[0]] || _dirtyVertices[t.index[1]] || _dirtyVertices[t.index[2]];
+			}
+			if (affected)
+			{
+				_normals[i] = ComputeVertexNormal(i);
+			}
+		}
+	});
 }
 
 void TetraTools::TriangleTopology::Init(	const std::vector<Vec3f>& vertices_,
 											const std::vector<Triangle>& triangles_,
 											const bool fullUpdate_)
+{
+	std::vector<Vec3f> vertices(vertices_);
+	std::vector<Triangle> triangles(triangles_);
+	Init(std::move(vertices), std::move(triangles), fullUpdate_);
+}
+
+void TetraTools::TriangleTopology::Init(	std::vector<Vec3f>&& vertices_,
+											std::vector<Triangle>&& triangles_,
+											const bool fullUpdate_)
 {
 	Clear();
-	//GenerateBoundingBox(vertices_);
-	for (unsigned int i=0; i<vertices_.size(); ++i)
-	{
-		_vertices.push_back(vertices_[i]);
-	}
+	/// take over the buffers, the caller's vectors are left empty
+	_vertices.swap(vertices_);
+	_triangles.swap(triangles_);
+	vertices_.clear();
+	triangles_.clear();
 	GenerateBoundingBox();
-	std::vector<Triangle>::const_iterator tit;
-	for (tit=triangles_.begin(); tit!=triangles_.end(); ++tit)
-	{
-		_triangles.push_back(*tit);
-	}
 	if (fullUpdate_)
 	{
-		GenerateEdges();
+		EnsureEdges();
 		//GenerateTriangleEdges();
 		//GenerateEdgeMap();
 		//GenerateTriangleMap();
-		GenerateNormals();
+		GetNormals();
 	}
 }
 
 void TetraTools::TriangleTopology::Clear()
 {
 	_vertices.clear();
+	_normals.clear();
+	_dirtyVertices.clear();
+	_numDirtyVertices = 0;
+	_vertexSoA.Clear();
 	_triangles.clear();
 	_edges.clear();
 	_triangleEdges.clear();
@@ -329,6 +488,99 @@ void TetraTools::TriangleTopology::Clear()
 	_edgeVertices.clear();
 	_vertexEdgesLookup.clear();
 	_vertexTrianglesLookup.clear();
+	_edgeIndexTable.clear();
+	InvalidateAll();
+}
+
+void TetraTools::TriangleTopology::SetVertexLayout(const VertexLayout layout_)
+{
+	_vertexLayout = layout_;
+	if (_vertexLayout == VERTEX_LAYOUT_AOS)
+	{
+		/// release the mirror, it is rebuilt on demand
+		_vertexSoAFlag.Invalidate();
+		_vertexSoA = VertexArraySoA();
+	}
+}
+
+void TetraTools::TriangleTopology::InvalidateEdgeData()
+{
+	_edgeIndexFlag.Invalidate();
+	_triangleEdgesFlag.Invalidate();
+	_edgeMapFlag.Invalidate();
+}
+
+void TetraTools::TriangleTopology::InvalidateAll()
+{
+	_edgesFlag.Invalidate();
+	InvalidateEdgeData();
+	_triangleMapFlag.Invalidate();
+	_normalsFlag.Invalidate();
+	_vertexSoAFlag.Invalidate();
+}
+
+void TetraTools::TriangleTopology::CollectGenerators(const unsigned int structures_, std::vector<std::function<void()> >& tasks_)
+{
+	/// the edge index reads the edge list, so it runs in the same task after the edges
+	if (structures_ & TOPOLOGY_EDGE_INDEX)
+		tasks_.push_back([this]() { EnsureEdgeIndex(); });
+	else if (structures_ & TOPOLOGY_EDGES)
+		tasks_.push_back([this]() { EnsureEdges(); });
+	if (structures_ & TOPOLOGY_TRIANGLE_EDGES)
+		tasks_.push_back([this]() { GetTriangleEdges(); });
+	if (structures_ & TOPOLOGY_EDGE_MAP)
+		tasks_.push_back([this]() { GetEdgesPerVertices(); });
+	if (structures_ & TOPOLOGY_TRIANGLE_MAP)
+		tasks_.push_back([this]() { GetTrianglesPerVertices(); });
+	if (structures_ & TOPOLOGY_NORMALS)
+		tasks_.push_back([this]() { GetNormals(); });
+	if (structures_ & TOPOLOGY_VERTEX_SOA)
+		tasks_.push_back([this]() { GetVertexSoA(); });
+}
+
+unsigned int TetraTools::TriangleTopology::GetGeneratedStructures() const
+{
+	unsigned int structures = 0;
+	if (_edgesFlag.IsValid())
+		structures |= TOPOLOGY_EDGES;
+	if (_edgeIndexFlag.IsValid())
+		structures |= TOPOLOGY_EDGE_INDEX;
+	if (_triangleEdgesFlag.IsValid())
+		structures |= TOPOLOGY_TRIANGLE_EDGES;
+	if (_edgeMapFlag.IsValid())
+		structures |= TOPOLOGY_EDGE_MAP;
+	if (_triangleMapFlag.IsValid())
+		structures |= TOPOLOGY_TRIANGLE_MAP;
+	if (_normalsFlag.IsValid())
+		structures |= TOPOLOGY_NORMALS;
+	if (_vertexSoAFlag.IsValid())
+		structures |= TOPOLOGY_VERTEX_SOA;
+	return structures;
+}
+
+void TetraTools::TriangleTopology::EnsureAll(const unsigned int structures_, const bool parallel_)
+{
+	std::vector<std::function<void()> > tasks;
+	CollectGenerators(structures_, tasks);
+	if (!parallel_ || tasks.size() < 2)
+	{
+		for (unsigned int i=0; i<tasks.size(); ++i)
+		{
+			tasks[i]();
+		}
+		return;
+	}
+	/// structures that depend on each other simply wait on the corresponding flag
+	std::vector<std::thread> threads;
+	threads.reserve(tasks.size());
+	for (unsigned int i=0; i<tasks.size(); ++i)
+	{
+		threads.push_back(std::thread(tasks[i]));
+	}
+	for (unsigned int i=0; i<threads.size(); ++i)
+	{
+		threads[i].join();
+	}
 }
 
 void TetraTools::TriangleTopology::SetEdges(const std::vector<Edge>& edges_)
@@ -341,22 +593,95 @@ void TetraTools::TriangleTopology::SetEdges(const std::vector<Edge>& edges_)
 	_edgeVertices.clear();
 	_vertexEdgesLookup.clear();
 	_triangleEdges.clear();
+	_edgeIndexTable.clear();
+	InvalidateEdgeData();
+	_edgesFlag.SetValid();
 }
 
-const unsigned int TetraTools::TriangleTopology::FindEdgeByIndex(const unsigned int i0, const unsigned int i1)
+namespace
 {
-	if (_edges.size() == 0)
+	/// sentinel for empty slots in the edge index table
+	const unsigned int EmptyEdgeSlot = 0xFFFFFFFFu;
+
+	inline size_t HashEdge(unsigned int i0, unsigned int i1)
 	{
-		GenerateEdges();
-		if (_edges.size() == 0)
-			return -1;
+		if (i0 > i1)
+			std::swap(i0, i1);
+		unsigned long long h = (static_cast<unsigned long long>(i0) << 32) | i1;
+		/// 64 bit finalizer (MurmurHash3 fmix64)
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return static_cast<size_t>(h);
 	}
+}
+
+void TetraTools::TriangleTopology::GenerateEdgeIndex()
+{
+	_edgeIndexTable.clear();
+	if (_edges.size() == 0)
+		return;
+	size_t capacity = 16;
+	while (capacity < _edges.size() * 2)
+		capacity <<= 1;
+	_edgeIndexTable.assign(capacity, EmptyEdgeSlot);
+	const size_t mask = capacity - 1;
 	for (unsigned int i=0; i<_edges.size(); ++i)
 	{
-		const Edge e = _edges[i];
-		if (((e.index[0] == i0) && (e.index[1] == i1)) || ((e.index[0] == i1) &&  (e.index[1] == i0))) {
-			return i;
+		const Edge& e = _edges[i];
+		size_t slot = HashEdge(e.index[0], e.index[1]) & mask;
+		while (_edgeIndexTable[slot] != EmptyEdgeSlot)
+		{
+			/// keep the first occurrence of duplicate edges (same result as the linear search)
+			const Edge& o = _edges[_edgeIndexTable[slot]];
+			if ((o.index[0] == e.index[0] && o.index[1] == e.index[1]) || (o.index[0] == e.index[1] && o.index[1] == e.index[0]))
+				break;
+			slot = (slot + 1) & mask;
 		}
+		if (_edgeIndexTable[slot] == EmptyEdgeSlot)
+			_edgeIndexTable[slot] = i;
+	}
+}
+
+unsigned int TetraTools::TriangleTopology::LookupEdge(const unsigned int i0, const unsigned int i1) const
+{
+	if (_edgeIndexTable.size() == 0)
+		return -1;
+	const size_t mask = _edgeIndexTable.size() - 1;
+	size_t slot = HashEdge(i0, i1) & mask;
+	while (_edgeIndexTable[slot] != EmptyEdgeSlot)
+	{
+		const Edge& e = _edges[_edgeIndexTable[slot]];
+		if (((e.index[0] == i0) && (e.index[1] == i1)) || ((e.index[0] == i1) && (e.index[1] == i0)))
+			return _edgeIndexTable[slot];
+		slot = (slot + 1) & mask;
 	}
 	return -1;
 }
+
+const unsigned int TetraTools::TriangleTopology::FindEdgeByIndex(const unsigned int i0, const unsigned int i1)
+{
+	EnsureEdges();
+	if (_edges.size() == 0)
+		return -1;
+	EnsureEdgeIndex();
+	return LookupEdge(i0, i1);
+}
+
+void TetraTools::TriangleTopology::FindEdgesByIndex(const std::vector<Edge>& edges_, std::vector<unsigned int>& indices_)
+{
+	indices_.assign(edges_.size(), -1);
+	EnsureEdges();
+	if (_edges.size() == 0)
+		return;
+	EnsureEdgeIndex();
+	ParallelFor(0, edges_.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			indices_[i] = LookupEdge(edges_[i].index[0], edges_[i].index[1]);
+		}
+	});
+}
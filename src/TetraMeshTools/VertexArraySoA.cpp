@@ -0,0 +1,136 @@
+/*
+ * VertexArraySoA.cpp
+ *
+ * Bulk kernels for the structure-of-arrays vertex storage.
+ */
+
+#include "VertexArraySoA.h"
+#include "ParallelUtils.h"
+#include "SimdFloat4.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	struct Bounds
+	{
+		float min[3];
+		float max[3];
+		float maxSquaredLength;
+	};
+
+	void ComputeBoundsRange(const float* x_, const float* y_, const float* z_, size_t begin_, const size_t end_, Bounds& bounds_)
+	{
+		float mnx = std::numeric_limits<float>::max(), mny = mnx, mnz = mnx;
+		float mxx = -std::numeric_limits<float>::max(), mxy = mxx, mxz = mxx;
+		float dist = 0.0f;
+#ifdef TETRATOOLS_USE_SSE
+		/// scalar head until the arrays are 16-byte aligned
+		while (begin_ < end_ && (reinterpret_cast<size_t>(x_ + begin_) & 15) != 0)
+		{
+			mnx = std::min(mnx, x_[begin_]); mxx = std::max(mxx, x_[begin_]);
+			mny = std::min(mny, y_[begin_]); mxy = std::max(mxy, y_[begin_]);
+			mnz = std::min(mnz, z_[begin_]); mxz = std::max(mxz, z_[begin_]);
+			dist = std::max(dist, x_[begin_] * x_[begin_] + y_[begin_] * y_[begin_] + z_[begin_] * z_[begin_]);
+			++begin_;
+		}
+		__m128 vmnx = _mm_set1_ps(mnx), vmny = vmnx, vmnz = vmnx;
+		__m128 vmxx = _mm_set1_ps(mxx), vmxy = vmxx, vmxz = vmxx;
+		__m128 vdist = _mm_setzero_ps();
+		for (; begin_ + 4 <= end_; begin_ += 4)
+		{
+			const __m128 vx = _mm_load_ps(x_ + begin_);
+			const __m128 vy = _mm_load_ps(y_ + begin_);
+			const __m128 vz = _mm_load_ps(z_ + begin_);
+			vmnx = _mm_min_ps(vmnx, vx); vmxx = _mm_max_ps(vmxx, vx);
+			vmny = _mm_min_ps(vmny, vy); vmxy = _mm_max_ps(vmxy, vy);
+			vmnz = _mm_min_ps(vmnz, vz); vmxz = _mm_max_ps(vmxz, vz);
+			const __m128 sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+			vdist = _mm_max_ps(vdist, sq);
+		}
+		float tmp[6][4];
+		_mm_storeu_ps(tmp[0], vmnx); _mm_storeu_ps(tmp[1], vmny); _mm_storeu_ps(tmp[2], vmnz);
+		_mm_storeu_ps(tmp[3], vmxx); _mm_storeu_ps(tmp[4], vmxy); _mm_storeu_ps(tmp[5], vmxz);
+		float dtmp[4];
+		_mm_storeu_ps(dtmp, vdist);
+		for (unsigned int l=0; l<4; ++l)
+		{
+			mnx = std::min(mnx, tmp[0][l]); mny = std::min(mny, tmp[1][l]); mnz = std::min(mnz, tmp[2][l]);
+			mxx = std::max(mxx, tmp[3][l]); mxy = std::max(mxy, tmp[4][l]); mxz = std::max(mxz, tmp[5][l]);
+			dist = std::max(dist, dtmp[l]);
+		}
+#endif
+		/// scalar tail (or the whole range without SSE)
+		for (; begin_ < end_; ++begin_)
+		{
+			mnx = std::min(mnx, x_[begin_]); mxx = std::max(mxx, x_[begin_]);
+			mny = std::min(mny, y_[begin_]); mxy = std::max(mxy, y_[begin_]);
+			mnz = std::min(mnz, z_[begin_]); mxz = std::max(mxz, z_[begin_]);
+			dist = std::max(dist, x_[begin_] * x_[begin_] + y_[begin_] * y_[begin_] + z_[begin_] * z_[begin_]);
+		}
+		bounds_.min[0] = mnx; bounds_.min[1] = mny; bounds_.min[2] = mnz;
+		bounds_.max[0] = mxx; bounds_.max[1] = mxy; bounds_.max[2] = mxz;
+		bounds_.maxSquaredLength = dist;
+	}
+}
+
+void TetraTools::VertexArraySoA::Assign(const std::vector<Vec3f>& vertices_)
+{
+	Resize(vertices_.size());
+	ParallelFor(0, vertices_.size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			_x[i] = vertices_[i].x;
+			_y[i] = vertices_[i].y;
+			_z[i] = vertices_[i].z;
+		}
+	});
+}
+
+void TetraTools::VertexArraySoA::ToAoS(std::vector<Vec3f>& vertices_) const
+{
+	vertices_.resize(Size());
+	ParallelFor(0, Size(), [&](size_t b_, size_t e_)
+	{
+		for (size_t i=b_; i<e_; ++i)
+		{
+			vertices_[i] = Vec3f(_x[i], _y[i], _z[i]);
+		}
+	});
+}
+
+bool TetraTools::VertexArraySoA::ComputeBounds(Vec3f& min_, Vec3f& max_, float& maxSquaredLength_) const
+{
+	const size_t size = Size();
+	if (size == 0)
+		return false;
+	/// one chunk per thread, merged afterwards; chunks start on 16 float boundaries
+	const size_t numChunks = std::max<size_t>(1, std::min<size_t>(GetNumThreads(), size / 16384));
+	const size_t chunkSize = ((size + numChunks - 1) / numChunks + 15) & ~static_cast<size_t>(15);
+	std::vector<Bounds> bounds(numChunks);
+	const float* x = X();
+	const float* y = Y();
+	const float* z = Z();
+	ParallelFor(0, numChunks, [&](size_t b_, size_t e_)
+	{
+		for (size_t c=b_; c<e_; ++c)
+		{
+			ComputeBoundsRange(x, y, z, std::min(size, c * chunkSize), std::min(size, (c + 1) * chunkSize), bounds[c]);
+		}
+	}, 1);
+	Bounds b = bounds[0];
+	for (size_t c=1; c<numChunks; ++c)
+	{
+		for (unsigned int k=0; k<3; ++k)
+		{
+			b.min[k] = std::min(b.min[k], bounds[c].min[k]);
+			b.max[k] = std::max(b.max[k], bounds[c].max[k]);
+		}
+		b.maxSquaredLength = std::max(b.maxSquaredLength, bounds[c].maxSquaredLength);
+	}
+	min_ = Vec3f(b.min[0], b.min[1], b.min[2]);
+	max_ = Vec3f(b.max[0], b.max[1], b.max[2]);
+	maxSquaredLength_ = b.maxSquaredLength;
+	return true;
+}